@@ -31,6 +31,7 @@ extern "C" {
 #endif
 
 typedef struct NVGcontext NVGcontext;
+typedef struct NVGcompiledPath NVGcompiledPath;
 
 struct NVGcolor {
     union {
@@ -135,6 +136,27 @@ struct NVGtextRow {
 };
 typedef struct NVGtextRow NVGtextRow;
 
+struct NVGframeStats {
+    int drawCalls;				// Number of draw calls issued by the current frame.
+    int fillTriangles;			// Number of triangles in fills.
+    int strokeTriangles;		// Number of triangles in strokes.
+    int textTriangles;			// Number of triangles in text.
+    int tessCacheHits;			// Number of fills and strokes drawn from the tessellation cache.
+    int tessCacheMisses;		// Number of fills and strokes tessellated and added to the cache.
+    int tessCacheMemory;		// Bytes currently used by the tessellation cache.
+    int culledPaths;			// Number of fills and strokes skipped because they are outside the viewport or scissor.
+    int culledGlyphs;			// Number of glyphs skipped because they are outside the viewport or scissor.
+    int arenaUsed;				// Bytes of the frame arena used by the current frame.
+    int arenaSize;				// Bytes currently reserved by the frame arena.
+    int arenaAllocs;			// Number of blocks the frame arena had to allocate during the current frame.
+    int deferredPaths;			// Number of fills and strokes tessellated by the tessellation threads.
+    int pendingGlyphs;			// Number of glyphs skipped because the glyph thread was still rasterizing them.
+    int textCacheHits;			// Number of nvgText() calls drawn from the text run cache.
+    int textCacheMisses;		// Number of nvgText() calls which laid out their string.
+    int textCacheMemory;		// Bytes currently used by the text run cache.
+};
+typedef struct NVGframeStats NVGframeStats;
+
 enum NVGimageFlags {
     NVG_IMAGE_GENERATE_MIPMAPS	= 1<<0,     // Generate mipmaps during creation of the image.
     NVG_IMAGE_REPEATX			= 1<<1,		// Repeat image in X direction.
@@ -142,6 +164,7 @@ enum NVGimageFlags {
     NVG_IMAGE_FLIPY				= 1<<3,		// Flips (inverses) image in Y direction when rendered.
     NVG_IMAGE_PREMULTIPLIED		= 1<<4,		// Image data has premultiplied alpha.
     NVG_IMAGE_NEAREST			= 1<<5,		// Image interpolation is Nearest instead Linear
+    NVG_IMAGE_SDF				= 1<<6,		// Alpha image holds a signed distance field with its edge at 0.5, used for the font atlas.
 };
 
 // Begin drawing a new frame
@@ -268,6 +291,11 @@ void nvgLineCap(NVGcontext* ctx, int cap);
 // Can be one of NVG_MITER (default), NVG_ROUND, NVG_BEVEL.
 void nvgLineJoin(NVGcontext* ctx, int join);
 
+// Sets the dash pattern of the stroke style. The pattern lists alternating dash and gap lengths,
+// odd length patterns are repeated, and offset shifts the start of the pattern along the path.
+// Pass a NULL pattern to draw solid strokes (default).
+void nvgStrokeDash(NVGcontext* ctx, const float* pattern, int count, float offset);
+
 // Sets the transparency applied to all rendered shapes.
 // Already transparent paths will get proportionally more transparent as well.
 void nvgGlobalAlpha(NVGcontext* ctx, float alpha);
@@ -508,6 +536,78 @@ void nvgFill(NVGcontext* ctx);
 // Fills the current path with current stroke style.
 void nvgStroke(NVGcontext* ctx);
 
+//
+// Compiled Paths
+//
+// A compiled path keeps the flattened and expanded geometry of a path, so that a static shape
+// (i.e. an icon) can be drawn many times without tessellating it again each frame.
+// The geometry is stored in local coordinates and can be drawn with any transform and paint.
+// The tessellation tolerance, stroke style and anti-aliasing fringe are those at the time of
+// compiling, and are scaled with the path when it is drawn. Drawing at a much larger scale than
+// the path was compiled at shows the flattening and blurs the edges, drawing at a much smaller
+// scale makes the edges aliased. Compile the path again when its scale changes for good.
+
+// Compiles the current path with the current transform and stroke style.
+// Returns NULL if the path could not be compiled.
+NVGcompiledPath* nvgCompilePath(NVGcontext* ctx);
+
+// Fills the compiled path with current fill style and transform.
+void nvgFillCompiledPath(NVGcontext* ctx, NVGcompiledPath* path);
+
+// Strokes the compiled path with current stroke paint and transform.
+void nvgStrokeCompiledPath(NVGcontext* ctx, NVGcompiledPath* path);
+
+// Deletes a compiled path.
+void nvgDeleteCompiledPath(NVGcontext* ctx, NVGcompiledPath* path);
+
+//
+// Tessellation cache
+//
+// Fills and strokes are looked up in a cache keyed on the path commands relative to the
+// translation of the current transform, and the fill or stroke style. Paths that are drawn
+// again in later frames reuse their expanded vertices, moved to the current translation.
+// Paths which only differ by less than 1/256 of a pixel share the same entry.
+
+// Sets the maximum memory in bytes used by the tessellation cache. Least recently used
+// entries are evicted to stay under the limit. Pass 0 to disable the cache.
+void nvgTessellationCacheSize(NVGcontext* ctx, int bytes);
+
+//
+// Frame arena
+//
+// Scratch memory which only lives for one frame, like the path commands, the flattened points
+// and the render back-end's draw calls, is bump allocated from one arena which is reset in
+// nvgBeginFrame(). The arena keeps the high-water mark of the previous frames, so once it is
+// warmed up a frame does not call the allocator at all.
+
+struct NVGarenaParams {
+    void* userPtr;
+    void* (*alloc)(void* uptr, int size);	// Allocates a block of the arena, malloc() when NULL.
+    void (*free)(void* uptr, void* ptr);	// Frees a block of the arena, free() when NULL.
+    int trimFrames;		// Shrinks the arena after this many consecutive frames used less than half of it. 0 never shrinks.
+};
+typedef struct NVGarenaParams NVGarenaParams;
+
+// Sets the allocator and the trim policy of the frame arena. Blocks allocated so far are
+// released with the allocator they came from at the next nvgBeginFrame().
+void nvgFrameArenaParams(NVGcontext* ctx, const NVGarenaParams* params);
+
+//
+// Tessellation threads
+//
+// With tessellation threads, fills and strokes which are not in the tessellation cache are
+// recorded, and flattened and expanded in parallel in nvgEndFrame() by the calling thread and
+// the worker threads. Draws reach the render back-end in the order they were issued.
+// The frame arenas of the workers use the default allocator.
+
+// Sets the number of worker threads besides the thread calling nvgEndFrame(). Pass 0 to
+// tessellate each path right away on the calling thread, which is the default.
+// Has no effect when nanovg is built with NVG_NO_THREADS.
+void nvgTessellationThreads(NVGcontext* ctx, int threads);
+
+// Returns the statistics of the current frame.
+void nvgGetFrameStats(NVGcontext* ctx, NVGframeStats* stats);
+
 
 //
 // Text
@@ -624,6 +724,35 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 // Words longer than the max width are slit at nearest character (i.e. no hyphenation).
 int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows);
 
+//
+// Glyph thread
+//
+// A glyph is rasterized the first time it is drawn, which can take long enough to miss a frame
+// when a lot of new text appears at once. The glyph thread rasterizes glyphs in the background
+// instead, either ahead of time with nvgPrewarmGlyphs(), or as they are first drawn with
+// nvgAsyncGlyphs(). Its glyphs are added to the atlas in nvgBeginFrame().
+// When nanovg is built with NVG_NO_THREADS or FreeType, glyphs are rasterized right away.
+
+// Rasterizes the glyphs of the specified string on the glyph thread, with the current font face
+// and blur, at each of the font sizes. The sizes are scaled like the font size in nvgText().
+void nvgPrewarmGlyphs(NVGcontext* ctx, const char* string, const char* end, const float* sizes, int nsizes);
+
+// Leaves glyphs missing from the atlas to the glyph thread instead of rasterizing them in nvgText().
+// They are skipped until they are ready, which usually means one frame. Disabled by default.
+void nvgAsyncGlyphs(NVGcontext* ctx, int enabled);
+
+//
+// Text run cache
+//
+// nvgText() looks the string up in a cache keyed on the string, font face, size, letter spacing,
+// blur and alignment. Strings drawn again in later frames reuse their glyph quads, moved to the
+// text position and transformed, instead of decoding the string and looking up every glyph.
+// Runs are laid out again when glyphs move in the font atlas.
+
+// Sets the maximum memory in bytes used by the text run cache. Least recently used runs are
+// evicted to stay under the limit. Pass 0 to disable the cache.
+void nvgTextCacheSize(NVGcontext* ctx, int bytes);
+
 //
 // Internal Render API
 //
@@ -654,17 +783,24 @@ struct NVGpath {
     int nstroke;
     int winding;
     int convex;
+    int nooverlap;
+    float bounds[4];
 };
 typedef struct NVGpath NVGpath;
 
 struct NVGparams {
     void* userPtr;
     int edgeAntiAlias;
+    // Glyphs are rasterized once as signed distance fields and scaled, the font atlas gets NVG_IMAGE_SDF.
+    // The back-end softens the edge by paint->feather pixels to blur text.
+    int sdfText;
     int (*renderCreate)(void* uptr);
     int (*renderCreateTexture)(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data);
     int (*renderDeleteTexture)(void* uptr, int image);
     int (*renderUpdateTexture)(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data);
     int (*renderGetTextureSize)(void* uptr, int image, int* w, int* h);
+    // Optional, copies the top left w x h texels of image src into image dst.
+    int (*renderCopyTexture)(void* uptr, int dst, int src, int w, int h);
     void (*renderViewport)(void* uptr, float width, float height, float devicePixelRatio);
     void (*renderCancel)(void* uptr);
     void (*renderFlush)(void* uptr);
@@ -681,6 +817,19 @@ void nvgDeleteInternal(NVGcontext* ctx);
 
 NVGparams* nvgInternalParams(NVGcontext* ctx);
 
+// Frame arena shared with the render back-end. Memory returned by nvgArenaAlloc() and
+// nvgArenaRealloc() is valid until the next nvgBeginFrame(), after which the back-end
+// should allocate its per frame buffers again, e.g. in renderViewport.
+typedef struct NVGarena NVGarena;
+NVGarena* nvgInternalArena(NVGcontext* ctx);
+void* nvgArenaAlloc(NVGarena* arena, int size);
+// Grows or shrinks an allocation of size bytes to nsize bytes. Grows in place if ptr is the
+// most recent allocation, otherwise copies. The old memory is reclaimed at the next frame.
+void* nvgArenaRealloc(NVGarena* arena, void* ptr, int size, int nsize);
+// Sets for how many frames allocations stay valid, 1 by default. Back-ends which read a frame
+// while the next one is recorded use 2. Must be called before the first frame.
+void nvgArenaFrames(NVGarena* arena, int frames);
+
 // Debug function to dump cached path data.
 void nvgDebugDumpPathCache(NVGcontext* ctx);
 
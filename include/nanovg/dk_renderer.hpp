@@ -1,9 +1,16 @@
 #pragma once
 
 #include <deko3d.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <vector>
 
 #include "framework/CDescriptorSet.h"
@@ -21,6 +28,18 @@ enum NVGcreateFlags {
     NVG_STENCIL_STROKES	= 1<<1,
     // Flag indicating that additional debug checks are done.
     NVG_DEBUG 			= 1<<2,
+    // Flag indicating that the renderer draws into its own multisampled render target, which is resolved
+    // into the image set with DkRenderer::SetResolveTarget() on flush. Geometry based anti-aliasing is not used,
+    // so the resolve target must be set before nvgCreateDk(), which fails without it.
+    // Each flush clears the target to the color set with DkRenderer::SetClearColor(), and the resolve replaces
+    // the whole resolve target, so nanovg does not draw over what the application rendered there before.
+    NVG_MSAA			= 1<<3,
+    // Flag indicating that nvgEndFrame() hands the frame to a render thread owned by the DkRenderer, which
+    // records and submits it while the application builds the next frame. See DkRenderer::SetFlushCallback().
+    NVG_PIPELINED		= 1<<4,
+    // Flag indicating that glyphs are rasterized once as signed distance fields and drawn at any size,
+    // instead of being cached for every font size. Suits zooming and many sizes, small text looks softer.
+    NVG_SDF_TEXT		= 1<<5,
 };
 
 enum DKNVGuniformLoc
@@ -56,6 +75,7 @@ enum DKNVGcallType {
     DKNVG_FILL,
     DKNVG_CONVEXFILL,
     DKNVG_STROKE,
+    DKNVG_STENCILSTROKE,
     DKNVG_TRIANGLES,
 };
 
@@ -102,7 +122,8 @@ struct DKNVGcontext {
     float view[2];
     int fragSize;
     int flags;
-    // Per frame buffers
+    // Per frame buffers, allocated from the frame arena of the nanovg context.
+    NVGarena* arena;
     DKNVGcall* calls;
     int ccalls;
     int ncalls;
@@ -115,6 +136,11 @@ struct DKNVGcontext {
     unsigned char* uniforms;
     int cuniforms;
     int nuniforms;
+    // Peak use during the last frame, which sizes the buffers of the next frame.
+    int peakCalls;
+    int peakPaths;
+    int peakVerts;
+    int peakUniforms;
 };
 
 namespace nvg {
@@ -140,6 +166,27 @@ namespace nvg {
             dk::ImageDescriptor &GetImageDescriptor();
     };
 
+    class RenderTarget {
+        private:
+            dk::Image m_color_image;
+            dk::Image m_depth_stencil_image;
+            CMemPool::Handle m_color_mem;
+            CMemPool::Handle m_depth_stencil_mem;
+            DkMsMode m_ms_mode;
+            u32 m_width;
+            u32 m_height;
+        public:
+            RenderTarget();
+            ~RenderTarget();
+
+            void Initialize(CMemPool &image_pool, dk::Device device, u32 width, u32 height, DkMsMode ms_mode);
+            bool IsInitialized();
+
+            void Bind(dk::CmdBuf cmd_buf);
+            void Clear(dk::CmdBuf cmd_buf, const NVGcolor &color);
+            void Resolve(dk::CmdBuf cmd_buf, dk::Image &dst);
+    };
+
     class DkRenderer {
         private:
             enum SamplerType : u8 {
@@ -153,6 +200,34 @@ namespace nvg {
             static constexpr size_t DynamicCmdSize = 0x20000;
             static constexpr size_t FragmentUniformSize = sizeof(DKNVGfragUniforms) + 4 - sizeof(DKNVGfragUniforms) % 4;
             static constexpr size_t MaxImages = 0x1000;
+            static constexpr DkMsMode MultisampleMode = DkMsMode_4x;
+            /* Not tuned on hardware yet, see tests/recording_scaling.cpp. */
+            static constexpr size_t MaxRecordingThreads = 3;
+            static constexpr int MinCallsPerRecordingThread = 256;
+            static constexpr size_t UploadBufferSize = 0x40000;
+
+            struct RecordingWorker {
+                dk::UniqueCmdBuf cmd_buf;
+                CCmdMemRing<1> cmd_mem;
+                DkCmdList cmd_list;
+                u32 generation;
+                int call_begin;
+                int call_end;
+                std::thread thread;
+            };
+
+            struct PendingUpload {
+                std::shared_ptr<Texture> texture;
+                DkImageRect rect;
+                size_t offset;
+            };
+
+            struct UploadBatch {
+                std::optional<CMemPool::Handle> buffer;
+                size_t offset = 0;
+                std::vector<PendingUpload> uploads;
+                dk::Fence fence;
+            };
 
             /* From the application. */
             u32 m_view_width;
@@ -172,6 +247,11 @@ namespace nvg {
             CMemPool::Handle m_view_uniform_buffer;
             CMemPool::Handle m_frag_uniform_buffer;
 
+            /* Texture updates, staged here and copied into the textures before the frame they were made for draws anything. */
+            /* With NVG_PIPELINED the frame being built stages into one batch while the render thread copies the other. */
+            std::array<UploadBatch, 2> m_upload_batches;
+            u32 m_upload_batch = 0;
+
             u32 m_next_texture_id = 1;
             std::vector<std::shared_ptr<Texture>> m_textures;
             CDescriptorSet<MaxImages> m_image_descriptor_set;
@@ -179,18 +259,63 @@ namespace nvg {
             std::array<int, MaxImages> m_image_descriptor_mappings;
             int m_last_image_descriptor = 0;
 
+            /* Multisampling. */
+            RenderTarget m_render_target;
+            dk::Image *m_resolve_target = nullptr;
+            NVGcolor m_clear_color = {};
+
+            /* Textures of the calls being flushed, resolved before recording so the calls can be recorded in parallel. */
+            std::vector<std::optional<DkResHandle>> m_call_textures;
+
+            /* Parallel recording. */
+            std::vector<std::unique_ptr<RecordingWorker>> m_recording_workers;
+            std::mutex m_recording_mutex;
+            std::condition_variable m_recording_cond;
+            std::condition_variable m_recording_done_cond;
+            const DKNVGcontext *m_recording_ctx = nullptr;
+            u32 m_recording_generation = 0;
+            int m_recording_pending = 0;
+            bool m_recording_quit = false;
+
+            /* Statistics of the last flush, written by the render thread with NVG_PIPELINED. */
+            std::atomic<u32> m_single_pass_stroke_count = 0;
+
+            /* Guards the queue, the textures, the image descriptors and the resolve target, which the render thread uses while flushing. */
+            std::mutex m_queue_mutex;
+            std::function<void()> m_flush_callback;
+
+            /* Pipelining, only used with NVG_PIPELINED. */
+            std::thread m_render_thread;
+            std::mutex m_frame_mutex;
+            std::condition_variable m_frame_cond;
+            DKNVGcontext m_pending_frame = {};
+            u32 m_pending_upload_batch = 0;
+            bool m_frame_pending = false;
+            bool m_quit = false;
+            std::atomic<u64> m_submit_wait_ns = 0;
+            std::atomic<u64> m_render_wait_ns = 0;
+
             int AcquireImageDescriptor(std::shared_ptr<Texture> texture, int image);
             void FreeImageDescriptor(int image);
-            void SetUniforms(const DKNVGcontext &ctx, int offset, int image);
+            std::optional<DkResHandle> AcquireTextureHandle(int image);
+            void SetUniforms(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, int offset, std::optional<DkResHandle> texture);
 
             void UpdateVertexBuffer(const void *data, size_t size);
+            void RecordUploads(dk::CmdBuf cmd_buf, UploadBatch &batch);
+            void SubmitUploads(UploadBatch &batch);
 
-            void DrawFill(const DKNVGcontext &ctx, const DKNVGcall &call);
-            void DrawConvexFill(const DKNVGcontext &ctx, const DKNVGcall &call);
-            void DrawStroke(const DKNVGcontext &ctx, const DKNVGcall &call);
-            void DrawTriangles(const DKNVGcontext &ctx, const DKNVGcall &call);
+            void DrawFill(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture);
+            void DrawConvexFill(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture);
+            void DrawStroke(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture);
+            void DrawTriangles(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture);
+            void RecordCalls(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, int begin, int end);
+            void FlushFrame(DKNVGcontext &ctx, UploadBatch &uploads);
 
             std::shared_ptr<Texture> FindTexture(int id);
+
+            void RenderThreadMain();
+            void RecordingThreadMain(RecordingWorker *worker);
+            void StopRecordingThreads();
         public:
             DkRenderer(unsigned int view_width, unsigned int view_height, dk::Device device, dk::Queue queue, CMemPool &image_mem_pool, CMemPool &code_mem_pool, CMemPool &data_mem_pool);
             ~DkRenderer();
@@ -199,10 +324,40 @@ namespace nvg {
             int CreateTexture(const DKNVGcontext &ctx, int type, int w, int h, int image_flags, const u8 *data);
             int DeleteTexture(const DKNVGcontext &ctx, int id);
             int UpdateTexture(const DKNVGcontext &ctx, int id, int x, int y, int w, int h, const u8 *data);
+            int CopyTexture(const DKNVGcontext &ctx, int dst, int src, int w, int h);
             int GetTextureSize(const DKNVGcontext &ctx, int id, int *w, int *h);
             const DKNVGtextureDescriptor *GetTextureDescriptor(const DKNVGcontext &ctx, int id);
 
             void Flush(DKNVGcontext &ctx);
+
+            /* Hands the frame and its texture updates to the render thread and resets the per frame buffers of the context. */
+            /* Waits if the previous frame is still being flushed. */
+            void Submit(DKNVGcontext &ctx);
+            /* Waits until the render thread has flushed the last submitted frame. */
+            void WaitIdle();
+
+            /* Only used with NVG_MSAA, and required by it. The resolve target must be an RGBA8 image of the view size. */
+            /* Its contents are replaced on every flush, draw the background with nanovg or set it with SetClearColor(). */
+            /* Frames flushed while no resolve target is set are dropped. */
+            void SetResolveTarget(dk::Image *image);
+            void SetClearColor(const NVGcolor &color);
+
+            /* Number of threads besides the flushing one which record the calls of large frames, up to MaxRecordingThreads. */
+            /* Each thread records a contiguous range of calls into its own command buffer, and the lists are submitted in order. */
+            void SetRecordingThreads(u32 count);
+
+            /* Called after each flush with the queue lock held. With NVG_PIPELINED this runs on the render thread, and is where */
+            /* the application should present the frame and submit any other work to the queue. */
+            void SetFlushCallback(std::function<void()> callback);
+
+            /* Number of stroked paths drawn in a single pass during the last flush despite NVG_STENCIL_STROKES, as they */
+            /* cannot overlap themselves. */
+            u32 GetSinglePassStrokeCount();
+
+            /* Time nvgEndFrame() waited for the render thread to finish the previous frame, with NVG_PIPELINED. */
+            u64 GetSubmitWaitTime();
+            /* Time the render thread waited for the last frame to be submitted, with NVG_PIPELINED. */
+            u64 GetRenderWaitTime();
     };
 
 }
\ No newline at end of file
@@ -24,6 +24,9 @@
 enum FONSflags {
     FONS_ZERO_TOPLEFT = 1,
     FONS_ZERO_BOTTOMLEFT = 2,
+    // Glyphs are signed distance fields rasterized once at FONS_SDF_SIZE, and scaled to the requested size.
+    // Blur is not applied, the renderer is expected to soften the edge instead.
+    FONS_SDF = 4,
 };
 
 enum FONSalign {
@@ -41,6 +44,8 @@ enum FONSalign {
 enum FONSglyphBitmap {
     FONS_GLYPH_BITMAP_OPTIONAL = 1,
     FONS_GLYPH_BITMAP_REQUIRED = 2,
+    // Reserves the space of new glyphs in the atlas, they are rasterized later by fonsRasterizeGlyphBatch().
+    FONS_GLYPH_BITMAP_DEFERRED = 3,
 };
 
 enum FONSerrorCode {
@@ -79,15 +84,19 @@ struct FONStextIter {
     short isize, iblur;
     struct FONSfont* font;
     int prevGlyphIndex;
+    unsigned int prevCodepoint;
     const char* str;
     const char* next;
     const char* end;
     unsigned int utf8state;
     int bitmapOption;
+    int pending;	// The glyph of the last quad is reserved but not rasterized yet, only with FONS_GLYPH_BITMAP_DEFERRED.
+    int page;		// Atlas page of the glyph of the last quad, see fonsTouchPage().
 };
 typedef struct FONStextIter FONStextIter;
 
 typedef struct FONScontext FONScontext;
+typedef struct FONSglyphBatch FONSglyphBatch;
 
 // Constructor and destructor.
 FONScontext* fonsCreateInternal(FONSparams* params);
@@ -100,6 +109,15 @@ void fonsGetAtlasSize(FONScontext* s, int* width, int* height);
 int fonsExpandAtlas(FONScontext* s, int width, int height);
 // Resets the whole stash.
 int fonsResetAtlas(FONScontext* stash, int width, int height);
+// Starts a new frame. When the atlas is full, glyphs on the atlas page least recently drawn from are evicted,
+// as long as that page was not used during this frame or the previous one.
+void fonsBeginFrame(FONScontext* s);
+// Changes whenever the atlas is expanded or reset, after which earlier quads are no longer valid.
+int fonsAtlasGeneration(FONScontext* s);
+// Changes whenever the glyphs on an atlas page are evicted, after which earlier quads from that page are no longer valid.
+int fonsPageGeneration(FONScontext* s, int page);
+// Marks an atlas page as drawn from this frame, for quads kept from an earlier frame instead of fonsTextIterNext().
+void fonsTouchPage(FONScontext* s, int page);
 
 // Add fonts
 int fonsAddFont(FONScontext* s, const char* name, const char* path, int fontIndex);
@@ -130,10 +148,25 @@ void fonsVertMetrics(FONScontext* s, float* ascender, float* descender, float* l
 // Text iterator
 int fonsTextIterInit(FONScontext* stash, FONStextIter* iter, float x, float y, const char* str, const char* end, int bitmapOption);
 int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* quad);
+// Gets the bitmap of the glyph of the last quad from an iterator initialized with FONS_GLYPH_BITMAP_OPTIONAL,
+// and sets the texture coordinates of the quad. Returns 0 if the glyph does not fit the atlas.
+int fonsTextIterGlyph(FONScontext* stash, FONStextIter* iter, struct FONSquad* quad, int bitmapOption);
 
 // Pull texture changes
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
+// Returns the number of dirty regions and points 'rects' at them as x0,y0,x1,y1 quads, valid until the next glyph is added.
+int fonsValidateTextureRects(FONScontext* s, const int** rects);
+
+// Deferred glyphs
+// Takes the glyphs reserved with FONS_GLYPH_BITMAP_DEFERRED since the last call, NULL if there are none.
+FONSglyphBatch* fonsTakeGlyphBatch(FONScontext* s);
+// Rasterizes the glyphs of the batch. Only reads the font data, so it may run on another thread.
+// Not supported with FreeType, where deferred glyphs are rasterized right away.
+void fonsRasterizeGlyphBatch(FONSglyphBatch* batch);
+// Copies the rasterized glyphs into the atlas and deletes the batch. Glyphs evicted in the meantime are skipped.
+void fonsApplyGlyphBatch(FONScontext* s, FONSglyphBatch* batch);
+void fonsDeleteGlyphBatch(FONSglyphBatch* batch);
 
 // Draws the stash texture for debugging
 void fonsDrawDebug(FONScontext* s, float x, float y);
@@ -145,6 +178,25 @@ void fonsDrawDebug(FONScontext* s, float x, float y);
 
 #define FONS_NOTUSED(v)  (void)sizeof(v)
 
+// The glyph blur uses vector kernels, chosen at compile time.
+// Define FONS_NO_SIMD to force the scalar version.
+#if !defined(FONS_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FONS_SIMD_NEON
+#elif !defined(FONS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FONS_SIMD_SSE2
+#endif
+
+// Bump allocator for the temporary memory of stb_truetype, one for each thread rasterizing glyphs.
+struct FONSscratch
+{
+    unsigned char* data;
+    int n;
+    FONScontext* stash;	// Reports overflows to the error callback, when set.
+};
+typedef struct FONSscratch FONSscratch;
+
 #ifdef FONS_USE_FREETYPE
 
 #include <ft2build.h>
@@ -245,6 +297,19 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
     }
 }
 
+void fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+                             float scale, int pad, int glyph)
+{
+    // No distance fields with FreeType, the coverage has its edge at 0.5 too and is a rough stand-in.
+    fons__tt_renderGlyphBitmap(font, &output[pad + pad * outStride], outWidth-pad*2, outHeight-pad*2, outStride, scale, scale, glyph);
+}
+
+void fons__tt_setScratch(FONSttFontImpl *font, FONSscratch *scratch)
+{
+    FONS_NOTUSED(font);
+    FONS_NOTUSED(scratch);
+}
+
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 {
     FT_Vector ftKerning;
@@ -281,9 +346,9 @@ int fons__tt_done(FONScontext *context)
 int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char *data, int dataSize, int fontIndex)
 {
     int offset, stbError;
+    FONS_NOTUSED(context);
     FONS_NOTUSED(dataSize);
 
-    font->font.userdata = context;
     offset = stbtt_GetFontOffsetForIndex(data, fontIndex);
     if (offset == -1) {
         stbError = 0;
@@ -323,6 +388,24 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
     stbtt_MakeGlyphBitmap(&font->font, output, outWidth, outHeight, outStride, scaleX, scaleY, glyph);
 }
 
+void fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+                             float scale, int pad, int glyph)
+{
+    int x, y, w, h, xoff, yoff;
+    unsigned char* sdf = stbtt_GetGlyphSDF(&font->font, scale, glyph, pad, 128, 128.0f / pad, &w, &h, &xoff, &yoff);
+    if (sdf == NULL) return; // Empty glyph.
+    // The field covers the glyph box with the padding, like the output.
+    for (y = 0; y < h && y < outHeight; y++)
+        for (x = 0; x < w && x < outWidth; x++)
+            output[y * outStride + x] = sdf[y * w + x];
+    stbtt_FreeSDF(sdf, font->font.userdata);
+}
+
+void fons__tt_setScratch(FONSttFontImpl *font, FONSscratch *scratch)
+{
+    font->font.userdata = scratch;
+}
+
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 {
     return stbtt_GetGlyphKernAdvance(&font->font, glyph1, glyph2);
@@ -330,6 +413,12 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 
 #endif
 
+#ifndef FONS_SDF_SIZE
+#	define FONS_SDF_SIZE 32
+#endif
+#ifndef FONS_SDF_PAD
+#	define FONS_SDF_PAD 6
+#endif
 #ifndef FONS_SCRATCH_BUF_SIZE
 #	define FONS_SCRATCH_BUF_SIZE 96000
 #endif
@@ -339,12 +428,23 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 #ifndef FONS_INIT_FONTS
 #	define FONS_INIT_FONTS 4
 #endif
+#ifndef FONS_INIT_KERN_SIZE
+#	define FONS_INIT_KERN_SIZE 256
+#endif
+#define FONS_KERN_UNKNOWN (-32768)
+#define FONS_KERN_EMPTY 0xffffffffu
 #ifndef FONS_INIT_GLYPHS
 #	define FONS_INIT_GLYPHS 256
 #endif
 #ifndef FONS_INIT_ATLAS_NODES
 #	define FONS_INIT_ATLAS_NODES 256
 #endif
+#ifndef FONS_ATLAS_PAGES
+#	define FONS_ATLAS_PAGES 8
+#endif
+#ifndef FONS_MAX_DIRTY_RECTS
+#	define FONS_MAX_DIRTY_RECTS 32
+#endif
 #ifndef FONS_VERTEX_COUNT
 #	define FONS_VERTEX_COUNT 1024
 #endif
@@ -380,13 +480,22 @@ struct FONSglyph
 {
     unsigned int codepoint;
     int index;
-    int next;
     short size, blur;
+    short page, pending;
     short x0,y0,x1,y1;
     short xadv,xoff,yoff;
 };
 typedef struct FONSglyph FONSglyph;
 
+// Glyph of a codepoint in a font or in one of its fallback fonts.
+struct FONScodepointGlyph
+{
+    unsigned int codepoint;
+    struct FONSfont* font;	// Font with the glyph, NULL marks empty slots.
+    int index;				// Glyph index in that font, 0 when no font has the codepoint.
+};
+typedef struct FONScodepointGlyph FONScodepointGlyph;
+
 struct FONSfont
 {
     FONSttFontImpl font;
@@ -400,7 +509,16 @@ struct FONSfont
     FONSglyph* glyphs;
     int cglyphs;
     int nglyphs;
-    int lut[FONS_HASH_LUT_SIZE];
+    int* lut;			// Open addressing table of glyph indices keyed on codepoint, size and blur, -1 marks empty slots.
+    int clut;			// Size of the table, a power of two.
+    short* kernLatin;	// Kerning of Latin-1 codepoint pairs in font units, FONS_KERN_UNKNOWN until looked up.
+    unsigned int* kernKeys;	// Open addressing table of other glyph index pairs, FONS_KERN_EMPTY marks empty slots.
+    short* kernValues;
+    int ckern;
+    int nkern;
+    FONScodepointGlyph* cmap;	// Open addressing table of codepoints looked up in the font and its fallbacks.
+    int ccmap;
+    int ncmap;
     int fallbacks[FONS_MAX_FALLBACKS];
     int nfallbacks;
 };
@@ -431,22 +549,66 @@ struct FONSatlas
 };
 typedef struct FONSatlas FONSatlas;
 
+// Horizontal band of the atlas texture with its own packer, the unit of glyph eviction.
+struct FONSpage
+{
+    FONSatlas* atlas;
+    int y;
+    int lastUsed;
+    int generation;	// See fonsPageGeneration().
+};
+typedef struct FONSpage FONSpage;
+
+// Glyph reserved in the atlas by FONS_GLYPH_BITMAP_DEFERRED, waiting to be rasterized.
+struct FONSglyphJob
+{
+    FONSfont* font;
+    FONSttFontImpl renderFont;	// Copy of the font the glyph is rendered with, which may be a fallback font.
+    int glyph;					// Index in the glyphs of the font, checked against the rest before applying.
+    unsigned int codepoint;
+    short size, blur;
+    short x0, y0;
+    int index;
+    float scale;
+    int gw, gh, pad;
+    int sdf;
+    int offset;
+};
+typedef struct FONSglyphJob FONSglyphJob;
+
+struct FONSglyphBatch
+{
+    FONSglyphJob* jobs;
+    int njobs;
+    unsigned char* bitmaps;
+    FONSscratch scratch;
+};
+
 struct FONScontext
 {
     FONSparams params;
     float itw,ith;
     unsigned char* texData;
     int dirtyRect[4];
+    int dirtyRects[FONS_MAX_DIRTY_RECTS*4];
+    int ndirtyRects;
     FONSfont** fonts;
-    FONSatlas* atlas;
+    FONSpage* pages;
+    int npages;
+    int cpages;
+    int curPage;
+    int frame;
+    int generation;	// See fonsAtlasGeneration().
     int cfonts;
     int nfonts;
     float verts[FONS_VERTEX_COUNT*2];
     float tcoords[FONS_VERTEX_COUNT*2];
     unsigned int colors[FONS_VERTEX_COUNT];
     int nverts;
-    unsigned char* scratch;
-    int nscratch;
+    FONSscratch scratch;
+    FONSglyphJob* jobs;
+    int njobs;
+    int cjobs;
     FONSstate states[FONS_MAX_STATES];
     int nstates;
     void (*handleError)(void* uptr, int error, int val);
@@ -458,18 +620,18 @@ struct FONScontext
 static void* fons__tmpalloc(size_t size, void* up)
 {
     unsigned char* ptr;
-    FONScontext* stash = (FONScontext*)up;
+    FONSscratch* scratch = (FONSscratch*)up;
 
     // 16-byte align the returned pointer
     size = (size + 0xf) & ~0xf;
 
-    if (stash->nscratch+(int)size > FONS_SCRATCH_BUF_SIZE) {
-        if (stash->handleError)
-            stash->handleError(stash->errorUptr, FONS_SCRATCH_FULL, stash->nscratch+(int)size);
+    if (scratch->n+(int)size > FONS_SCRATCH_BUF_SIZE) {
+        if (scratch->stash != NULL && scratch->stash->handleError)
+            scratch->stash->handleError(scratch->stash->errorUptr, FONS_SCRATCH_FULL, scratch->n+(int)size);
         return NULL;
     }
-    ptr = stash->scratch + stash->nscratch;
-    stash->nscratch += (int)size;
+    ptr = scratch->data + scratch->n;
+    scratch->n += (int)size;
     return ptr;
 }
 
@@ -703,11 +865,72 @@ static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry
     return 1;
 }
 
+static void fons__resetDirty(FONScontext* stash)
+{
+    stash->dirtyRect[0] = stash->params.width;
+    stash->dirtyRect[1] = stash->params.height;
+    stash->dirtyRect[2] = 0;
+    stash->dirtyRect[3] = 0;
+    stash->ndirtyRects = 0;
+}
+
+static int fons__rectArea(const int* r)
+{
+    return (r[2] - r[0]) * (r[3] - r[1]);
+}
+
+// Adds a region to the dirty list, merging it into a region it touches.
+// When the list is full the region goes to the one that grows the least.
+static void fons__markDirty(FONScontext* stash, int x0, int y0, int x1, int y1)
+{
+    int i, best = -1, bestGrowth = 0;
+    int* r;
+
+    stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], x0);
+    stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], y0);
+    stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], x1);
+    stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], y1);
+
+    for (i = 0; i < stash->ndirtyRects; i++) {
+        int u[4], growth;
+        r = &stash->dirtyRects[i*4];
+        if (x0 <= r[2] && r[0] <= x1 && y0 <= r[3] && r[1] <= y1) {
+            best = i;
+            break;
+        }
+        u[0] = fons__mini(r[0], x0);
+        u[1] = fons__mini(r[1], y0);
+        u[2] = fons__maxi(r[2], x1);
+        u[3] = fons__maxi(r[3], y1);
+        growth = fons__rectArea(u) - fons__rectArea(r);
+        if (best == -1 || growth < bestGrowth) {
+            best = i;
+            bestGrowth = growth;
+        }
+    }
+
+    if (i == stash->ndirtyRects && stash->ndirtyRects < FONS_MAX_DIRTY_RECTS) {
+        r = &stash->dirtyRects[stash->ndirtyRects*4];
+        stash->ndirtyRects++;
+        r[0] = x0;
+        r[1] = y0;
+        r[2] = x1;
+        r[3] = y1;
+        return;
+    }
+
+    r = &stash->dirtyRects[best*4];
+    r[0] = fons__mini(r[0], x0);
+    r[1] = fons__mini(r[1], y0);
+    r[2] = fons__maxi(r[2], x1);
+    r[3] = fons__maxi(r[3], y1);
+}
+
 static void fons__addWhiteRect(FONScontext* stash, int w, int h)
 {
     int x, y, gx, gy;
     unsigned char* dst;
-    if (fons__atlasAddRect(stash->atlas, w, h, &gx, &gy) == 0)
+    if (stash->npages == 0 || fons__atlasAddRect(stash->pages[0].atlas, w, h, &gx, &gy) == 0)
         return;
 
     // Rasterize
@@ -718,10 +941,110 @@ static void fons__addWhiteRect(FONScontext* stash, int w, int h)
         dst += stash->params.width;
     }
 
-    stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], gx);
-    stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], gy);
-    stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], gx+w);
-    stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], gy+h);
+    fons__markDirty(stash, gx, gy, gx+w, gy+h);
+}
+
+// Splits the rows y to y+height of the atlas texture into npages pages.
+static int fons__addPages(FONScontext* stash, int y, int width, int height, int npages)
+{
+    int i;
+    if (stash->npages+npages > stash->cpages) {
+        FONSpage* pages = (FONSpage*)realloc(stash->pages, sizeof(FONSpage) * (stash->npages+npages));
+        if (pages == NULL) return 0;
+        stash->pages = pages;
+        stash->cpages = stash->npages+npages;
+    }
+    for (i = 0; i < npages; i++) {
+        FONSpage* page = &stash->pages[stash->npages];
+        int y0 = y + height*i/npages;
+        int y1 = y + height*(i+1)/npages;
+        page->atlas = fons__allocAtlas(width, y1-y0, FONS_INIT_ATLAS_NODES);
+        if (page->atlas == NULL) return 0;
+        page->y = y0;
+        page->lastUsed = stash->frame-2;
+        page->generation = 0;
+        stash->npages++;
+    }
+    return 1;
+}
+
+static void fons__deletePages(FONScontext* stash)
+{
+    int i;
+    for (i = 0; i < stash->npages; i++)
+        fons__deleteAtlas(stash->pages[i].atlas);
+    stash->npages = 0;
+    stash->curPage = 0;
+}
+
+static void fons__evictPage(FONScontext* stash, int idx)
+{
+    FONSpage* page = &stash->pages[idx];
+    int i, j;
+
+    // Glyphs on the page keep their metrics, and are rasterized again when drawn.
+    page->generation++;
+    for (i = 0; i < stash->nfonts; i++) {
+        FONSfont* font = stash->fonts[i];
+        for (j = 0; j < font->nglyphs; j++) {
+            FONSglyph* glyph = &font->glyphs[j];
+            if (glyph->page == idx && glyph->x0 >= 0) {
+                glyph->x0 = -1;
+                glyph->y0 = -1;
+            }
+        }
+    }
+
+    // Clear the page so that old glyphs do not show up in the padding of new ones.
+    fons__atlasReset(page->atlas, page->atlas->width, page->atlas->height);
+    memset(&stash->texData[page->y * stash->params.width], 0, page->atlas->height * stash->params.width);
+    fons__markDirty(stash, 0, page->y, stash->params.width, page->y + page->atlas->height);
+
+    if (idx == 0)
+        fons__addWhiteRect(stash, 2,2);
+}
+
+static int fons__pageAddRect(FONScontext* stash, int idx, int rw, int rh, int* rx, int* ry)
+{
+    if (fons__atlasAddRect(stash->pages[idx].atlas, rw, rh, rx, ry) == 0)
+        return 0;
+    *ry += stash->pages[idx].y;
+    stash->curPage = idx;
+    return 1;
+}
+
+// Finds space for a glyph on the atlas pages. New glyphs go to the current page. When it is full, the page
+// least recently drawn from becomes the current one and is evicted if needed, unless it was used during this
+// frame or the previous one, which may still be rendering.
+static int fons__addGlyphRect(FONScontext* stash, int rw, int rh, int* rx, int* ry, int* rpage)
+{
+    int i, coldest = -1;
+    if (stash->curPage < stash->npages && fons__pageAddRect(stash, stash->curPage, rw, rh, rx, ry)) {
+        *rpage = stash->curPage;
+        return 1;
+    }
+    for (i = 0; i < stash->npages; i++) {
+        FONSpage* page = &stash->pages[i];
+        if (i != stash->curPage && page->lastUsed+1 < stash->frame && (coldest == -1 || page->lastUsed < stash->pages[coldest].lastUsed))
+            coldest = i;
+    }
+    if (coldest != -1) {
+        if (!fons__pageAddRect(stash, coldest, rw, rh, rx, ry)) {
+            fons__evictPage(stash, coldest);
+            if (!fons__pageAddRect(stash, coldest, rw, rh, rx, ry))
+                return 0;
+        }
+    } else {
+        // All pages are in use, take any space left.
+        for (i = 0; i < stash->npages; i++) {
+            if (fons__pageAddRect(stash, i, rw, rh, rx, ry))
+                break;
+        }
+        if (i == stash->npages)
+            return 0;
+    }
+    *rpage = stash->curPage;
+    return 1;
 }
 
 FONScontext* fonsCreateInternal(FONSparams* params)
@@ -736,8 +1059,9 @@ FONScontext* fonsCreateInternal(FONSparams* params)
     stash->params = *params;
 
     // Allocate scratch buffer.
-    stash->scratch = (unsigned char*)malloc(FONS_SCRATCH_BUF_SIZE);
-    if (stash->scratch == NULL) goto error;
+    stash->scratch.data = (unsigned char*)malloc(FONS_SCRATCH_BUF_SIZE);
+    if (stash->scratch.data == NULL) goto error;
+    stash->scratch.stash = stash;
 
     // Initialize implementation library
     if (!fons__tt_init(stash)) goto error;
@@ -747,8 +1071,7 @@ FONScontext* fonsCreateInternal(FONSparams* params)
             goto error;
     }
 
-    stash->atlas = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
-    if (stash->atlas == NULL) goto error;
+    if (!fons__addPages(stash, 0, stash->params.width, stash->params.height, FONS_ATLAS_PAGES)) goto error;
 
     // Allocate space for fonts.
     stash->fonts = (FONSfont**)malloc(sizeof(FONSfont*) * FONS_INIT_FONTS);
@@ -764,10 +1087,7 @@ FONScontext* fonsCreateInternal(FONSparams* params)
     if (stash->texData == NULL) goto error;
     memset(stash->texData, 0, stash->params.width * stash->params.height);
 
-    stash->dirtyRect[0] = stash->params.width;
-    stash->dirtyRect[1] = stash->params.height;
-    stash->dirtyRect[2] = 0;
-    stash->dirtyRect[3] = 0;
+    fons__resetDirty(stash);
 
     // Add white rect at 0,0 for debug drawing.
     fons__addWhiteRect(stash, 2,2);
@@ -787,11 +1107,25 @@ static FONSstate* fons__getState(FONScontext* stash)
     return &stash->states[stash->nstates-1];
 }
 
+// Forgets which font has the glyph of each codepoint, after the fallbacks have changed.
+static void fons__resetCodepoints(FONSfont* font)
+{
+    if (font->cmap != NULL)
+        memset(font->cmap, 0, sizeof(FONScodepointGlyph) * font->ccmap);
+    font->ncmap = 0;
+    // The Latin-1 kerning is keyed on codepoints too.
+    if (font->kernLatin != NULL) {
+        free(font->kernLatin);
+        font->kernLatin = NULL;
+    }
+}
+
 int fonsAddFallbackFont(FONScontext* stash, int base, int fallback)
 {
     FONSfont* baseFont = stash->fonts[base];
     if (baseFont->nfallbacks < FONS_MAX_FALLBACKS) {
         baseFont->fallbacks[baseFont->nfallbacks++] = fallback;
+        fons__resetCodepoints(baseFont);
         return 1;
     }
     return 0;
@@ -804,8 +1138,9 @@ void fonsResetFallbackFont(FONScontext* stash, int base)
     FONSfont* baseFont = stash->fonts[base];
     baseFont->nfallbacks = 0;
     baseFont->nglyphs = 0;
-    for (i = 0; i < FONS_HASH_LUT_SIZE; i++)
+    for (i = 0; i < baseFont->clut; i++)
         baseFont->lut[i] = -1;
+    fons__resetCodepoints(baseFont);
 }
 
 void fonsSetSize(FONScontext* stash, float size)
@@ -875,6 +1210,11 @@ static void fons__freeFont(FONSfont* font)
 {
     if (font == NULL) return;
     if (font->glyphs) free(font->glyphs);
+    if (font->lut) free(font->lut);
+    if (font->kernLatin) free(font->kernLatin);
+    if (font->kernKeys) free(font->kernKeys);
+    if (font->kernValues) free(font->kernValues);
+    if (font->cmap) free(font->cmap);
     if (font->freeData && font->data) free(font->data);
     free(font);
 }
@@ -897,6 +1237,10 @@ static int fons__allocFont(FONScontext* stash)
     font->cglyphs = FONS_INIT_GLYPHS;
     font->nglyphs = 0;
 
+    font->lut = (int*)malloc(sizeof(int) * FONS_HASH_LUT_SIZE);
+    if (font->lut == NULL) goto error;
+    font->clut = FONS_HASH_LUT_SIZE;
+
     stash->fonts[stash->nfonts++] = font;
     return stash->nfonts-1;
 
@@ -949,7 +1293,7 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
     font->name[sizeof(font->name)-1] = '\0';
 
     // Init hash lookup.
-    for (i = 0; i < FONS_HASH_LUT_SIZE; ++i)
+    for (i = 0; i < font->clut; ++i)
         font->lut[i] = -1;
 
     // Read in the font data.
@@ -958,7 +1302,8 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
     font->freeData = (unsigned char)freeData;
 
     // Init font
-    stash->nscratch = 0;
+    stash->scratch.n = 0;
+    fons__tt_setScratch(&font->font, &stash->scratch);
     if (!fons__tt_loadFont(stash, &font->font, data, dataSize, fontIndex)) goto error;
 
     // Store normalized line height. The real line height is got
@@ -1000,6 +1345,203 @@ static FONSglyph* fons__allocGlyph(FONSfont* font)
     return &font->glyphs[font->nglyphs-1];
 }
 
+static unsigned int fons__hashGlyph(unsigned int codepoint, short isize, short iblur)
+{
+    return fons__hashint(codepoint ^ (((unsigned int)(unsigned short)isize << 5 | (unsigned int)iblur) * 0x9e3779b1u));
+}
+
+// Returns the slot holding the glyph, or the empty slot where it should be inserted.
+static int fons__findGlyphSlot(FONSfont* font, unsigned int codepoint, short isize, short iblur)
+{
+    int mask = font->clut-1;
+    int slot = (int)(fons__hashGlyph(codepoint, isize, iblur) & (unsigned int)mask);
+    int i;
+    while ((i = font->lut[slot]) != -1) {
+        if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur)
+            break;
+        slot = (slot+1) & mask;
+    }
+    return slot;
+}
+
+// Doubles the hash lookup, keeping it at most half full so probe sequences stay short.
+static int fons__growGlyphLut(FONSfont* font)
+{
+    int i, j, clut = font->clut*2, mask = clut-1;
+    int* lut = (int*)malloc(sizeof(int) * clut);
+    if (lut == NULL) return 0;
+    for (i = 0; i < clut; i++)
+        lut[i] = -1;
+    for (i = 0; i < font->nglyphs; i++) {
+        FONSglyph* glyph = &font->glyphs[i];
+        j = (int)(fons__hashGlyph(glyph->codepoint, glyph->size, glyph->blur) & (unsigned int)mask);
+        while (lut[j] != -1)
+            j = (j+1) & mask;
+        lut[j] = i;
+    }
+    free(font->lut);
+    font->lut = lut;
+    font->clut = clut;
+    return 1;
+}
+
+static int fons__findKernSlot(FONSfont* font, unsigned int key)
+{
+    int mask = font->ckern-1;
+    int slot = (int)(fons__hashint(key) & (unsigned int)mask);
+    while (font->kernKeys[slot] != FONS_KERN_EMPTY && font->kernKeys[slot] != key)
+        slot = (slot+1) & mask;
+    return slot;
+}
+
+// Doubles the kerning table, keeping it at most half full like the glyph lookup.
+static int fons__growKernTable(FONSfont* font)
+{
+    int i, j, ckern = font->ckern == 0 ? FONS_INIT_KERN_SIZE : font->ckern*2, mask = ckern-1;
+    unsigned int* keys = (unsigned int*)malloc(sizeof(unsigned int) * ckern);
+    short* values = (short*)malloc(sizeof(short) * ckern);
+    if (keys == NULL || values == NULL) {
+        if (keys) free(keys);
+        if (values) free(values);
+        return 0;
+    }
+    for (i = 0; i < ckern; i++)
+        keys[i] = FONS_KERN_EMPTY;
+    for (i = 0; i < font->ckern; i++) {
+        if (font->kernKeys[i] == FONS_KERN_EMPTY) continue;
+        j = (int)(fons__hashint(font->kernKeys[i]) & (unsigned int)mask);
+        while (keys[j] != FONS_KERN_EMPTY)
+            j = (j+1) & mask;
+        keys[j] = font->kernKeys[i];
+        values[j] = font->kernValues[i];
+    }
+    if (font->kernKeys) free(font->kernKeys);
+    if (font->kernValues) free(font->kernValues);
+    font->kernKeys = keys;
+    font->kernValues = values;
+    font->ckern = ckern;
+    return 1;
+}
+
+// Kerning between two glyphs in font units. Searching the kerning tables of the font is slow,
+// pairs are looked up once and kept in a dense table for Latin-1, and a hash table otherwise.
+static int fons__getKern(FONSfont* font, unsigned int cp1, int g1, unsigned int cp2, int g2)
+{
+#ifdef FONS_USE_FREETYPE
+    // FreeType kerning is scaled to the current size of the face, it cannot be kept per font.
+    FONS_NOTUSED(cp1);
+    FONS_NOTUSED(cp2);
+    return fons__tt_getGlyphKernAdvance(&font->font, g1, g2);
+#else
+    unsigned int key;
+    int i, slot, kern;
+
+    if (!font->font.font.kern && !font->font.font.gpos)
+        return 0;
+
+    if (cp1 < 256 && cp2 < 256) {
+        if (font->kernLatin == NULL) {
+            font->kernLatin = (short*)malloc(sizeof(short) * 256*256);
+            if (font->kernLatin == NULL)
+                return fons__tt_getGlyphKernAdvance(&font->font, g1, g2);
+            for (i = 0; i < 256*256; i++)
+                font->kernLatin[i] = FONS_KERN_UNKNOWN;
+        }
+        kern = font->kernLatin[cp1*256 + cp2];
+        if (kern == FONS_KERN_UNKNOWN) {
+            kern = fons__tt_getGlyphKernAdvance(&font->font, g1, g2);
+            if (kern > FONS_KERN_UNKNOWN && kern <= 32767)
+                font->kernLatin[cp1*256 + cp2] = (short)kern;
+        }
+        return kern;
+    }
+
+    key = ((unsigned int)g1 << 16) | (unsigned int)g2;
+    if (g1 > 0xffff || g2 > 0xffff || key == FONS_KERN_EMPTY)
+        return fons__tt_getGlyphKernAdvance(&font->font, g1, g2);
+    if ((font->nkern+1)*2 > font->ckern && !fons__growKernTable(font))
+        return fons__tt_getGlyphKernAdvance(&font->font, g1, g2);
+    slot = fons__findKernSlot(font, key);
+    if (font->kernKeys[slot] == key)
+        return font->kernValues[slot];
+
+    kern = fons__tt_getGlyphKernAdvance(&font->font, g1, g2);
+    if (kern > FONS_KERN_UNKNOWN && kern <= 32767) {
+        font->kernKeys[slot] = key;
+        font->kernValues[slot] = (short)kern;
+        font->nkern++;
+    }
+    return kern;
+#endif
+}
+
+static int fons__findCodepointSlot(FONSfont* font, unsigned int codepoint)
+{
+    int mask = font->ccmap-1;
+    int slot = (int)(fons__hashint(codepoint) & (unsigned int)mask);
+    while (font->cmap[slot].font != NULL && font->cmap[slot].codepoint != codepoint)
+        slot = (slot+1) & mask;
+    return slot;
+}
+
+// Doubles the codepoint table, keeping it at most half full like the glyph lookup.
+static int fons__growCodepoints(FONSfont* font)
+{
+    int i, j, ccmap = font->ccmap == 0 ? FONS_HASH_LUT_SIZE : font->ccmap*2, mask = ccmap-1;
+    FONScodepointGlyph* cmap = (FONScodepointGlyph*)malloc(sizeof(FONScodepointGlyph) * ccmap);
+    if (cmap == NULL) return 0;
+    memset(cmap, 0, sizeof(FONScodepointGlyph) * ccmap);
+    for (i = 0; i < font->ccmap; i++) {
+        if (font->cmap[i].font == NULL) continue;
+        j = (int)(fons__hashint(font->cmap[i].codepoint) & (unsigned int)mask);
+        while (cmap[j].font != NULL)
+            j = (j+1) & mask;
+        cmap[j] = font->cmap[i];
+    }
+    if (font->cmap) free(font->cmap);
+    font->cmap = cmap;
+    font->ccmap = ccmap;
+    return 1;
+}
+
+// Returns the glyph index of a codepoint and the font it is in, the font itself or the first fallback
+// font which has it. The answer is kept, also when no font has the codepoint and the index is 0.
+static int fons__getGlyphIndex(FONScontext* stash, FONSfont* font, unsigned int codepoint, FONSfont** renderFont)
+{
+    FONScodepointGlyph* entry = NULL;
+    int i, g;
+
+    if ((font->ncmap+1)*2 <= font->ccmap || fons__growCodepoints(font)) {
+        entry = &font->cmap[fons__findCodepointSlot(font, codepoint)];
+        if (entry->font != NULL) {
+            *renderFont = entry->font;
+            return entry->index;
+        }
+    }
+
+    *renderFont = font;
+    g = fons__tt_getGlyphIndex(&font->font, codepoint);
+    // Try to find the glyph in fallback fonts.
+    if (g == 0) {
+        for (i = 0; i < font->nfallbacks; ++i) {
+            FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
+            int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
+            if (fallbackIndex != 0) {
+                g = fallbackIndex;
+                *renderFont = fallbackFont;
+                break;
+            }
+        }
+    }
+
+    if (entry != NULL) {
+        entry->codepoint = codepoint;
+        entry->font = *renderFont;
+        entry->index = g;
+        font->ncmap++;
+    }
+    return g;
+}
 
 // Based on Exponential blur, Jani Huhtanen, 2006
 
@@ -1047,6 +1589,241 @@ static void fons__blurRows(unsigned char* dst, int w, int h, int dstStride, int
 }
 
 
+#if defined(FONS_SIMD_NEON) || defined(FONS_SIMD_SSE2)
+
+// The vector blur filters eight rows or columns at once, one 16 bit lane each. The filter state
+// z stays within 0..255 << ZPREC, so the lanes give the same result as the scalar passes.
+
+#if defined(FONS_SIMD_NEON)
+typedef int16x8_t FONSblurLanes;
+typedef int FONSblurAlpha;
+
+static FONSblurAlpha fons__blurAlpha(int alpha)
+{
+    return alpha;
+}
+
+static FONSblurLanes fons__blurLoad(const unsigned char* src)
+{
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src)));
+}
+
+static void fons__blurStore(unsigned char* dst, FONSblurLanes z)
+{
+    vst1_u8(dst, vqmovun_s16(vshrq_n_s16(z, ZPREC)));
+}
+
+static FONSblurLanes fons__blurStep(FONSblurLanes z, FONSblurLanes px, FONSblurAlpha alpha)
+{
+    int16x8_t d = vsubq_s16(vshlq_n_s16(px, ZPREC), z);
+    int32x4_t lo = vshrq_n_s32(vmulq_n_s32(vmovl_s16(vget_low_s16(d)), alpha), APREC);
+    int32x4_t hi = vshrq_n_s32(vmulq_n_s32(vmovl_s16(vget_high_s16(d)), alpha), APREC);
+    return vaddq_s16(z, vcombine_s16(vmovn_s32(lo), vmovn_s32(hi)));
+}
+
+static FONSblurLanes fons__blurZero(void)
+{
+    return vdupq_n_s16(0);
+}
+
+static FONSblurLanes fons__blurGetLanes(const short* src)
+{
+    return vld1q_s16(src);
+}
+
+static void fons__blurSetLanes(short* dst, FONSblurLanes z)
+{
+    vst1q_s16(dst, z);
+}
+
+static int16x8_t fons__blurLowHalves(int16x8_t a, int16x8_t b)
+{
+    int32x4_t a32 = vreinterpretq_s32_s16(a), b32 = vreinterpretq_s32_s16(b);
+    return vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(a32), vget_low_s32(b32)));
+}
+
+static int16x8_t fons__blurHighHalves(int16x8_t a, int16x8_t b)
+{
+    int32x4_t a32 = vreinterpretq_s32_s16(a), b32 = vreinterpretq_s32_s16(b);
+    return vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(a32), vget_high_s32(b32)));
+}
+
+static void fons__blurTranspose(FONSblurLanes* r)
+{
+    int16x8x2_t t01 = vtrnq_s16(r[0], r[1]), t23 = vtrnq_s16(r[2], r[3]);
+    int16x8x2_t t45 = vtrnq_s16(r[4], r[5]), t67 = vtrnq_s16(r[6], r[7]);
+    int32x4x2_t u02 = vtrnq_s32(vreinterpretq_s32_s16(t01.val[0]), vreinterpretq_s32_s16(t23.val[0]));
+    int32x4x2_t u13 = vtrnq_s32(vreinterpretq_s32_s16(t01.val[1]), vreinterpretq_s32_s16(t23.val[1]));
+    int32x4x2_t u46 = vtrnq_s32(vreinterpretq_s32_s16(t45.val[0]), vreinterpretq_s32_s16(t67.val[0]));
+    int32x4x2_t u57 = vtrnq_s32(vreinterpretq_s32_s16(t45.val[1]), vreinterpretq_s32_s16(t67.val[1]));
+    r[0] = fons__blurLowHalves(vreinterpretq_s16_s32(u02.val[0]), vreinterpretq_s16_s32(u46.val[0]));
+    r[1] = fons__blurLowHalves(vreinterpretq_s16_s32(u13.val[0]), vreinterpretq_s16_s32(u57.val[0]));
+    r[2] = fons__blurLowHalves(vreinterpretq_s16_s32(u02.val[1]), vreinterpretq_s16_s32(u46.val[1]));
+    r[3] = fons__blurLowHalves(vreinterpretq_s16_s32(u13.val[1]), vreinterpretq_s16_s32(u57.val[1]));
+    r[4] = fons__blurHighHalves(vreinterpretq_s16_s32(u02.val[0]), vreinterpretq_s16_s32(u46.val[0]));
+    r[5] = fons__blurHighHalves(vreinterpretq_s16_s32(u13.val[0]), vreinterpretq_s16_s32(u57.val[0]));
+    r[6] = fons__blurHighHalves(vreinterpretq_s16_s32(u02.val[1]), vreinterpretq_s16_s32(u46.val[1]));
+    r[7] = fons__blurHighHalves(vreinterpretq_s16_s32(u13.val[1]), vreinterpretq_s16_s32(u57.val[1]));
+}
+#else
+typedef __m128i FONSblurLanes;
+// SSE2 only has signed 16 bit multiplies, alpha is split in the signed low half and a mask
+// which adds the lanes once more when alpha is 32768 or larger. This relies on APREC being 16.
+typedef struct { __m128i lo, hi; } FONSblurAlpha;
+
+static FONSblurAlpha fons__blurAlpha(int alpha)
+{
+    FONSblurAlpha a;
+    a.lo = _mm_set1_epi16((short)(alpha & 0xffff));
+    a.hi = _mm_set1_epi16((short)(alpha >= 0x8000 ? -1 : 0));
+    return a;
+}
+
+static FONSblurLanes fons__blurLoad(const unsigned char* src)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)src), _mm_setzero_si128());
+}
+
+static void fons__blurStore(unsigned char* dst, FONSblurLanes z)
+{
+    _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(_mm_srli_epi16(z, ZPREC), _mm_setzero_si128()));
+}
+
+static FONSblurLanes fons__blurStep(FONSblurLanes z, FONSblurLanes px, FONSblurAlpha alpha)
+{
+    __m128i d = _mm_sub_epi16(_mm_slli_epi16(px, ZPREC), z);
+    return _mm_add_epi16(z, _mm_add_epi16(_mm_mulhi_epi16(d, alpha.lo), _mm_and_si128(d, alpha.hi)));
+}
+
+static FONSblurLanes fons__blurZero(void)
+{
+    return _mm_setzero_si128();
+}
+
+static FONSblurLanes fons__blurGetLanes(const short* src)
+{
+    return _mm_loadu_si128((const __m128i*)src);
+}
+
+static void fons__blurSetLanes(short* dst, FONSblurLanes z)
+{
+    _mm_storeu_si128((__m128i*)dst, z);
+}
+
+static void fons__blurTranspose(FONSblurLanes* r)
+{
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+#endif
+
+// Filters eight columns at a time down and up, the columns left over use the scalar pass.
+static void fons__blurRowsSimd(unsigned char* dst, int w, int h, int dstStride, int alpha)
+{
+    FONSblurAlpha a = fons__blurAlpha(alpha);
+    FONSblurLanes z;
+    int x, y;
+    for (x = 0; x+8 <= w; x += 8) {
+        unsigned char* col = &dst[x];
+        z = fons__blurZero(); // force zero border
+        for (y = dstStride; y < h*dstStride; y += dstStride) {
+            z = fons__blurStep(z, fons__blurLoad(&col[y]), a);
+            fons__blurStore(&col[y], z);
+        }
+        memset(&col[(h-1)*dstStride], 0, 8); // force zero border
+        z = fons__blurZero();
+        for (y = (h-2)*dstStride; y >= 0; y -= dstStride) {
+            z = fons__blurStep(z, fons__blurLoad(&col[y]), a);
+            fons__blurStore(&col[y], z);
+        }
+        memset(col, 0, 8); // force zero border
+    }
+    if (x < w)
+        fons__blurRows(&dst[x], w-x, h, dstStride, alpha);
+}
+
+// Filters eight rows at a time right and left. Blocks of 8x8 pixels are transposed, so that
+// each step filters one column of the block. The columns after the last whole block are
+// filtered one row at a time, continuing from the lanes.
+static void fons__blurColsSimd(unsigned char* dst, int w, int h, int dstStride, int alpha)
+{
+    FONSblurAlpha a = fons__blurAlpha(alpha);
+    FONSblurLanes z, r[8];
+    short zs[8];
+    int x, y, i, j, nblock = w & ~7;
+    if (w < 8) {
+        fons__blurCols(dst, w, h, dstStride, alpha);
+        return;
+    }
+    for (y = 0; y+8 <= h; y += 8) {
+        unsigned char* row = &dst[y*dstStride];
+        z = fons__blurZero(); // force zero border
+        for (x = 0; x < nblock; x += 8) {
+            for (i = 0; i < 8; i++)
+                r[i] = fons__blurLoad(&row[i*dstStride + x]);
+            fons__blurTranspose(r);
+            for (j = 0; j < 8; j++) {
+                if (x+j > 0)
+                    z = fons__blurStep(z, r[j], a);
+                r[j] = z;
+            }
+            fons__blurTranspose(r);
+            for (i = 0; i < 8; i++)
+                fons__blurStore(&row[i*dstStride + x], r[i]);
+        }
+        fons__blurSetLanes(zs, z);
+        for (i = 0; i < 8; i++) {
+            unsigned char* p = &row[i*dstStride];
+            int zi = zs[i];
+            for (x = nblock; x < w; x++) {
+                zi += (alpha * (((int)(p[x]) << ZPREC) - zi)) >> APREC;
+                p[x] = (unsigned char)(zi >> ZPREC);
+            }
+            p[w-1] = 0; // force zero border
+            zi = 0;
+            for (x = w-2; x >= nblock; x--) {
+                zi += (alpha * (((int)(p[x]) << ZPREC) - zi)) >> APREC;
+                p[x] = (unsigned char)(zi >> ZPREC);
+            }
+            zs[i] = (short)zi;
+        }
+        z = fons__blurGetLanes(zs);
+        for (x = nblock-8; x >= 0; x -= 8) {
+            for (i = 0; i < 8; i++)
+                r[i] = fons__blurLoad(&row[i*dstStride + x]);
+            fons__blurTranspose(r);
+            for (j = 7; j >= 0; j--) {
+                if (x+j < w-1)
+                    z = fons__blurStep(z, r[j], a);
+                r[j] = z;
+            }
+            fons__blurTranspose(r);
+            for (i = 0; i < 8; i++)
+                fons__blurStore(&row[i*dstStride + x], r[i]);
+        }
+        for (i = 0; i < 8; i++)
+            row[i*dstStride] = 0; // force zero border
+    }
+    if (y < h)
+        fons__blurCols(&dst[y*dstStride], w, h-y, dstStride, alpha);
+}
+
+#endif
+
 static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int dstStride, int blur)
 {
     int alpha;
@@ -1058,80 +1835,138 @@ static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int
     // Calculate the alpha such that 90% of the kernel is within the radius. (Kernel extends to infinity)
     sigma = (float)blur * 0.57735f; // 1 / sqrt(3)
     alpha = (int)((1<<APREC) * (1.0f - expf(-2.3f / (sigma+1.0f))));
+#if defined(FONS_SIMD_NEON) || defined(FONS_SIMD_SSE2)
+    fons__blurRowsSimd(dst, w, h, dstStride, alpha);
+    fons__blurColsSimd(dst, w, h, dstStride, alpha);
+    fons__blurRowsSimd(dst, w, h, dstStride, alpha);
+    fons__blurColsSimd(dst, w, h, dstStride, alpha);
+#else
     fons__blurRows(dst, w, h, dstStride, alpha);
     fons__blurCols(dst, w, h, dstStride, alpha);
     fons__blurRows(dst, w, h, dstStride, alpha);
     fons__blurCols(dst, w, h, dstStride, alpha);
+#endif
 //	fons__blurrows(dst, w, h, dstStride, alpha);
 //	fons__blurcols(dst, w, h, dstStride, alpha);
 }
 
+// Queues the rasterization of a glyph reserved in the atlas.
+static int fons__addGlyphJob(FONScontext* stash, FONSfont* font, FONSfont* renderFont, FONSglyph* glyph, float scale, int pad)
+{
+    FONSglyphJob* job;
+    if (stash->njobs+1 > stash->cjobs) {
+        int cjobs = stash->cjobs == 0 ? 64 : stash->cjobs * 2;
+        FONSglyphJob* jobs = (FONSglyphJob*)realloc(stash->jobs, sizeof(FONSglyphJob) * cjobs);
+        if (jobs == NULL) return 0;
+        stash->jobs = jobs;
+        stash->cjobs = cjobs;
+    }
+    job = &stash->jobs[stash->njobs++];
+    job->font = font;
+    job->renderFont = renderFont->font;
+    job->glyph = (int)(glyph - font->glyphs);
+    job->codepoint = glyph->codepoint;
+    job->size = glyph->size;
+    job->blur = glyph->blur;
+    job->x0 = glyph->x0;
+    job->y0 = glyph->y0;
+    job->index = glyph->index;
+    job->scale = scale;
+    job->gw = glyph->x1 - glyph->x0;
+    job->gh = glyph->y1 - glyph->y0;
+    job->pad = pad;
+    job->sdf = (stash->params.flags & FONS_SDF) != 0;
+    job->offset = 0;
+    return 1;
+}
+
+static void fons__clearBorder(unsigned char* dst, int w, int h, int stride)
+{
+    int x, y;
+    for (y = 0; y < h; y++) {
+        dst[y*stride] = 0;
+        dst[w-1 + y*stride] = 0;
+    }
+    for (x = 0; x < w; x++) {
+        dst[x] = 0;
+        dst[x + (h-1)*stride] = 0;
+    }
+}
+
 static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
                                  short isize, short iblur, int bitmapOption)
 {
-    int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, x, y;
+    int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy;
     float scale;
     FONSglyph* glyph = NULL;
-    unsigned int h;
-    float size = isize/10.0f;
+    int slot, page = 0;
+    float size;
     int pad, added;
     unsigned char* bdst;
     unsigned char* dst;
     FONSfont* renderFont = font;
 
     if (isize < 2) return NULL;
+    if (stash->params.flags & FONS_SDF) {
+        // One distance field serves every size and blur.
+        isize = FONS_SDF_SIZE*10;
+        iblur = 0;
+    }
     if (iblur > 20) iblur = 20;
-    pad = iblur+2;
+    size = isize/10.0f;
+    pad = (stash->params.flags & FONS_SDF) ? FONS_SDF_PAD : iblur+2;
+
+#ifdef FONS_USE_FREETYPE
+    // A FreeType face cannot be shared with another thread, rasterize right away.
+    if (bitmapOption == FONS_GLYPH_BITMAP_DEFERRED)
+        bitmapOption = FONS_GLYPH_BITMAP_REQUIRED;
+#endif
 
     // Reset allocator.
-    stash->nscratch = 0;
+    stash->scratch.n = 0;
 
     // Find code point and size.
-    h = fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1);
-    i = font->lut[h];
-    while (i != -1) {
-        if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur) {
-            glyph = &font->glyphs[i];
-            if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL || (glyph->x0 >= 0 && glyph->y0 >= 0)) {
-              return glyph;
-            }
-            // At this point, glyph exists but the bitmap data is not yet created.
-            break;
+    slot = fons__findGlyphSlot(font, codepoint, isize, iblur);
+    i = font->lut[slot];
+    if (i != -1) {
+        glyph = &font->glyphs[i];
+        if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL) {
+          return glyph;
+        }
+        if (glyph->x0 >= 0 && glyph->y0 >= 0) {
+          stash->pages[glyph->page].lastUsed = stash->frame;
+          // A glyph waiting for its batch is rasterized right away, unless deferred again.
+          if (!glyph->pending || bitmapOption == FONS_GLYPH_BITMAP_DEFERRED)
+            return glyph;
         }
-        i = font->glyphs[i].next;
+        // At this point, glyph exists but the bitmap data is not yet created.
     }
 
     // Create a new glyph or rasterize bitmap data for a cached glyph.
-    g = fons__tt_getGlyphIndex(&font->font, codepoint);
-    // Try to find the glyph in fallback fonts.
-    if (g == 0) {
-        for (i = 0; i < font->nfallbacks; ++i) {
-            FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
-            int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
-            if (fallbackIndex != 0) {
-                g = fallbackIndex;
-                renderFont = fallbackFont;
-                break;
-            }
-        }
-        // It is possible that we did not find a fallback glyph.
-        // In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
-    }
+    g = fons__getGlyphIndex(stash, font, codepoint, &renderFont);
+    // It is possible that we did not find a fallback glyph.
+    // In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
     scale = fons__tt_getPixelHeightScale(&renderFont->font, size);
     fons__tt_buildGlyphBitmap(&renderFont->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
     gw = x1-x0 + pad*2;
     gh = y1-y0 + pad*2;
 
     // Determines the spot to draw glyph in the atlas.
-    if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED) {
+    if (glyph != NULL && glyph->pending && glyph->x0 >= 0) {
+        // Keep the spot reserved for the deferred glyph.
+        gx = glyph->x0;
+        gy = glyph->y0;
+        page = glyph->page;
+    } else if (bitmapOption != FONS_GLYPH_BITMAP_OPTIONAL) {
         // Find free spot for the rect in the atlas
-        added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+        added = fons__addGlyphRect(stash, gw, gh, &gx, &gy, &page);
         if (added == 0 && stash->handleError != NULL) {
             // Atlas is full, let the user to resize the atlas (or not), and try again.
             stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
-            added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+            added = fons__addGlyphRect(stash, gw, gh, &gx, &gy, &page);
         }
         if (added == 0) return NULL;
+        stash->pages[page].lastUsed = stash->frame;
     } else {
         // Negative coordinate indicates there is no bitmap data created.
         gx = -1;
@@ -1140,43 +1975,53 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 
     // Init glyph.
     if (glyph == NULL) {
+        // Grow the hash lookup before it gets more than half full, the atlas full callback may also have reset it.
+        if ((font->nglyphs+1)*2 > font->clut && !fons__growGlyphLut(font) && font->nglyphs+1 >= font->clut)
+            return NULL;
+        slot = fons__findGlyphSlot(font, codepoint, isize, iblur);
+
         glyph = fons__allocGlyph(font);
         glyph->codepoint = codepoint;
         glyph->size = isize;
         glyph->blur = iblur;
-        glyph->next = 0;
 
         // Insert char to hash lookup.
-        glyph->next = font->lut[h];
-        font->lut[h] = font->nglyphs-1;
+        font->lut[slot] = font->nglyphs-1;
     }
     glyph->index = g;
+    glyph->page = (short)page;
     glyph->x0 = (short)gx;
     glyph->y0 = (short)gy;
     glyph->x1 = (short)(glyph->x0+gw);
     glyph->y1 = (short)(glyph->y0+gh);
-    glyph->xadv = (short)(scale * advance * 10.0f);
+    // Distance field advances are scaled up along with their error, round them instead of truncating.
+    glyph->xadv = (short)(scale * advance * 10.0f + ((stash->params.flags & FONS_SDF) ? 0.5f : 0.0f));
     glyph->xoff = (short)(x0 - pad);
     glyph->yoff = (short)(y0 - pad);
+    glyph->pending = 0;
 
     if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL) {
         return glyph;
     }
 
+    // Leave the bitmap to fonsRasterizeGlyphBatch(), or rasterize it right away if the job cannot be queued.
+    if (bitmapOption == FONS_GLYPH_BITMAP_DEFERRED && fons__addGlyphJob(stash, font, renderFont, glyph, scale, pad)) {
+        glyph->pending = 1;
+        return glyph;
+    }
+
     // Rasterize
-    dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
-    fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale, scale, g);
+    if (stash->params.flags & FONS_SDF) {
+        dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
+        fons__tt_renderGlyphSDF(&renderFont->font, dst, gw, gh, stash->params.width, scale, pad, g);
+    } else {
+        dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
+        fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale, scale, g);
+    }
 
     // Make sure there is one pixel empty border.
     dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-    for (y = 0; y < gh; y++) {
-        dst[y*stash->params.width] = 0;
-        dst[gw-1 + y*stash->params.width] = 0;
-    }
-    for (x = 0; x < gw; x++) {
-        dst[x] = 0;
-        dst[x + (gh-1)*stash->params.width] = 0;
-    }
+    fons__clearBorder(dst, gw, gh, stash->params.width);
 
     // Debug code to color the glyph background
 /*	unsigned char* fdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
@@ -1190,35 +2035,34 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 
     // Blur
     if (iblur > 0) {
-        stash->nscratch = 0;
+        stash->scratch.n = 0;
         bdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
         fons__blur(stash, bdst, gw, gh, stash->params.width, iblur);
     }
 
-    stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], glyph->x0);
-    stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], glyph->y0);
-    stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], glyph->x1);
-    stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], glyph->y1);
+    fons__markDirty(stash, glyph->x0, glyph->y0, glyph->x1, glyph->y1);
 
     return glyph;
 }
 
 static void fons__getQuad(FONScontext* stash, FONSfont* font,
-                           int prevGlyphIndex, FONSglyph* glyph,
+                           int prevGlyphIndex, unsigned int prevCodepoint, FONSglyph* glyph, short isize,
                            float scale, float spacing, float* x, float* y, FONSquad* q)
 {
     float rx,ry,xoff,yoff,x0,y0,x1,y1;
+    // Distance field glyphs are stored at FONS_SDF_SIZE, others at the requested size.
+    float gs = (float)isize / (float)glyph->size;
 
     if (prevGlyphIndex != -1) {
-        float adv = fons__tt_getGlyphKernAdvance(&font->font, prevGlyphIndex, glyph->index) * scale;
+        float adv = fons__getKern(font, prevCodepoint, prevGlyphIndex, glyph->codepoint, glyph->index) * scale;
         *x += (int)(adv + spacing + 0.5f);
     }
 
     // Each glyph has 2px border to allow good interpolation,
     // one pixel to prevent leaking, and one to allow good interpolation for rendering.
     // Inset the texture region by one pixel for correct interpolation.
-    xoff = (short)(glyph->xoff+1);
-    yoff = (short)(glyph->yoff+1);
+    xoff = (short)(glyph->xoff+1) * gs;
+    yoff = (short)(glyph->yoff+1) * gs;
     x0 = (float)(glyph->x0+1);
     y0 = (float)(glyph->y0+1);
     x1 = (float)(glyph->x1-1);
@@ -1230,8 +2074,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
         q->x0 = rx;
         q->y0 = ry;
-        q->x1 = rx + x1 - x0;
-        q->y1 = ry + y1 - y0;
+        q->x1 = rx + (x1 - x0) * gs;
+        q->y1 = ry + (y1 - y0) * gs;
 
         q->s0 = x0 * stash->itw;
         q->t0 = y0 * stash->ith;
@@ -1243,8 +2087,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
         q->x0 = rx;
         q->y0 = ry;
-        q->x1 = rx + x1 - x0;
-        q->y1 = ry - y1 + y0;
+        q->x1 = rx + (x1 - x0) * gs;
+        q->y1 = ry - (y1 - y0) * gs;
 
         q->s0 = x0 * stash->itw;
         q->t0 = y0 * stash->ith;
@@ -1252,7 +2096,7 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
         q->t1 = y1 * stash->ith;
     }
 
-    *x += (int)(glyph->xadv / 10.0f + 0.5f);
+    *x += (int)(glyph->xadv * gs / 10.0f + 0.5f);
 }
 
 static void fons__flush(FONScontext* stash)
@@ -1261,11 +2105,7 @@ static void fons__flush(FONScontext* stash)
     if (stash->dirtyRect[0] < stash->dirtyRect[2] && stash->dirtyRect[1] < stash->dirtyRect[3]) {
         if (stash->params.renderUpdate != NULL)
             stash->params.renderUpdate(stash->params.userPtr, stash->dirtyRect, stash->texData);
-        // Reset dirty rect
-        stash->dirtyRect[0] = stash->params.width;
-        stash->dirtyRect[1] = stash->params.height;
-        stash->dirtyRect[2] = 0;
-        stash->dirtyRect[3] = 0;
+        fons__resetDirty(stash);
     }
 
     // Flush triangles
@@ -1322,6 +2162,7 @@ float fonsDrawText(FONScontext* stash,
     FONSglyph* glyph = NULL;
     FONSquad q;
     int prevGlyphIndex = -1;
+    unsigned int prevCodepoint = 0;
     short isize = (short)(state->size*10.0f);
     short iblur = (short)state->blur;
     float scale;
@@ -1356,7 +2197,7 @@ float fonsDrawText(FONScontext* stash,
             continue;
         glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_REQUIRED);
         if (glyph != NULL) {
-            fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+            fons__getQuad(stash, font, prevGlyphIndex, prevCodepoint, glyph, isize, scale, state->spacing, &x, &y, &q);
 
             if (stash->nverts+6 > FONS_VERTEX_COUNT)
                 fons__flush(stash);
@@ -1370,6 +2211,7 @@ float fonsDrawText(FONScontext* stash,
             fons__vertex(stash, q.x1, q.y1, q.s1, q.t1, state->color);
         }
         prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+        prevCodepoint = codepoint;
     }
     fons__flush(stash);
 
@@ -1417,6 +2259,7 @@ int fonsTextIterInit(FONScontext* stash, FONStextIter* iter,
     iter->end = end;
     iter->codepoint = 0;
     iter->prevGlyphIndex = -1;
+    iter->prevCodepoint = 0;
     iter->bitmapOption = bitmapOption;
 
     return 1;
@@ -1441,8 +2284,11 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
         glyph = fons__getGlyph(stash, iter->font, iter->codepoint, iter->isize, iter->iblur, iter->bitmapOption);
         // If the iterator was initialized with FONS_GLYPH_BITMAP_OPTIONAL, then the UV coordinates of the quad will be invalid.
         if (glyph != NULL)
-            fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
+            fons__getQuad(stash, iter->font, iter->prevGlyphIndex, iter->prevCodepoint, glyph, iter->isize, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
         iter->prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+        iter->prevCodepoint = iter->codepoint;
+        iter->pending = glyph != NULL && glyph->pending;
+        iter->page = glyph != NULL ? glyph->page : 0;
         break;
     }
     iter->next = str;
@@ -1450,9 +2296,28 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
     return 1;
 }
 
+int fonsTextIterGlyph(FONScontext* stash, FONStextIter* iter, FONSquad* quad, int bitmapOption)
+{
+    FONSglyph* glyph;
+
+    if (iter->prevGlyphIndex == -1) return 0;
+    glyph = fons__getGlyph(stash, iter->font, iter->codepoint, iter->isize, iter->iblur, bitmapOption);
+    if (glyph == NULL) return 0;
+
+    // The glyph keeps its metrics, so only the texture coordinates of the quad change.
+    quad->s0 = (float)(glyph->x0+1) * stash->itw;
+    quad->t0 = (float)(glyph->y0+1) * stash->ith;
+    quad->s1 = (float)(glyph->x1-1) * stash->itw;
+    quad->t1 = (float)(glyph->y1-1) * stash->ith;
+    iter->pending = glyph->pending;
+    iter->page = glyph->page;
+
+    return 1;
+}
+
 void fonsDrawDebug(FONScontext* stash, float x, float y)
 {
-    int i;
+    int i, j;
     int w = stash->params.width;
     int h = stash->params.height;
     float u = w == 0 ? 0 : (1.0f / w);
@@ -1480,19 +2345,23 @@ void fonsDrawDebug(FONScontext* stash, float x, float y)
     fons__vertex(stash, x+w, y+h, 1, 1, 0xffffffff);
 
     // Drawbug draw atlas
-    for (i = 0; i < stash->atlas->nnodes; i++) {
-        FONSatlasNode* n = &stash->atlas->nodes[i];
+    for (j = 0; j < stash->npages; j++) {
+        FONSatlas* atlas = stash->pages[j].atlas;
+        float py = y + stash->pages[j].y;
+        for (i = 0; i < atlas->nnodes; i++) {
+            FONSatlasNode* n = &atlas->nodes[i];
 
-        if (stash->nverts+6 > FONS_VERTEX_COUNT)
-            fons__flush(stash);
+            if (stash->nverts+6 > FONS_VERTEX_COUNT)
+                fons__flush(stash);
 
-        fons__vertex(stash, x+n->x+0, y+n->y+0, u, v, 0xc00000ff);
-        fons__vertex(stash, x+n->x+n->width, y+n->y+1, u, v, 0xc00000ff);
-        fons__vertex(stash, x+n->x+n->width, y+n->y+0, u, v, 0xc00000ff);
+            fons__vertex(stash, x+n->x+0, py+n->y+0, u, v, 0xc00000ff);
+            fons__vertex(stash, x+n->x+n->width, py+n->y+1, u, v, 0xc00000ff);
+            fons__vertex(stash, x+n->x+n->width, py+n->y+0, u, v, 0xc00000ff);
 
-        fons__vertex(stash, x+n->x+0, y+n->y+0, u, v, 0xc00000ff);
-        fons__vertex(stash, x+n->x+0, y+n->y+1, u, v, 0xc00000ff);
-        fons__vertex(stash, x+n->x+n->width, y+n->y+1, u, v, 0xc00000ff);
+            fons__vertex(stash, x+n->x+0, py+n->y+0, u, v, 0xc00000ff);
+            fons__vertex(stash, x+n->x+0, py+n->y+1, u, v, 0xc00000ff);
+            fons__vertex(stash, x+n->x+n->width, py+n->y+1, u, v, 0xc00000ff);
+        }
     }
 
     fons__flush(stash);
@@ -1509,6 +2378,7 @@ float fonsTextBounds(FONScontext* stash,
     FONSquad q;
     FONSglyph* glyph = NULL;
     int prevGlyphIndex = -1;
+    unsigned int prevCodepoint = 0;
     short isize = (short)(state->size*10.0f);
     short iblur = (short)state->blur;
     float scale;
@@ -1538,7 +2408,7 @@ float fonsTextBounds(FONScontext* stash,
             continue;
         glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_OPTIONAL);
         if (glyph != NULL) {
-            fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+            fons__getQuad(stash, font, prevGlyphIndex, prevCodepoint, glyph, isize, scale, state->spacing, &x, &y, &q);
             if (q.x0 < minx) minx = q.x0;
             if (q.x1 > maxx) maxx = q.x1;
             if (stash->params.flags & FONS_ZERO_TOPLEFT) {
@@ -1550,6 +2420,7 @@ float fonsTextBounds(FONScontext* stash,
             }
         }
         prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+        prevCodepoint = codepoint;
     }
 
     advance = x - startx;
@@ -1635,16 +2506,109 @@ int fonsValidateTexture(FONScontext* stash, int* dirty)
         dirty[1] = stash->dirtyRect[1];
         dirty[2] = stash->dirtyRect[2];
         dirty[3] = stash->dirtyRect[3];
-        // Reset dirty rect
-        stash->dirtyRect[0] = stash->params.width;
-        stash->dirtyRect[1] = stash->params.height;
-        stash->dirtyRect[2] = 0;
-        stash->dirtyRect[3] = 0;
+        fons__resetDirty(stash);
         return 1;
     }
     return 0;
 }
 
+int fonsValidateTextureRects(FONScontext* stash, const int** rects)
+{
+    int n = stash->ndirtyRects;
+    *rects = stash->dirtyRects;
+    // The list is only overwritten when the next glyph marks a region dirty.
+    fons__resetDirty(stash);
+    return n;
+}
+
+FONSglyphBatch* fonsTakeGlyphBatch(FONScontext* stash)
+{
+    FONSglyphBatch* batch;
+    int i, size = 0;
+
+    if (stash->njobs == 0) return NULL;
+
+    batch = (FONSglyphBatch*)malloc(sizeof(FONSglyphBatch));
+    if (batch == NULL) return NULL;
+    memset(batch, 0, sizeof(FONSglyphBatch));
+
+    for (i = 0; i < stash->njobs; i++) {
+        stash->jobs[i].offset = size;
+        size += stash->jobs[i].gw * stash->jobs[i].gh;
+    }
+    batch->bitmaps = (unsigned char*)malloc(size > 0 ? size : 1);
+    batch->scratch.data = (unsigned char*)malloc(FONS_SCRATCH_BUF_SIZE);
+    if (batch->bitmaps == NULL || batch->scratch.data == NULL) {
+        fonsDeleteGlyphBatch(batch);
+        return NULL;
+    }
+
+    // The batch takes the jobs over.
+    batch->jobs = stash->jobs;
+    batch->njobs = stash->njobs;
+    stash->jobs = NULL;
+    stash->njobs = 0;
+    stash->cjobs = 0;
+    return batch;
+}
+
+void fonsRasterizeGlyphBatch(FONSglyphBatch* batch)
+{
+    int i;
+    for (i = 0; i < batch->njobs; i++) {
+        FONSglyphJob* job = &batch->jobs[i];
+        unsigned char* dst = &batch->bitmaps[job->offset];
+        int pad = job->pad;
+
+        // Leave an empty border around the glyph, like the glyphs rasterized right away.
+        memset(dst, 0, job->gw * job->gh);
+        batch->scratch.n = 0;
+        fons__tt_setScratch(&job->renderFont, &batch->scratch);
+        if (job->sdf) {
+            fons__tt_renderGlyphSDF(&job->renderFont, dst, job->gw, job->gh, job->gw, job->scale, pad, job->index);
+            fons__clearBorder(dst, job->gw, job->gh, job->gw);
+        } else {
+            fons__tt_renderGlyphBitmap(&job->renderFont, &dst[pad + pad * job->gw], job->gw-pad*2, job->gh-pad*2, job->gw, job->scale, job->scale, job->index);
+        }
+        if (job->blur > 0)
+            fons__blur(NULL, dst, job->gw, job->gh, job->gw, job->blur);
+    }
+}
+
+void fonsApplyGlyphBatch(FONScontext* stash, FONSglyphBatch* batch)
+{
+    int i, y;
+    for (i = 0; i < batch->njobs; i++) {
+        FONSglyphJob* job = &batch->jobs[i];
+        FONSfont* font = job->font;
+        FONSglyph* glyph;
+        unsigned char* dst;
+
+        // Skip glyphs which were evicted, reset or rasterized right away since.
+        if (job->glyph >= font->nglyphs) continue;
+        glyph = &font->glyphs[job->glyph];
+        if (!glyph->pending || glyph->codepoint != job->codepoint || glyph->size != job->size || glyph->blur != job->blur ||
+            glyph->x0 != job->x0 || glyph->y0 != job->y0)
+            continue;
+
+        dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
+        for (y = 0; y < job->gh; y++)
+            memcpy(&dst[y * stash->params.width], &batch->bitmaps[job->offset + y * job->gw], job->gw);
+        fons__markDirty(stash, glyph->x0, glyph->y0, glyph->x1, glyph->y1);
+        glyph->pending = 0;
+    }
+    fonsDeleteGlyphBatch(batch);
+}
+
+void fonsDeleteGlyphBatch(FONSglyphBatch* batch)
+{
+    if (batch == NULL) return;
+    if (batch->jobs) free(batch->jobs);
+    if (batch->bitmaps) free(batch->bitmaps);
+    if (batch->scratch.data) free(batch->scratch.data);
+    free(batch);
+}
+
 void fonsDeleteInternal(FONScontext* stash)
 {
     int i;
@@ -1656,10 +2620,12 @@ void fonsDeleteInternal(FONScontext* stash)
     for (i = 0; i < stash->nfonts; ++i)
         fons__freeFont(stash->fonts[i]);
 
-    if (stash->atlas) fons__deleteAtlas(stash->atlas);
+    fons__deletePages(stash);
+    if (stash->pages) free(stash->pages);
     if (stash->fonts) free(stash->fonts);
     if (stash->texData) free(stash->texData);
-    if (stash->scratch) free(stash->scratch);
+    if (stash->scratch.data) free(stash->scratch.data);
+    if (stash->jobs) free(stash->jobs);
     free(stash);
     fons__tt_done(stash);
 }
@@ -1680,7 +2646,7 @@ void fonsGetAtlasSize(FONScontext* stash, int* width, int* height)
 
 int fonsExpandAtlas(FONScontext* stash, int width, int height)
 {
-    int i, maxy = 0;
+    int i, j, maxy = 0;
     unsigned char* data = NULL;
     if (stash == NULL) return 0;
 
@@ -1715,21 +2681,30 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height)
     free(stash->texData);
     stash->texData = data;
 
-    // Increase atlas size
-    fons__atlasExpand(stash->atlas, width, height);
-
     // Add existing data as dirty.
-    for (i = 0; i < stash->atlas->nnodes; i++)
-        maxy = fons__maxi(maxy, stash->atlas->nodes[i].y);
-    stash->dirtyRect[0] = 0;
-    stash->dirtyRect[1] = 0;
-    stash->dirtyRect[2] = stash->params.width;
-    stash->dirtyRect[3] = maxy;
+    for (i = 0; i < stash->npages; i++) {
+        FONSatlas* atlas = stash->pages[i].atlas;
+        for (j = 0; j < atlas->nnodes; j++)
+            maxy = fons__maxi(maxy, stash->pages[i].y + atlas->nodes[j].y);
+    }
+
+    // Increase atlas size, new rows get pages of their own.
+    for (i = 0; i < stash->npages; i++)
+        fons__atlasExpand(stash->pages[i].atlas, width, stash->pages[i].atlas->height);
+    if (height > stash->params.height) {
+        int pageh = stash->npages > 0 ? stash->pages[0].atlas->height : height;
+        if (!fons__addPages(stash, stash->params.height, width, height - stash->params.height, fons__maxi(1, (height - stash->params.height) / pageh)))
+            return 0;
+    }
+    fons__resetDirty(stash);
+    if (maxy > 0)
+        fons__markDirty(stash, 0, 0, stash->params.width, maxy);
 
     stash->params.width = width;
     stash->params.height = height;
     stash->itw = 1.0f/stash->params.width;
     stash->ith = 1.0f/stash->params.height;
+    stash->generation++;
 
     return 1;
 }
@@ -1749,7 +2724,8 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
     }
 
     // Reset atlas
-    fons__atlasReset(stash->atlas, width, height);
+    fons__deletePages(stash);
+    if (!fons__addPages(stash, 0, width, height, FONS_ATLAS_PAGES)) return 0;
 
     // Clear texture data.
     stash->texData = (unsigned char*)realloc(stash->texData, width * height);
@@ -1757,16 +2733,14 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
     memset(stash->texData, 0, width * height);
 
     // Reset dirty rect
-    stash->dirtyRect[0] = width;
-    stash->dirtyRect[1] = height;
-    stash->dirtyRect[2] = 0;
-    stash->dirtyRect[3] = 0;
+    fons__resetDirty(stash);
 
-    // Reset cached glyphs
+    // Reset cached glyphs, with the glyphs waiting to be rasterized.
+    stash->njobs = 0;
     for (i = 0; i < stash->nfonts; i++) {
         FONSfont* font = stash->fonts[i];
         font->nglyphs = 0;
-        for (j = 0; j < FONS_HASH_LUT_SIZE; j++)
+        for (j = 0; j < font->clut; j++)
             font->lut[j] = -1;
     }
 
@@ -1774,6 +2748,7 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
     stash->params.height = height;
     stash->itw = 1.0f/stash->params.width;
     stash->ith = 1.0f/stash->params.height;
+    stash->generation++;
 
     // Add white rect at 0,0 for debug drawing.
     fons__addWhiteRect(stash, 2,2);
@@ -1781,5 +2756,29 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
     return 1;
 }
 
+void fonsBeginFrame(FONScontext* stash)
+{
+    if (stash == NULL) return;
+    stash->frame++;
+}
+
+int fonsAtlasGeneration(FONScontext* stash)
+{
+    if (stash == NULL) return 0;
+    return stash->generation;
+}
+
+int fonsPageGeneration(FONScontext* stash, int page)
+{
+    if (stash == NULL || page < 0 || page >= stash->npages) return 0;
+    return stash->pages[page].generation;
+}
+
+void fonsTouchPage(FONScontext* stash, int page)
+{
+    if (stash == NULL || page < 0 || page >= stash->npages) return;
+    stash->pages[page].lastUsed = stash->frame;
+}
+
 
 #endif
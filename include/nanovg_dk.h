@@ -41,6 +41,11 @@ static int dknvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w
     return dk->renderer->UpdateTexture(*dk, image, x, y, w, h, data);
 }
 
+static int dknvg__renderCopyTexture(void* uptr, int dst, int src, int w, int h) {
+    DKNVGcontext *dk = (DKNVGcontext*)uptr;
+    return dk->renderer->CopyTexture(*dk, dst, src, w, h);
+}
+
 static int dknvg__renderGetTextureSize(void* uptr, int image, int* w, int* h) {
     DKNVGcontext *dk = (DKNVGcontext*)uptr;
     return dk->renderer->GetTextureSize(*dk, image, w, h);
@@ -115,10 +120,15 @@ static int dknvg__convertPaint(DKNVGcontext* dk, DKNVGfragUniforms* frag, NVGpai
         }
         frag->type = NSVG_SHADER_FILLIMG;
 
-        if (tex->type == NVG_TEXTURE_RGBA)
+        if (tex->type == NVG_TEXTURE_RGBA) {
             frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
-        else
+        } else if (tex->flags & NVG_IMAGE_SDF) {
+            frag->texType = 3;
+            // Blur of distance field text, in pixels.
+            frag->feather = paint->feather;
+        } else {
             frag->texType = 2;
+        }
 //		printf("frag->texType = %d\n", frag->texType);
     } else {
         frag->type = NSVG_SHADER_FILLGRAD;
@@ -134,16 +144,49 @@ static int dknvg__convertPaint(DKNVGcontext* dk, DKNVGfragUniforms* frag, NVGpai
 
 static DKNVGfragUniforms* nvg__fragUniformPtr(DKNVGcontext* dk, int i);
 
+static void dknvg__recordPeaks(DKNVGcontext* dk)
+{
+    dk->peakCalls = dknvg__maxi(dk->peakCalls, dk->ncalls);
+    dk->peakPaths = dknvg__maxi(dk->peakPaths, dk->npaths);
+    dk->peakVerts = dknvg__maxi(dk->peakVerts, dk->nverts);
+    dk->peakUniforms = dknvg__maxi(dk->peakUniforms, dk->nuniforms);
+}
+
+// The frame arena has just been reset by nvgBeginFrame(), allocate the per frame buffers again,
+// sized after the peak use of the last frame.
+static void dknvg__resetFrameBuffers(DKNVGcontext* dk)
+{
+    dknvg__recordPeaks(dk);
+    dk->ccalls = dknvg__maxi(dk->peakCalls + dk->peakCalls/8, 128);
+    dk->cpaths = dknvg__maxi(dk->peakPaths + dk->peakPaths/8, 128);
+    dk->cverts = dknvg__maxi(dk->peakVerts + dk->peakVerts/8, 4096);
+    dk->cuniforms = dknvg__maxi(dk->peakUniforms + dk->peakUniforms/8, 128);
+
+    dk->calls = (DKNVGcall*)nvgArenaAlloc(dk->arena, sizeof(DKNVGcall) * dk->ccalls);
+    if (dk->calls == NULL) dk->ccalls = 0;
+    dk->paths = (DKNVGpath*)nvgArenaAlloc(dk->arena, sizeof(DKNVGpath) * dk->cpaths);
+    if (dk->paths == NULL) dk->cpaths = 0;
+    dk->verts = (NVGvertex*)nvgArenaAlloc(dk->arena, sizeof(NVGvertex) * dk->cverts);
+    if (dk->verts == NULL) dk->cverts = 0;
+    dk->uniforms = (unsigned char*)nvgArenaAlloc(dk->arena, dk->fragSize * dk->cuniforms);
+    if (dk->uniforms == NULL) dk->cuniforms = 0;
+
+    dk->ncalls = dk->npaths = dk->nverts = dk->nuniforms = 0;
+    dk->peakCalls = dk->peakPaths = dk->peakVerts = dk->peakUniforms = 0;
+}
+
 static void dknvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
 {
     NVG_NOTUSED(devicePixelRatio);
     DKNVGcontext* dk = (DKNVGcontext*)uptr;
     dk->view[0] = width;
     dk->view[1] = height;
+    dknvg__resetFrameBuffers(dk);
 }
 
 static void dknvg__renderCancel(void* uptr) {
     DKNVGcontext* dk = (DKNVGcontext*)uptr;
+    dknvg__recordPeaks(dk);
     dk->nverts = 0;
     dk->npaths = 0;
     dk->ncalls = 0;
@@ -197,7 +240,29 @@ static DKNVGblend dknvg__blendCompositeOperation(NVGcompositeOperationState op)
 
 static void dknvg__renderFlush(void* uptr) {
     DKNVGcontext *dk = (DKNVGcontext*)uptr;
-    dk->renderer->Flush(*dk);
+    dknvg__recordPeaks(dk);
+    if (dk->flags & NVG_PIPELINED)
+        dk->renderer->Submit(*dk);
+    else
+        dk->renderer->Flush(*dk);
+}
+
+static int dknvg__convexPaths(const NVGpath* paths, int npaths)
+{
+    int i;
+    for (i = 0; i < npaths; i++) {
+        if (!paths[i].convex) return 0;
+    }
+    return npaths > 0;
+}
+
+static int dknvg__noOverlapPaths(const NVGpath* paths, int npaths)
+{
+    int i;
+    for (i = 0; i < npaths; i++) {
+        if (!paths[i].nooverlap) return 0;
+    }
+    return 1;
 }
 
 static int dknvg__maxVertCount(const NVGpath* paths, int npaths) {
@@ -215,7 +280,7 @@ static DKNVGcall* dknvg__allocCall(DKNVGcontext* dk)
     if (dk->ncalls+1 > dk->ccalls) {
         DKNVGcall* calls;
         int ccalls = dknvg__maxi(dk->ncalls+1, 128) + dk->ccalls/2; // 1.5x Overallocate
-        calls = (DKNVGcall*)realloc(dk->calls, sizeof(DKNVGcall) * ccalls);
+        calls = (DKNVGcall*)nvgArenaRealloc(dk->arena, dk->calls, sizeof(DKNVGcall) * dk->ncalls, sizeof(DKNVGcall) * ccalls);
         if (calls == NULL) return NULL;
         dk->calls = calls;
         dk->ccalls = ccalls;
@@ -231,7 +296,7 @@ static int dknvg__allocPaths(DKNVGcontext* dk, int n)
     if (dk->npaths+n > dk->cpaths) {
         DKNVGpath* paths;
         int cpaths = dknvg__maxi(dk->npaths + n, 128) + dk->cpaths/2; // 1.5x Overallocate
-        paths = (DKNVGpath*)realloc(dk->paths, sizeof(DKNVGpath) * cpaths);
+        paths = (DKNVGpath*)nvgArenaRealloc(dk->arena, dk->paths, sizeof(DKNVGpath) * dk->npaths, sizeof(DKNVGpath) * cpaths);
         if (paths == NULL) return -1;
         dk->paths = paths;
         dk->cpaths = cpaths;
@@ -247,7 +312,7 @@ static int dknvg__allocVerts(DKNVGcontext* dk, int n)
     if (dk->nverts+n > dk->cverts) {
         NVGvertex* verts;
         int cverts = dknvg__maxi(dk->nverts + n, 4096) + dk->cverts/2; // 1.5x Overallocate
-        verts = (NVGvertex*)realloc(dk->verts, sizeof(NVGvertex) * cverts);
+        verts = (NVGvertex*)nvgArenaRealloc(dk->arena, dk->verts, sizeof(NVGvertex) * dk->nverts, sizeof(NVGvertex) * cverts);
         if (verts == NULL) return -1;
         dk->verts = verts;
         dk->cverts = cverts;
@@ -263,7 +328,7 @@ static int dknvg__allocFragUniforms(DKNVGcontext* dk, int n)
     if (dk->nuniforms+n > dk->cuniforms) {
         unsigned char* uniforms;
         int cuniforms = dknvg__maxi(dk->nuniforms+n, 128) + dk->cuniforms/2; // 1.5x Overallocate
-        uniforms = (unsigned char*)realloc(dk->uniforms, structSize * cuniforms);
+        uniforms = (unsigned char*)nvgArenaRealloc(dk->arena, dk->uniforms, structSize * dk->nuniforms, structSize * cuniforms);
         if (uniforms == NULL) return -1;
         dk->uniforms = uniforms;
         dk->cuniforms = cuniforms;
@@ -305,7 +370,7 @@ static void dknvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
     call->image = paint->image;
     call->blendFunc = dknvg__blendCompositeOperation(compositeOperation);
 
-    if (npaths == 1 && paths[0].convex)
+    if (dknvg__convexPaths(paths, npaths))
     {
         call->type = DKNVG_CONVEXFILL;
         call->triangleCount = 0;	// Bounding box fill quad not needed for convex fill
@@ -386,6 +451,10 @@ static void dknvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
     call->image = paint->image;
     call->blendFunc = dknvg__blendCompositeOperation(compositeOperation);
 
+    // Strokes which cannot overlap themselves are drawn in a single pass.
+    if ((dk->flags & NVG_STENCIL_STROKES) && !dknvg__noOverlapPaths(paths, npaths))
+        call->type = DKNVG_STENCILSTROKE;
+
     // Allocate vertices for all the paths.
     maxverts = dknvg__maxVertCount(paths, npaths);
     offset = dknvg__allocVerts(dk, maxverts);
@@ -403,7 +472,7 @@ static void dknvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
         }
     }
 
-    if (dk->flags & NVG_STENCIL_STROKES) {
+    if (call->type == DKNVG_STENCILSTROKE) {
         // Fill shader
         call->uniformOffset = dknvg__allocFragUniforms(dk, 2);
         if (call->uniformOffset == -1) goto error;
@@ -465,11 +534,10 @@ static void dknvg__renderDelete(void* uptr) {
     DKNVGcontext* dk = (DKNVGcontext*)uptr;
     if (dk == NULL) return;
 
-    free(dk->paths);
-    free(dk->verts);
-    free(dk->uniforms);
-    free(dk->calls);
-
+    // The per frame buffers belong to the frame arena, which is freed with the context.
+    // Make sure the render thread is done with them.
+    if (dk->flags & NVG_PIPELINED)
+        dk->renderer->WaitIdle();
     free(dk);
 }
 
@@ -486,6 +554,7 @@ NVGcontext* nvgCreateDk(nvg::DkRenderer *renderer, int flags) {
     params.renderDeleteTexture = dknvg__renderDeleteTexture;
     params.renderUpdateTexture = dknvg__renderUpdateTexture;
     params.renderGetTextureSize = dknvg__renderGetTextureSize;
+    params.renderCopyTexture = dknvg__renderCopyTexture;
     params.renderViewport = dknvg__renderViewport;
     params.renderCancel = dknvg__renderCancel;
     params.renderFlush = dknvg__renderFlush;
@@ -494,13 +563,20 @@ NVGcontext* nvgCreateDk(nvg::DkRenderer *renderer, int flags) {
     params.renderTriangles = dknvg__renderTriangles;
     params.renderDelete = dknvg__renderDelete;
     params.userPtr = dk;
+    // Multisampling replaces the fringe based anti-aliasing.
+    if (flags & NVG_MSAA) flags &= ~NVG_ANTIALIAS;
     params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
+    params.sdfText = flags & NVG_SDF_TEXT ? 1 : 0;
 
     dk->renderer = renderer;
     dk->flags = flags;
 
     ctx = nvgCreateInternal(&params);
     if (ctx == NULL) goto error;
+    dk->arena = nvgInternalArena(ctx);
+    // The render thread reads the buffers of a frame while the next one is recorded.
+    if (flags & NVG_PIPELINED)
+        nvgArenaFrames(dk->arena, 2);
 
     return ctx;
 
@@ -1276,6 +1276,15 @@ static void glnvg__renderFlush(void* uptr)
     gl->nuniforms = 0;
 }
 
+static int glnvg__convexPaths(const NVGpath* paths, int npaths)
+{
+    int i;
+    for (i = 0; i < npaths; i++) {
+        if (!paths[i].convex) return 0;
+    }
+    return npaths > 0;
+}
+
 static int glnvg__maxVertCount(const NVGpath* paths, int npaths)
 {
     int i, count = 0;
@@ -1382,7 +1391,7 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
     call->image = paint->image;
     call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
 
-    if (npaths == 1 && paths[0].convex)
+    if (glnvg__convexPaths(paths, npaths))
     {
         call->type = GLNVG_CONVEXFILL;
         call->triangleCount = 0;	// Bounding box fill quad not needed for convex fill
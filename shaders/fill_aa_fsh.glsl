@@ -75,6 +75,11 @@ void main(void) {
 
         if (texType == 1) color = vec4(color.xyz*color.w,color.w);
         if (texType == 2) color = vec4(color.x);
+        if (texType == 3) {
+            // Signed distance field text, the edge is at 0.5 and spans a pixel plus the blur in feather.
+            float w = fwidth(color.x) * (0.5 + feather);
+            color = vec4(smoothstep(0.5 - w, 0.5 + w, color.x));
+        }
         color *= scissor;
         result = color * innerCol;
     }
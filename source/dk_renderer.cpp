@@ -52,6 +52,23 @@ namespace nvg {
             tempimgmem.destroy();
         }
 
+        void CopyImage(dk::Image &dst, dk::Image &src, CMemPool &scratchPool, dk::Device device, dk::Queue transferQueue, int w, int h) {
+            dk::UniqueCmdBuf tempcmdbuf = dk::CmdBufMaker{device}.create();
+            CMemPool::Handle tempcmdmem = scratchPool.allocate(DK_MEMBLOCK_ALIGNMENT);
+            tempcmdbuf.addMemory(tempcmdmem.getMemBlock(), tempcmdmem.getOffset(), tempcmdmem.getSize());
+
+            dk::ImageView dstView{dst};
+            dk::ImageView srcView{src};
+            const DkImageRect rect = { 0, 0, 0, static_cast<uint32_t>(w), static_cast<uint32_t>(h), 1 };
+            tempcmdbuf.copyImage(srcView, rect, dstView, rect);
+
+            transferQueue.submitCommands(tempcmdbuf.finishList());
+            transferQueue.waitIdle();
+
+            /* Destroy temp mem. */
+            tempcmdmem.destroy();
+        }
+
     }
 
     Texture::Texture(int id) : m_id(id) { /* ... */ }
@@ -105,6 +122,76 @@ namespace nvg {
         return m_image_descriptor;
     }
 
+    RenderTarget::RenderTarget() : m_ms_mode(DkMsMode_1x), m_width(0), m_height(0) { /* ... */ }
+
+    RenderTarget::~RenderTarget() {
+        m_color_mem.destroy();
+        m_depth_stencil_mem.destroy();
+    }
+
+    void RenderTarget::Initialize(CMemPool &image_pool, dk::Device device, u32 width, u32 height, DkMsMode ms_mode) {
+        m_ms_mode = ms_mode;
+        m_width = width;
+        m_height = height;
+
+        /* Create the multisampled color image. */
+        dk::ImageLayout color_layout;
+        dk::ImageLayoutMaker{device}
+            .setFlags(DkImageFlags_UsageRender | DkImageFlags_HwCompression)
+            .setFormat(DkImageFormat_RGBA8_Unorm)
+            .setMsMode(ms_mode)
+            .setDimensions(width, height)
+            .initialize(color_layout);
+
+        m_color_mem = image_pool.allocate(color_layout.getSize(), color_layout.getAlignment());
+        m_color_image.initialize(color_layout, m_color_mem.getMemBlock(), m_color_mem.getOffset());
+
+        /* Create the matching depth stencil image. */
+        dk::ImageLayout depth_stencil_layout;
+        dk::ImageLayoutMaker{device}
+            .setFlags(DkImageFlags_UsageRender | DkImageFlags_HwCompression)
+            .setFormat(DkImageFormat_Z24S8)
+            .setMsMode(ms_mode)
+            .setDimensions(width, height)
+            .initialize(depth_stencil_layout);
+
+        m_depth_stencil_mem = image_pool.allocate(depth_stencil_layout.getSize(), depth_stencil_layout.getAlignment());
+        m_depth_stencil_image.initialize(depth_stencil_layout, m_depth_stencil_mem.getMemBlock(), m_depth_stencil_mem.getOffset());
+    }
+
+    bool RenderTarget::IsInitialized() {
+        return m_color_mem;
+    }
+
+    void RenderTarget::Bind(dk::CmdBuf cmd_buf) {
+        dk::ImageView color_view{m_color_image};
+        dk::ImageView depth_stencil_view{m_depth_stencil_image};
+        cmd_buf.bindRenderTargets(&color_view, &depth_stencil_view);
+
+        /* Configure the rasterizer for the sample count of the target. */
+        cmd_buf.bindMultisampleState(dk::MultisampleState{}.setMode(m_ms_mode).setLocations());
+        cmd_buf.setViewports(0, { { 0.0f, 0.0f, static_cast<float>(m_width), static_cast<float>(m_height), 0.0f, 1.0f } });
+        cmd_buf.setScissors(0, { { 0, 0, m_width, m_height } });
+    }
+
+    void RenderTarget::Clear(dk::CmdBuf cmd_buf, const NVGcolor &color) {
+        cmd_buf.clearColor(0, DkColorMask_RGBA, color.r, color.g, color.b, color.a);
+        cmd_buf.clearDepthStencil(true, 1.0f, 0xFF, 0);
+    }
+
+    void RenderTarget::Resolve(dk::CmdBuf cmd_buf, dk::Image &dst) {
+        dk::ImageView color_view{m_color_image};
+        dk::ImageView dst_view{dst};
+
+        /* Contents of the depth stencil buffer are not needed past this point. */
+        cmd_buf.discardDepthStencil();
+        cmd_buf.resolveImage(color_view, dst_view);
+
+        /* Leave the single sampled resolve target bound for the application. */
+        cmd_buf.bindMultisampleState(dk::MultisampleState{});
+        cmd_buf.bindRenderTargets(&dst_view);
+    }
+
     DkRenderer::DkRenderer(unsigned int view_width, unsigned int view_height, dk::Device device, dk::Queue queue, CMemPool &image_mem_pool, CMemPool &code_mem_pool, CMemPool &data_mem_pool) :
         m_view_width(view_width), m_view_height(view_height), m_device(device), m_queue(queue), m_image_mem_pool(image_mem_pool), m_code_mem_pool(code_mem_pool), m_data_mem_pool(data_mem_pool), m_image_descriptor_mappings({0})
     {
@@ -151,10 +238,28 @@ namespace nvg {
     }
 
     DkRenderer::~DkRenderer() {
+        /* Stop the render thread once it has flushed the pending frame. */
+        if (m_render_thread.joinable()) {
+            {
+                std::scoped_lock lk(m_frame_mutex);
+                m_quit = true;
+            }
+            m_frame_cond.notify_all();
+            m_render_thread.join();
+        }
+
+        this->StopRecordingThreads();
+
         if (m_vertex_buffer) {
             m_vertex_buffer->destroy();
         }
 
+        for (auto &batch : m_upload_batches) {
+            if (batch.buffer) {
+                batch.buffer->destroy();
+            }
+        }
+
         m_view_uniform_buffer.destroy();
         m_frag_uniform_buffer.destroy();
         m_textures.clear();
@@ -221,20 +326,43 @@ namespace nvg {
         }
     }
 
-    void DkRenderer::SetUniforms(const DKNVGcontext &ctx, int offset, int image) {
-        m_dyn_cmd_buf.pushConstants(m_frag_uniform_buffer.getGpuAddr(), m_frag_uniform_buffer.getSize(), 0, ctx.fragSize, ctx.uniforms + offset);
-        m_dyn_cmd_buf.bindUniformBuffer(DkStage_Fragment, 0, m_frag_uniform_buffer.getGpuAddr(), m_frag_uniform_buffer.getSize());
+    void DkRenderer::RecordUploads(dk::CmdBuf cmd_buf, UploadBatch &batch) {
+        if (batch.uploads.empty()) {
+            return;
+        }
 
+        for (const auto &upload : batch.uploads) {
+            dk::ImageView image_view{upload.texture->GetImage()};
+            cmd_buf.copyBufferToImage({ batch.buffer->getGpuAddr() + upload.offset }, image_view, upload.rect);
+        }
+
+        /* Finish the copies before the textures are sampled, and let the staging buffer be reused afterwards. */
+        cmd_buf.barrier(DkBarrier_Full, DkInvalidateFlags_Image);
+        cmd_buf.signalFence(batch.fence);
+        batch.uploads.clear();
+    }
+
+    void DkRenderer::SubmitUploads(UploadBatch &batch) {
+        if (batch.uploads.empty()) {
+            return;
+        }
+
+        m_dyn_cmd_mem.begin(m_dyn_cmd_buf);
+        this->RecordUploads(m_dyn_cmd_buf, batch);
+        m_queue.submitCommands(m_dyn_cmd_mem.end(m_dyn_cmd_buf));
+    }
+
+    std::optional<DkResHandle> DkRenderer::AcquireTextureHandle(int image) {
         /* Attempt to find a texture. */
         const auto texture = this->FindTexture(image);
         if (texture == nullptr) {
-            return;
+            return std::nullopt;
         }
 
         /* Acquire an image descriptor. */
         const int image_desc_id = this->AcquireImageDescriptor(texture, image);
         if (image_desc_id == -1) {
-            return;
+            return std::nullopt;
         }
 
         const int image_flags = texture->GetDescriptor().flags;
@@ -245,15 +373,24 @@ namespace nvg {
         if (image_flags & NVG_IMAGE_REPEATX)          sampler_id |= SamplerType_RepeatX;
         if (image_flags & NVG_IMAGE_REPEATY)          sampler_id |= SamplerType_RepeatY;
 
-        m_dyn_cmd_buf.bindTextures(DkStage_Fragment, 0, dkMakeTextureHandle(image_desc_id, sampler_id));
+        return dkMakeTextureHandle(image_desc_id, sampler_id);
     }
 
-    void DkRenderer::DrawFill(const DKNVGcontext &ctx, const DKNVGcall &call) {
+    void DkRenderer::SetUniforms(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, int offset, std::optional<DkResHandle> texture) {
+        cmd_buf.pushConstants(m_frag_uniform_buffer.getGpuAddr(), m_frag_uniform_buffer.getSize(), 0, ctx.fragSize, ctx.uniforms + offset);
+        cmd_buf.bindUniformBuffer(DkStage_Fragment, 0, m_frag_uniform_buffer.getGpuAddr(), m_frag_uniform_buffer.getSize());
+
+        if (texture) {
+            cmd_buf.bindTextures(DkStage_Fragment, 0, *texture);
+        }
+    }
+
+    void DkRenderer::DrawFill(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture) {
         DKNVGpath *paths = &ctx.paths[call.pathOffset];
         int npaths = call.pathCount;
 
         /* Set the stencils to be used. */
-        m_dyn_cmd_buf.setStencil(DkFace_FrontAndBack, 0xFF, 0x0, 0xFF);
+        cmd_buf.setStencil(DkFace_FrontAndBack, 0xFF, 0x0, 0xFF);
 
         /* Set the depth stencil state. */
         auto depth_stencil_state = dk::DepthStencilState{}
@@ -266,21 +403,21 @@ namespace nvg {
             .setStencilBackFailOp(DkStencilOp_Keep)
             .setStencilBackDepthFailOp(DkStencilOp_Keep)
             .setStencilBackPassOp(DkStencilOp_DecrWrap);
-        m_dyn_cmd_buf.bindDepthStencilState(depth_stencil_state);
+        cmd_buf.bindDepthStencilState(depth_stencil_state);
 
         /* Configure for shape drawing. */
-        m_dyn_cmd_buf.bindColorWriteState(dk::ColorWriteState{}.setMask(0, 0));
-        this->SetUniforms(ctx, call.uniformOffset, 0);
-        m_dyn_cmd_buf.bindRasterizerState(dk::RasterizerState{}.setCullMode(DkFace_None));
+        cmd_buf.bindColorWriteState(dk::ColorWriteState{}.setMask(0, 0));
+        this->SetUniforms(cmd_buf, ctx, call.uniformOffset, std::nullopt);
+        cmd_buf.bindRasterizerState(dk::RasterizerState{}.setCullMode(DkFace_None));
 
         /* Draw vertices. */
         for (int i = 0; i < npaths; i++) {
-            m_dyn_cmd_buf.draw(DkPrimitive_TriangleFan, paths[i].fillCount, 1, paths[i].fillOffset, 0);
+            cmd_buf.draw(DkPrimitive_TriangleFan, paths[i].fillCount, 1, paths[i].fillOffset, 0);
         }
 
-        m_dyn_cmd_buf.bindColorWriteState(dk::ColorWriteState{});
-        this->SetUniforms(ctx, call.uniformOffset + ctx.fragSize, call.image);
-        m_dyn_cmd_buf.bindRasterizerState(dk::RasterizerState{});
+        cmd_buf.bindColorWriteState(dk::ColorWriteState{});
+        this->SetUniforms(cmd_buf, ctx, call.uniformOffset + ctx.fragSize, texture);
+        cmd_buf.bindRasterizerState(dk::RasterizerState{});
 
         if (ctx.flags & NVG_ANTIALIAS) {
             /* Configure stencil anti-aliasing. */
@@ -293,11 +430,11 @@ namespace nvg {
                 .setStencilBackFailOp(DkStencilOp_Keep)
                 .setStencilBackDepthFailOp(DkStencilOp_Keep)
                 .setStencilBackPassOp(DkStencilOp_Keep);
-            m_dyn_cmd_buf.bindDepthStencilState(depth_stencil_state);
+            cmd_buf.bindDepthStencilState(depth_stencil_state);
 
             /* Draw fringes. */
             for (int i = 0; i < npaths; i++) {
-                m_dyn_cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
+                cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
             }
         }
 
@@ -311,37 +448,37 @@ namespace nvg {
             .setStencilBackFailOp(DkStencilOp_Zero)
             .setStencilBackDepthFailOp(DkStencilOp_Zero)
             .setStencilBackPassOp(DkStencilOp_Zero);
-        m_dyn_cmd_buf.bindDepthStencilState(depth_stencil_state);
+        cmd_buf.bindDepthStencilState(depth_stencil_state);
 
-        m_dyn_cmd_buf.draw(DkPrimitive_TriangleStrip, call.triangleCount, 1, call.triangleOffset, 0);
+        cmd_buf.draw(DkPrimitive_TriangleStrip, call.triangleCount, 1, call.triangleOffset, 0);
 
         /* Reset the depth stencil state to default. */
-        m_dyn_cmd_buf.bindDepthStencilState(dk::DepthStencilState{});
+        cmd_buf.bindDepthStencilState(dk::DepthStencilState{});
     }
 
-    void DkRenderer::DrawConvexFill(const DKNVGcontext &ctx, const DKNVGcall &call) {
+    void DkRenderer::DrawConvexFill(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture) {
         DKNVGpath *paths = &ctx.paths[call.pathOffset];
         int npaths = call.pathCount;
 
-        this->SetUniforms(ctx, call.uniformOffset, call.image);
+        this->SetUniforms(cmd_buf, ctx, call.uniformOffset, texture);
 
         for (int i = 0; i < npaths; i++) {
-            m_dyn_cmd_buf.draw(DkPrimitive_TriangleFan, paths[i].fillCount, 1, paths[i].fillOffset, 0);
+            cmd_buf.draw(DkPrimitive_TriangleFan, paths[i].fillCount, 1, paths[i].fillOffset, 0);
 
             /* Draw fringes. */
             if (paths[i].strokeCount > 0) {
-                m_dyn_cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
+                cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
             }
         }
     }
 
-    void DkRenderer::DrawStroke(const DKNVGcontext &ctx, const DKNVGcall &call) {
+    void DkRenderer::DrawStroke(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture) {
         DKNVGpath* paths = &ctx.paths[call.pathOffset];
         int npaths = call.pathCount;
 
-        if (ctx.flags & NVG_STENCIL_STROKES) {
+        if (call.type == DKNVG_STENCILSTROKE) {
             /* Set the stencil to be used. */
-            m_dyn_cmd_buf.setStencil(DkFace_Front, 0xFF, 0x0, 0xFF);
+            cmd_buf.setStencil(DkFace_Front, 0xFF, 0x0, 0xFF);
 
             /* Configure for filling the stroke base without overlap. */
             auto depth_stencil_state = dk::DepthStencilState{}
@@ -350,22 +487,22 @@ namespace nvg {
                 .setStencilFrontFailOp(DkStencilOp_Keep)
                 .setStencilFrontDepthFailOp(DkStencilOp_Keep)
                 .setStencilFrontPassOp(DkStencilOp_Incr);
-            m_dyn_cmd_buf.bindDepthStencilState(depth_stencil_state);
-            this->SetUniforms(ctx, call.uniformOffset + ctx.fragSize, call.image);
+            cmd_buf.bindDepthStencilState(depth_stencil_state);
+            this->SetUniforms(cmd_buf, ctx, call.uniformOffset + ctx.fragSize, texture);
 
             /* Draw vertices. */
             for (int i = 0; i < npaths; i++) {
-                m_dyn_cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
+                cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
             }
 
             /* Configure for drawing anti-aliased pixels. */
             depth_stencil_state.setStencilFrontPassOp(DkStencilOp_Keep);
-            m_dyn_cmd_buf.bindDepthStencilState(depth_stencil_state);
-            this->SetUniforms(ctx, call.uniformOffset, call.image);
+            cmd_buf.bindDepthStencilState(depth_stencil_state);
+            this->SetUniforms(cmd_buf, ctx, call.uniformOffset, texture);
 
             /* Draw vertices. */
             for (int i = 0; i < npaths; i++) {
-                m_dyn_cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
+                cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
             }
 
             /* Configure for clearing the stencil buffer. */
@@ -375,31 +512,36 @@ namespace nvg {
                 .setStencilFrontFailOp(DkStencilOp_Zero)
                 .setStencilFrontDepthFailOp(DkStencilOp_Zero)
                 .setStencilFrontPassOp(DkStencilOp_Zero);
-            m_dyn_cmd_buf.bindDepthStencilState(depth_stencil_state);
+            cmd_buf.bindDepthStencilState(depth_stencil_state);
 
             /* Draw vertices. */
             for (int i = 0; i < npaths; i++) {
-                m_dyn_cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
+                cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
             }
 
             /* Reset the depth stencil state to default. */
-            m_dyn_cmd_buf.bindDepthStencilState(dk::DepthStencilState{});
+            cmd_buf.bindDepthStencilState(dk::DepthStencilState{});
         } else {
-            this->SetUniforms(ctx, call.uniformOffset, call.image);
+            this->SetUniforms(cmd_buf, ctx, call.uniformOffset, texture);
 
             /* Draw vertices. */
             for (int i = 0; i < npaths; i++) {
-                m_dyn_cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
+                cmd_buf.draw(DkPrimitive_TriangleStrip, paths[i].strokeCount, 1, paths[i].strokeOffset, 0);
             }
         }
     }
 
-    void DkRenderer::DrawTriangles(const DKNVGcontext &ctx, const DKNVGcall &call) {
-        this->SetUniforms(ctx, call.uniformOffset, call.image);
-        m_dyn_cmd_buf.draw(DkPrimitive_Triangles, call.triangleCount, 1, call.triangleOffset, 0);
+    void DkRenderer::DrawTriangles(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, const DKNVGcall &call, std::optional<DkResHandle> texture) {
+        this->SetUniforms(cmd_buf, ctx, call.uniformOffset, texture);
+        cmd_buf.draw(DkPrimitive_Triangles, call.triangleCount, 1, call.triangleOffset, 0);
     }
 
     int DkRenderer::Create(DKNVGcontext &ctx) {
+        /* Multisampling replaces the fringe, without a resolve target nothing would be anti-aliased. */
+        if ((ctx.flags & NVG_MSAA) && m_resolve_target == nullptr) {
+            return 0;
+        }
+
         m_vertex_shader.load(m_code_mem_pool, "romfs:/shaders/fill_vsh.dksh");
 
         /* Load the appropriate fragment shader depending on whether AA is enabled. */
@@ -409,8 +551,18 @@ namespace nvg {
             m_fragment_shader.load(m_code_mem_pool, "romfs:/shaders/fill_fsh.dksh");
         }
 
+        /* Create the multisampled render target. */
+        if (ctx.flags & NVG_MSAA) {
+            m_render_target.Initialize(m_image_mem_pool, m_device, m_view_width, m_view_height, MultisampleMode);
+        }
+
         /* Set the size of fragment uniforms. */
         ctx.fragSize = FragmentUniformSize;
+
+        /* Start the render thread. */
+        if ((ctx.flags & NVG_PIPELINED) && !m_render_thread.joinable()) {
+            m_render_thread = std::thread(&DkRenderer::RenderThreadMain, this);
+        }
         return 1;
     }
 
@@ -425,6 +577,7 @@ namespace nvg {
     }
 
     int DkRenderer::CreateTexture(const DKNVGcontext &ctx, int type, int w, int h, int image_flags, const unsigned char* data) {
+        std::scoped_lock lk(m_queue_mutex);
         const auto texture_id = m_next_texture_id++;
         auto texture = std::make_shared<Texture>(texture_id);
         texture->Initialize(m_image_mem_pool, m_data_mem_pool, m_device, m_queue, type, w, h, image_flags, data);
@@ -435,6 +588,17 @@ namespace nvg {
     int DkRenderer::DeleteTexture(const DKNVGcontext &ctx, int image) {
         bool found = false;
 
+        /* The frame being flushed may still draw with the texture. */
+        this->WaitIdle();
+        std::scoped_lock lk(m_queue_mutex);
+
+        /* Drop updates which have not been copied yet. */
+        for (auto &batch : m_upload_batches) {
+            batch.uploads.erase(std::remove_if(batch.uploads.begin(), batch.uploads.end(), [image](const PendingUpload &upload) {
+                return upload.texture->GetId() == image;
+            }), batch.uploads.end());
+        }
+
         for (auto it = m_textures.begin(); it != m_textures.end();) {
             /* Remove textures with the given id. */
             if ((*it)->GetId() == image) {
@@ -459,15 +623,62 @@ namespace nvg {
         }
 
         const DKNVGtextureDescriptor &tex_desc = texture->GetDescriptor();
-        if (tex_desc.type == NVG_TEXTURE_RGBA) {
-            data += y * tex_desc.width*4;
-        } else {
-            data += y * tex_desc.width;
+        const size_t pixel_size = tex_desc.type == NVG_TEXTURE_RGBA ? 4 : 1;
+        const size_t row_size = w * pixel_size;
+        const size_t size = (row_size * h + DK_IMAGE_LINEAR_STRIDE_ALIGNMENT - 1) & ~(DK_IMAGE_LINEAR_STRIDE_ALIGNMENT - 1);
+
+        /* Updates go to the batch of the frame being built, which the render thread does not touch until Submit() hands */
+        /* it over. Start a new batch once the GPU is done copying the last one staged in it. */
+        UploadBatch &batch = m_upload_batches[m_upload_batch];
+        if (batch.uploads.empty()) {
+            batch.fence.wait();
+            batch.offset = 0;
+        }
+
+        /* Grow the staging buffer if the update does not fit, keeping the updates staged so far. Only the memory pool */
+        /* is shared with the render thread. */
+        if (!batch.buffer || batch.offset + size > batch.buffer->getSize()) {
+            std::scoped_lock lk(m_queue_mutex);
+            const size_t buffer_size = std::max(batch.offset + size, batch.buffer ? static_cast<size_t>(batch.buffer->getSize()) * 2 : UploadBufferSize);
+            CMemPool::Handle buffer = m_data_mem_pool.allocate(buffer_size, DK_IMAGE_LINEAR_STRIDE_ALIGNMENT);
+            if (!buffer) {
+                return 0;
+            }
+            if (batch.buffer) {
+                memcpy(buffer.getCpuAddr(), batch.buffer->getCpuAddr(), batch.offset);
+                batch.buffer->destroy();
+            }
+            batch.buffer = buffer;
+        }
+
+        /* Pack the rows of the region, the data holds the whole texture. */
+        u8 *dst = static_cast<u8 *>(batch.buffer->getCpuAddr()) + batch.offset;
+        const u8 *src = data + (static_cast<size_t>(y) * tex_desc.width + x) * pixel_size;
+        for (int row = 0; row < h; row++) {
+            memcpy(dst + row * row_size, src + row * tex_desc.width * pixel_size, row_size);
         }
-        x = 0;
-        w = tex_desc.width;
 
-        UpdateImage(texture->GetImage(), m_data_mem_pool, m_device, m_queue, tex_desc.type, x, y, w, h, data);
+        batch.uploads.push_back({ texture, { static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0, static_cast<uint32_t>(w), static_cast<uint32_t>(h), 1 }, batch.offset });
+        batch.offset += size;
+        return 1;
+    }
+
+    int DkRenderer::CopyTexture(const DKNVGcontext &ctx, int dst, int src, int w, int h) {
+        const std::shared_ptr<Texture> dst_texture = this->FindTexture(dst);
+        const std::shared_ptr<Texture> src_texture = this->FindTexture(src);
+
+        /* Could not find the textures. */
+        if (dst_texture == nullptr || src_texture == nullptr) {
+            return 0;
+        }
+
+        /* The source may have updates which have not been copied yet. Copying them now must not change textures the frame */
+        /* in flight still draws with, this only happens when the font atlas grows. */
+        this->WaitIdle();
+        std::scoped_lock lk(m_queue_mutex);
+        this->SubmitUploads(m_upload_batches[m_upload_batch]);
+
+        CopyImage(dst_texture->GetImage(), src_texture->GetImage(), m_data_mem_pool, m_device, m_queue, w, h);
         return 1;
     }
 
@@ -493,13 +704,30 @@ namespace nvg {
     }
 
     void DkRenderer::Flush(DKNVGcontext &ctx) {
+        this->FlushFrame(ctx, m_upload_batches[m_upload_batch]);
+    }
+
+    void DkRenderer::FlushFrame(DKNVGcontext &ctx, UploadBatch &uploads) {
+        std::scoped_lock lk(m_queue_mutex);
+        u32 single_pass_stroke_count = 0;
+
         if (ctx.ncalls > 0) {
             /* Prepare dynamic command buffer. */
             m_dyn_cmd_mem.begin(m_dyn_cmd_buf);
 
+            /* Copy the texture updates of the frame, before anything samples them. */
+            this->RecordUploads(m_dyn_cmd_buf, uploads);
+
             /* Update buffers with data. */
             this->UpdateVertexBuffer(ctx.verts, ctx.nverts * sizeof(NVGvertex));
 
+            /* Draw into our own multisampled target, which is only shown once resolved. */
+            const bool multisample = m_render_target.IsInitialized();
+            if (multisample) {
+                m_render_target.Bind(m_dyn_cmd_buf);
+                m_render_target.Clear(m_dyn_cmd_buf, m_clear_color);
+            }
+
             /* Enable blending. */
             m_dyn_cmd_buf.bindColorState(dk::ColorState{}.setBlendEnable(0, true));
 
@@ -514,32 +742,236 @@ namespace nvg {
             m_dyn_cmd_buf.pushConstants(m_view_uniform_buffer.getGpuAddr(), m_view_uniform_buffer.getSize(), 0, sizeof(view), &view);
             m_dyn_cmd_buf.bindUniformBuffer(DkStage_Vertex, 0, m_view_uniform_buffer.getGpuAddr(), m_view_uniform_buffer.getSize());
 
-            /* Iterate over calls. */
+            /* Resolve the textures of all calls up front, as this updates the shared image descriptors. */
+            m_call_textures.resize(ctx.ncalls);
             for (int i = 0; i < ctx.ncalls; i++) {
                 const DKNVGcall &call = ctx.calls[i];
 
-                /* Perform blending. */
-                m_dyn_cmd_buf.bindBlendStates(0, { dk::BlendState{}.setFactors(static_cast<DkBlendFactor>(call.blendFunc.srcRGB), static_cast<DkBlendFactor>(call.blendFunc.dstRGB), static_cast<DkBlendFactor>(call.blendFunc.srcAlpha), static_cast<DkBlendFactor>(call.blendFunc.dstRGB)) });
-
-                if (call.type == DKNVG_FILL) {
-                    this->DrawFill(ctx, call);
-                } else if (call.type == DKNVG_CONVEXFILL) {
-                    this->DrawConvexFill(ctx, call);
-                } else if (call.type == DKNVG_STROKE) {
-                    this->DrawStroke(ctx, call);
-                } else if (call.type == DKNVG_TRIANGLES) {
-                    this->DrawTriangles(ctx, call);
+                if (call.type == DKNVG_STROKE && (ctx.flags & NVG_STENCIL_STROKES)) {
+                    single_pass_stroke_count += call.pathCount;
                 }
+
+                m_call_textures[i] = this->AcquireTextureHandle(call.image);
+            }
+
+            /* Split large frames into contiguous ranges of calls, one per recording thread. */
+            const int range_count = std::clamp(ctx.ncalls / MinCallsPerRecordingThread, 1, static_cast<int>(m_recording_workers.size()) + 1);
+
+            if (range_count > 1) {
+                const int range_size = (ctx.ncalls + range_count - 1) / range_count;
+                {
+                    std::scoped_lock recording_lk(m_recording_mutex);
+                    for (size_t i = 0; i < m_recording_workers.size(); i++) {
+                        auto &worker = m_recording_workers[i];
+                        worker->call_begin = std::min(static_cast<int>(i + 1) * range_size, ctx.ncalls);
+                        worker->call_end = std::min(static_cast<int>(i + 2) * range_size, ctx.ncalls);
+                    }
+                    m_recording_ctx = &ctx;
+                    m_recording_pending = m_recording_workers.size();
+                    m_recording_generation++;
+                }
+                m_recording_cond.notify_all();
+
+                /* Record the first range after the setup. */
+                this->RecordCalls(m_dyn_cmd_buf, ctx, 0, range_size);
+                m_queue.submitCommands(m_dyn_cmd_buf.finishList());
+
+                /* Submit the other ranges in order. */
+                std::unique_lock recording_lk(m_recording_mutex);
+                m_recording_done_cond.wait(recording_lk, [this] { return m_recording_pending == 0; });
+                for (auto &worker : m_recording_workers) {
+                    if (worker->call_begin < worker->call_end) {
+                        m_queue.submitCommands(worker->cmd_list);
+                    }
+                }
+            } else {
+                this->RecordCalls(m_dyn_cmd_buf, ctx, 0, ctx.ncalls);
+            }
+
+            /* Resolve the multisampled target. */
+            if (multisample && m_resolve_target != nullptr) {
+                m_render_target.Resolve(m_dyn_cmd_buf, *m_resolve_target);
             }
 
             m_queue.submitCommands(m_dyn_cmd_mem.end(m_dyn_cmd_buf));
+        } else {
+            /* The updates still belong to this frame, later ones must not be copied first. */
+            this->SubmitUploads(uploads);
         }
 
+        m_single_pass_stroke_count.store(single_pass_stroke_count, std::memory_order_relaxed);
+
         /* Reset calls. */
         ctx.nverts = 0;
         ctx.npaths = 0;
         ctx.ncalls = 0;
         ctx.nuniforms = 0;
+
+        if (m_flush_callback) {
+            m_flush_callback();
+        }
+    }
+
+    void DkRenderer::RecordCalls(dk::CmdBuf cmd_buf, const DKNVGcontext &ctx, int begin, int end) {
+        /* Iterate over calls. */
+        for (int i = begin; i < end; i++) {
+            const DKNVGcall &call = ctx.calls[i];
+            const auto texture = m_call_textures[i];
+
+            /* Perform blending. */
+            cmd_buf.bindBlendStates(0, { dk::BlendState{}.setFactors(static_cast<DkBlendFactor>(call.blendFunc.srcRGB), static_cast<DkBlendFactor>(call.blendFunc.dstRGB), static_cast<DkBlendFactor>(call.blendFunc.srcAlpha), static_cast<DkBlendFactor>(call.blendFunc.dstRGB)) });
+
+            if (call.type == DKNVG_FILL) {
+                this->DrawFill(cmd_buf, ctx, call, texture);
+            } else if (call.type == DKNVG_CONVEXFILL) {
+                this->DrawConvexFill(cmd_buf, ctx, call, texture);
+            } else if (call.type == DKNVG_STROKE || call.type == DKNVG_STENCILSTROKE) {
+                this->DrawStroke(cmd_buf, ctx, call, texture);
+            } else if (call.type == DKNVG_TRIANGLES) {
+                this->DrawTriangles(cmd_buf, ctx, call, texture);
+            }
+        }
+    }
+
+    void DkRenderer::RecordingThreadMain(RecordingWorker *worker) {
+        std::unique_lock lk(m_recording_mutex);
+
+        while (true) {
+            m_recording_cond.wait(lk, [&] { return m_recording_generation != worker->generation || m_recording_quit; });
+            if (m_recording_quit) {
+                break;
+            }
+            worker->generation = m_recording_generation;
+
+            /* Record the range into our own command buffer, the draw state of the previous list carries over. */
+            if (worker->call_begin < worker->call_end) {
+                const DKNVGcontext &ctx = *m_recording_ctx;
+                lk.unlock();
+                worker->cmd_mem.begin(worker->cmd_buf);
+                this->RecordCalls(worker->cmd_buf, ctx, worker->call_begin, worker->call_end);
+                worker->cmd_list = worker->cmd_mem.end(worker->cmd_buf);
+                lk.lock();
+            }
+
+            if (--m_recording_pending == 0) {
+                m_recording_done_cond.notify_all();
+            }
+        }
+    }
+
+    void DkRenderer::StopRecordingThreads() {
+        {
+            std::scoped_lock lk(m_recording_mutex);
+            m_recording_quit = true;
+        }
+        m_recording_cond.notify_all();
+
+        for (auto &worker : m_recording_workers) {
+            worker->thread.join();
+        }
+
+        m_recording_workers.clear();
+        m_recording_quit = false;
+    }
+
+    void DkRenderer::SetRecordingThreads(u32 count) {
+        std::scoped_lock lk(m_queue_mutex);
+        count = std::min<u32>(count, MaxRecordingThreads);
+        if (count == m_recording_workers.size()) {
+            return;
+        }
+
+        this->StopRecordingThreads();
+
+        for (u32 i = 0; i < count; i++) {
+            auto worker = std::make_unique<RecordingWorker>();
+            worker->cmd_buf = dk::CmdBufMaker{m_device}.create();
+            worker->cmd_mem.allocate(m_data_mem_pool, DynamicCmdSize);
+            worker->generation = m_recording_generation;
+            worker->call_begin = 0;
+            worker->call_end = 0;
+            worker->thread = std::thread(&DkRenderer::RecordingThreadMain, this, worker.get());
+            m_recording_workers.push_back(std::move(worker));
+        }
+    }
+
+    void DkRenderer::Submit(DKNVGcontext &ctx) {
+        std::unique_lock lk(m_frame_mutex);
+
+        /* Wait for the render thread to finish the previous frame, the frame arena only keeps two frames alive. */
+        const u64 wait_start = armGetSystemTick();
+        m_frame_cond.wait(lk, [this] { return !m_frame_pending; });
+        m_submit_wait_ns.store(armTicksToNs(armGetSystemTick() - wait_start), std::memory_order_relaxed);
+
+        /* The buffers stay valid until the frame after the next one begins. The next frame stages its texture updates */
+        /* in the other batch, which the render thread finished copying with the previous frame. */
+        m_pending_frame = ctx;
+        m_pending_upload_batch = m_upload_batch;
+        m_upload_batch ^= 1;
+        m_frame_pending = true;
+        lk.unlock();
+        m_frame_cond.notify_all();
+
+        /* Start the next frame. */
+        ctx.nverts = 0;
+        ctx.npaths = 0;
+        ctx.ncalls = 0;
+        ctx.nuniforms = 0;
+    }
+
+    void DkRenderer::WaitIdle() {
+        std::unique_lock lk(m_frame_mutex);
+        m_frame_cond.wait(lk, [this] { return !m_frame_pending; });
+    }
+
+    void DkRenderer::RenderThreadMain() {
+        std::unique_lock lk(m_frame_mutex);
+
+        while (true) {
+            /* Wait for a frame, a pending frame is still flushed when quitting. */
+            const u64 wait_start = armGetSystemTick();
+            m_frame_cond.wait(lk, [this] { return m_frame_pending || m_quit; });
+            m_render_wait_ns.store(armTicksToNs(armGetSystemTick() - wait_start), std::memory_order_relaxed);
+            if (!m_frame_pending) {
+                break;
+            }
+
+            DKNVGcontext frame = m_pending_frame;
+            UploadBatch &uploads = m_upload_batches[m_pending_upload_batch];
+            lk.unlock();
+            this->FlushFrame(frame, uploads);
+            lk.lock();
+
+            m_frame_pending = false;
+            m_frame_cond.notify_all();
+        }
+    }
+
+    void DkRenderer::SetResolveTarget(dk::Image *image) {
+        std::scoped_lock lk(m_queue_mutex);
+        m_resolve_target = image;
+    }
+
+    void DkRenderer::SetClearColor(const NVGcolor &color) {
+        std::scoped_lock lk(m_queue_mutex);
+        m_clear_color = color;
+    }
+
+    void DkRenderer::SetFlushCallback(std::function<void()> callback) {
+        std::scoped_lock lk(m_queue_mutex);
+        m_flush_callback = std::move(callback);
+    }
+
+    u32 DkRenderer::GetSinglePassStrokeCount() {
+        return m_single_pass_stroke_count.load(std::memory_order_relaxed);
+    }
+
+    u64 DkRenderer::GetSubmitWaitTime() {
+        return m_submit_wait_ns.load(std::memory_order_relaxed);
+    }
+
+    u64 DkRenderer::GetRenderWaitTime() {
+        return m_render_wait_ns.load(std::memory_order_relaxed);
     }
 
 }
\ No newline at end of file
@@ -27,6 +27,22 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// Segment setup and join calculation use vector kernels, chosen at compile time.
+// Define NVG_NO_SIMD to force the scalar versions.
+#if !defined(NVG_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NVG_SIMD_NEON
+#elif !defined(NVG_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define NVG_SIMD_SSE2
+#endif
+
+// Deferred tessellation runs on worker threads. Define NVG_NO_THREADS to tessellate
+// on the calling thread only.
+#ifndef NVG_NO_THREADS
+#include <pthread.h>
+#endif
+
 #ifdef _MSC_VER
 #pragma warning(disable: 4100)  // unreferenced formal parameter
 #pragma warning(disable: 4127)  // conditional expression is constant
@@ -42,7 +58,24 @@
 #define NVG_INIT_POINTS_SIZE 128
 #define NVG_INIT_PATHS_SIZE 16
 #define NVG_INIT_VERTS_SIZE 256
+#define NVG_INIT_CALLS_SIZE 64
+#define NVG_INIT_ARENA_SIZE (256*1024)
+#define NVG_ARENA_ALIGN 16
+#define NVG_MAX_ARENA_FRAMES 2
 #define NVG_MAX_STATES 32
+#define NVG_MAX_DISJOINT_PATHS 256
+#define NVG_MAX_DASHES 16
+#define NVG_MAX_BEZIER_QUADS 1024
+#define NVG_MAX_BEZIER_SEGS 1024
+#define NVG_BEZIER_QUAD_CACHE 32
+// The parabola approximation only estimates the error, scale the tolerance so that the maximum
+// deviation of flattened curves stays within tessTol.
+#define NVG_BEZIER_TOL_SCALE 0.75f
+#define NVG_TESS_CACHE_BUCKETS 1024
+#define NVG_INIT_TESS_CACHE_SIZE (4*1024*1024)
+#define NVG_TEXT_CACHE_BUCKETS 256
+#define NVG_INIT_TEXT_CACHE_SIZE (256*1024)
+#define NVG_TEXT_STYLE_SIZE 5
 
 #define NVG_KAPPA90 0.5522847493f	// Length proportional to radius of a cubic bezier handle for 90deg arcs.
 
@@ -74,6 +107,9 @@ struct NVGstate {
 	float miterLimit;
 	int lineJoin;
 	int lineCap;
+	float dashes[NVG_MAX_DASHES];
+	int ndashes;
+	float dashOffset;
 	float alpha;
 	float xform[6];
 	NVGscissor scissor;
@@ -86,17 +122,22 @@ struct NVGstate {
 };
 typedef struct NVGstate NVGstate;
 
-struct NVGpoint {
-	float x,y;
-	float dx, dy;
-	float len;
-	float dmx, dmy;
-	unsigned char flags;
+// Flattened points are stored as structure-of-arrays, so that each pass only touches
+// the fields it needs and the segment and join math can be vectorized.
+struct NVGpoints {
+	float* x;
+	float* y;
+	float* dx;
+	float* dy;
+	float* len;
+	float* dmx;
+	float* dmy;
+	unsigned char* flags;
 };
-typedef struct NVGpoint NVGpoint;
+typedef struct NVGpoints NVGpoints;
 
 struct NVGpathCache {
-	NVGpoint* points;
+	NVGpoints points;
 	int npoints;
 	int cpoints;
 	NVGpath* paths;
@@ -106,18 +147,222 @@ struct NVGpathCache {
 	int nverts;
 	int cverts;
 	float bounds[4];
+	// Peak use during the last frame, which sizes the arrays of the next frame.
+	int peakPoints;
+	int peakPaths;
+	int peakVerts;
 };
 typedef struct NVGpathCache NVGpathCache;
 
+struct NVGbezierQuad {
+	float x0, y0, x1, y1, x2, y2;
+	float a0, a2;
+	float val;
+};
+typedef struct NVGbezierQuad NVGbezierQuad;
+
+struct NVGtessellation {
+	NVGpath* paths;
+	int npaths;
+	NVGvertex* verts;
+	int nverts;
+	float bounds[4];
+};
+typedef struct NVGtessellation NVGtessellation;
+
+struct NVGcompiledPath {
+	NVGtessellation fill;
+	NVGtessellation stroke;
+	float scale;
+	float strokeWidth;
+	float strokeCoverage;
+	NVGpath* xpaths;
+};
+
+struct NVGtessCacheEntry {
+	unsigned int hash;
+	int* key;
+	int nkey;
+	NVGtessellation tess;
+	float strokeWidth;
+	float coverage;
+	int size;
+	struct NVGtessCacheEntry* next;
+	struct NVGtessCacheEntry* lruPrev;
+	struct NVGtessCacheEntry* lruNext;
+};
+typedef struct NVGtessCacheEntry NVGtessCacheEntry;
+
+struct NVGtessCache {
+	NVGtessCacheEntry* buckets[NVG_TESS_CACHE_BUCKETS];
+	NVGtessCacheEntry* lruHead;
+	NVGtessCacheEntry* lruTail;
+	int size;
+	int maxSize;
+	int* key;
+	int nkey;
+	int ckey;
+	unsigned int hash;
+	NVGpath* paths;
+	int cpaths;
+};
+typedef struct NVGtessCache NVGtessCache;
+
+// Glyph quad of a cached text run in font pixels, relative to the pixel the run starts in.
+struct NVGtextRunGlyph {
+	float x0, y0, x1, y1;
+	float s0, t0, s1, t1;
+	int page;
+	int pageGeneration;	// Generation of the atlas page the texture coordinates are valid for.
+};
+typedef struct NVGtextRunGlyph NVGtextRunGlyph;
+
+// Laid out string, the glyphs and the string are stored after the header.
+struct NVGtextRun {
+	unsigned int hash;
+	int style[NVG_TEXT_STYLE_SIZE];
+	const char* string;
+	int nstring;
+	NVGtextRunGlyph* glyphs;
+	int nglyphs;
+	float dx, dy;		// Offset of the aligned start of the run from the text position.
+	float advance;
+	int generation;		// Atlas generation the texture coordinates are valid for.
+	int size;
+	struct NVGtextRun* next;
+	struct NVGtextRun* lruPrev;
+	struct NVGtextRun* lruNext;
+};
+typedef struct NVGtextRun NVGtextRun;
+
+struct NVGtextCache {
+	NVGtextRun* buckets[NVG_TEXT_CACHE_BUCKETS];
+	NVGtextRun* lruHead;
+	NVGtextRun* lruTail;
+	int size;
+	int maxSize;
+	NVGtextRunGlyph* glyphs;	// Glyphs of the run being laid out.
+	int nglyphs;
+	int cglyphs;
+};
+typedef struct NVGtextCache NVGtextCache;
+
+// A block of the frame arena, the header is followed by the memory of the block.
+struct NVGarenaBlock {
+	struct NVGarenaBlock* next;
+	void* uptr;
+	void (*free)(void* uptr, void* ptr);
+	int size;
+	int used;
+};
+typedef struct NVGarenaBlock NVGarenaBlock;
+
+#define NVG_ARENA_HEADER ((int)((sizeof(NVGarenaBlock) + NVG_ARENA_ALIGN-1) & ~(NVG_ARENA_ALIGN-1)))
+
+struct NVGarena {
+	NVGarenaParams params;
+	NVGarenaBlock* block;	// Current block, blocks added during the frame are linked through next.
+	void* last;				// Most recent allocation, which can be resized in place.
+	NVGarenaBlock* frameBlocks[NVG_MAX_ARENA_FRAMES];	// Blocks of the frames still in use, the current one excluded.
+	int frames;
+	int frame;
+	int frameUsed;
+	int frameAllocs;
+	int trimUsed;			// Largest frameUsed since the arena was last more than half full.
+	int lowFrames;
+	int rebuild;
+};
+
+enum NVGdeferredCallType {
+	NVG_DEFERRED_FILL,
+	NVG_DEFERRED_STROKE,
+	NVG_DEFERRED_TRIANGLES,
+};
+
+// A draw recorded while tessellation threads are used, submitted to the render back-end in nvgEndFrame().
+struct NVGdeferredCall {
+	int type;
+	NVGpaint paint;
+	NVGcompositeOperationState compositeOperation;
+	NVGscissor scissor;
+	float fringe;
+	float strokeWidth;
+	float coverage;
+	float bounds[4];
+	NVGpath* paths;
+	int npaths;
+	NVGvertex* verts;
+	int nverts;
+	// Path commands, style and tessellation cache key of a path which is tessellated in nvgEndFrame().
+	NVGstate* state;
+	float* commands;
+	int ncommands;
+	int* key;
+	int nkey;
+	unsigned int hash;
+};
+typedef struct NVGdeferredCall NVGdeferredCall;
+
+struct NVGtessWorker {
+	struct NVGtessPool* pool;
+	NVGcontext* ctx;		// Context holding the arena and the path caches of the worker.
+	int next, end;			// Range of jobs of the worker. Idle workers steal from the ranges of others.
+#ifndef NVG_NO_THREADS
+	pthread_t thread;
+#endif
+};
+typedef struct NVGtessWorker NVGtessWorker;
+
+struct NVGtessPool {
+	NVGtessWorker* workers;	// The first worker is the thread calling nvgEndFrame().
+	int nworkers;
+	NVGdeferredCall* calls;
+	int* jobs;
+#ifndef NVG_NO_THREADS
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	int generation;
+	int active;
+	int quit;
+#endif
+};
+typedef struct NVGtessPool NVGtessPool;
+
+// Glyphs rasterized in the background, see nvgPrewarmGlyphs().
+struct NVGglyphPool {
+	FONSglyphBatch** batches;	// Batches handed to the glyph thread, oldest first.
+	int cbatches;
+	int nbatches;
+	int ndone;					// Number of batches at the front which are rasterized.
+#ifndef NVG_NO_THREADS
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	int quit;
+#endif
+};
+typedef struct NVGglyphPool NVGglyphPool;
+
 struct NVGcontext {
 	NVGparams params;
+	NVGarena* arena;
 	float* commands;
 	int ccommands;
 	int ncommands;
+	int peakCommands;
+	NVGtessPool* tessPool;
+	NVGdeferredCall* calls;
+	int ccalls;
+	int ncalls;
+	int peakCalls;
 	float commandx, commandy;
 	NVGstate states[NVG_MAX_STATES];
 	int nstates;
 	NVGpathCache* cache;
+	NVGpathCache* dashCache;
+	NVGtessCache* tessCache;
+	NVGtextCache* textCache;
 	float tessTol;
 	float distTol;
 	float fringeWidth;
@@ -125,10 +370,21 @@ struct NVGcontext {
 	struct FONScontext* fs;
 	int fontImages[NVG_MAX_FONTIMAGES];
 	int fontImageIdx;
+	NVGglyphPool* glyphPool;
+	int asyncGlyphs;
 	int drawCallCount;
 	int fillTriCount;
 	int strokeTriCount;
 	int textTriCount;
+	int tessCacheHits;
+	int tessCacheMisses;
+	int textCacheHits;
+	int textCacheMisses;
+	int culledPathCount;
+	int culledGlyphCount;
+	int deferredCount;
+	int pendingGlyphCount;
+	float viewWidth, viewHeight;
 };
 
 static float nvg__sqrtf(float a) { return sqrtf(a); }
@@ -160,36 +416,345 @@ static float nvg__normalize(float *x, float* y)
 	return d;
 }
 
+#if defined(NVG_SIMD_SSE2)
+static int nvg__bitCount4(int m) { return (m & 1) + ((m >> 1) & 1) + ((m >> 2) & 1) + ((m >> 3) & 1); }
+
+static float nvg__hminps(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+	return _mm_cvtss_f32(_mm_min_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1))));
+}
+
+static float nvg__hmaxps(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	return _mm_cvtss_f32(_mm_max_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1))));
+}
+#endif
+
+// Calculates the direction and length of each segment of a closed point loop,
+// the last point connects back to the first, and accumulates the bounds.
+static void nvg__setupSegments(NVGpoints* pts, int npts, float* bounds)
+{
+	int i = 0, i1;
+#if defined(NVG_SIMD_NEON)
+	float32x4_t eps = vdupq_n_f32(1e-6f), one = vdupq_n_f32(1.0f);
+	float32x4_t bminx = vdupq_n_f32(bounds[0]), bminy = vdupq_n_f32(bounds[1]);
+	float32x4_t bmaxx = vdupq_n_f32(bounds[2]), bmaxy = vdupq_n_f32(bounds[3]);
+	for (; i+4 < npts; i += 4) {
+		float32x4_t x0 = vld1q_f32(&pts->x[i]), y0 = vld1q_f32(&pts->y[i]);
+		float32x4_t vdx = vsubq_f32(vld1q_f32(&pts->x[i+1]), x0);
+		float32x4_t vdy = vsubq_f32(vld1q_f32(&pts->y[i+1]), y0);
+		float32x4_t d = vsqrtq_f32(vaddq_f32(vmulq_f32(vdx, vdx), vmulq_f32(vdy, vdy)));
+		float32x4_t id = vbslq_f32(vcgtq_f32(d, eps), vdivq_f32(one, d), one);
+		vst1q_f32(&pts->dx[i], vmulq_f32(vdx, id));
+		vst1q_f32(&pts->dy[i], vmulq_f32(vdy, id));
+		vst1q_f32(&pts->len[i], d);
+		bminx = vminq_f32(bminx, x0);
+		bminy = vminq_f32(bminy, y0);
+		bmaxx = vmaxq_f32(bmaxx, x0);
+		bmaxy = vmaxq_f32(bmaxy, y0);
+	}
+	bounds[0] = vminvq_f32(bminx);
+	bounds[1] = vminvq_f32(bminy);
+	bounds[2] = vmaxvq_f32(bmaxx);
+	bounds[3] = vmaxvq_f32(bmaxy);
+#elif defined(NVG_SIMD_SSE2)
+	__m128 eps = _mm_set1_ps(1e-6f), one = _mm_set1_ps(1.0f);
+	__m128 bminx = _mm_set1_ps(bounds[0]), bminy = _mm_set1_ps(bounds[1]);
+	__m128 bmaxx = _mm_set1_ps(bounds[2]), bmaxy = _mm_set1_ps(bounds[3]);
+	for (; i+4 < npts; i += 4) {
+		__m128 x0 = _mm_loadu_ps(&pts->x[i]), y0 = _mm_loadu_ps(&pts->y[i]);
+		__m128 vdx = _mm_sub_ps(_mm_loadu_ps(&pts->x[i+1]), x0);
+		__m128 vdy = _mm_sub_ps(_mm_loadu_ps(&pts->y[i+1]), y0);
+		__m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vdx, vdx), _mm_mul_ps(vdy, vdy)));
+		__m128 mask = _mm_cmpgt_ps(d, eps);
+		__m128 id = _mm_or_ps(_mm_and_ps(mask, _mm_div_ps(one, d)), _mm_andnot_ps(mask, one));
+		_mm_storeu_ps(&pts->dx[i], _mm_mul_ps(vdx, id));
+		_mm_storeu_ps(&pts->dy[i], _mm_mul_ps(vdy, id));
+		_mm_storeu_ps(&pts->len[i], d);
+		bminx = _mm_min_ps(bminx, x0);
+		bminy = _mm_min_ps(bminy, y0);
+		bmaxx = _mm_max_ps(bmaxx, x0);
+		bmaxy = _mm_max_ps(bmaxy, y0);
+	}
+	bounds[0] = nvg__hminps(bminx);
+	bounds[1] = nvg__hminps(bminy);
+	bounds[2] = nvg__hmaxps(bmaxx);
+	bounds[3] = nvg__hmaxps(bmaxy);
+#endif
+	for (; i < npts; i++) {
+		i1 = i+1 < npts ? i+1 : 0;
+		pts->dx[i] = pts->x[i1] - pts->x[i];
+		pts->dy[i] = pts->y[i1] - pts->y[i];
+		pts->len[i] = nvg__normalize(&pts->dx[i], &pts->dy[i]);
+		bounds[0] = nvg__minf(bounds[0], pts->x[i]);
+		bounds[1] = nvg__minf(bounds[1], pts->y[i]);
+		bounds[2] = nvg__maxf(bounds[2], pts->x[i]);
+		bounds[3] = nvg__maxf(bounds[3], pts->y[i]);
+	}
+}
+
+static void* nvg__arenaDefaultAlloc(void* uptr, int size)
+{
+	NVG_NOTUSED(uptr);
+	return malloc(size);
+}
+
+static void nvg__arenaDefaultFree(void* uptr, void* ptr)
+{
+	NVG_NOTUSED(uptr);
+	free(ptr);
+}
+
+static int nvg__arenaAlign(int size)
+{
+	return (size + NVG_ARENA_ALIGN-1) & ~(NVG_ARENA_ALIGN-1);
+}
+
+static NVGarenaBlock* nvg__arenaNewBlock(NVGarena* arena, int size)
+{
+	void* (*alloc)(void* uptr, int size) = arena->params.alloc != NULL ? arena->params.alloc : nvg__arenaDefaultAlloc;
+	NVGarenaBlock* block = (NVGarenaBlock*)alloc(arena->params.userPtr, NVG_ARENA_HEADER + size);
+	if (block == NULL) return NULL;
+	block->next = NULL;
+	block->uptr = arena->params.userPtr;
+	block->free = arena->params.free != NULL ? arena->params.free : nvg__arenaDefaultFree;
+	block->size = size;
+	block->used = 0;
+	arena->frameAllocs++;
+	return block;
+}
+
+static void nvg__arenaFreeBlocks(NVGarenaBlock* block)
+{
+	while (block != NULL) {
+		NVGarenaBlock* next = block->next;
+		block->free(block->uptr, block);
+		block = next;
+	}
+}
+
+static NVGarena* nvg__allocArena(void)
+{
+	NVGarena* arena = (NVGarena*)malloc(sizeof(NVGarena));
+	if (arena == NULL) return NULL;
+	memset(arena, 0, sizeof(NVGarena));
+	return arena;
+}
+
+static void nvg__deleteArena(NVGarena* arena)
+{
+	int i;
+	if (arena == NULL) return;
+	nvg__arenaFreeBlocks(arena->block);
+	for (i = 0; i < NVG_MAX_ARENA_FRAMES; i++)
+		nvg__arenaFreeBlocks(arena->frameBlocks[i]);
+	free(arena);
+}
+
+// Starts a new frame. If the last frame did not fit in one block, the blocks are replaced by
+// a single block large enough to hold it. The arena shrinks when the trim policy asks for it.
+static void nvg__arenaReset(NVGarena* arena)
+{
+	NVGarenaBlock* block;
+	int used = arena->frameUsed;
+	int size;
+
+	// Keep the memory of the last frame, and continue with the blocks of the oldest frame.
+	if (arena->frames > 1) {
+		arena->frameBlocks[arena->frame] = arena->block;
+		arena->frame = (arena->frame + 1) % arena->frames;
+		arena->block = arena->frameBlocks[arena->frame];
+		arena->frameBlocks[arena->frame] = NULL;
+	}
+	block = arena->block;
+	size = block != NULL ? block->size : 0;
+
+	if (block != NULL && arena->params.trimFrames > 0) {
+		if (used < size/2) {
+			arena->trimUsed = nvg__maxi(arena->trimUsed, used);
+			if (++arena->lowFrames >= arena->params.trimFrames)
+				size = nvg__maxi(nvg__arenaAlign(arena->trimUsed + arena->trimUsed/4), NVG_INIT_ARENA_SIZE);
+		} else {
+			arena->trimUsed = 0;
+			arena->lowFrames = 0;
+		}
+	}
+	if (block != NULL && (block->next != NULL || arena->rebuild))
+		size = nvg__maxi(nvg__arenaAlign(used + used/4), NVG_INIT_ARENA_SIZE);
+
+	arena->frameUsed = 0;
+	arena->frameAllocs = 0;
+	arena->last = NULL;
+
+	if ((block != NULL && size != block->size) || arena->rebuild) {
+		nvg__arenaFreeBlocks(block);
+		arena->block = size > 0 ? nvg__arenaNewBlock(arena, size) : NULL;
+		arena->trimUsed = 0;
+		arena->lowFrames = 0;
+		arena->rebuild = 0;
+	} else if (block != NULL) {
+		block->used = 0;
+	}
+}
+
+NVGarena* nvgInternalArena(NVGcontext* ctx)
+{
+	return ctx->arena;
+}
+
+void nvgArenaFrames(NVGarena* arena, int frames)
+{
+	arena->frames = nvg__clampi(frames, 1, NVG_MAX_ARENA_FRAMES);
+}
+
+void* nvgArenaAlloc(NVGarena* arena, int size)
+{
+	NVGarenaBlock* block = arena->block;
+	void* ptr;
+
+	size = nvg__arenaAlign(nvg__maxi(size, 1));
+	if (block == NULL || block->used + size > block->size) {
+		// Chain a new block, the next reset merges the blocks of the frame.
+		NVGarenaBlock* nblock = nvg__arenaNewBlock(arena, nvg__maxi(size, block != NULL ? block->size : NVG_INIT_ARENA_SIZE));
+		if (nblock == NULL) return NULL;
+		nblock->next = block;
+		arena->block = block = nblock;
+	}
+
+	ptr = (unsigned char*)block + NVG_ARENA_HEADER + block->used;
+	block->used += size;
+	arena->frameUsed += size;
+	arena->last = ptr;
+	return ptr;
+}
+
+void* nvgArenaRealloc(NVGarena* arena, void* ptr, int size, int nsize)
+{
+	NVGarenaBlock* block = arena->block;
+	void* nptr;
+
+	if (ptr != NULL && ptr == arena->last) {
+		int offset = (int)((unsigned char*)ptr - ((unsigned char*)block + NVG_ARENA_HEADER));
+		int used = offset + nvg__arenaAlign(nvg__maxi(nsize, 1));
+		if (used <= block->size) {
+			arena->frameUsed += used - block->used;
+			block->used = used;
+			return ptr;
+		}
+	}
+
+	nptr = nvgArenaAlloc(arena, nsize);
+	if (nptr == NULL) return NULL;
+	if (ptr != NULL && size > 0)
+		memcpy(nptr, ptr, nvg__mini(size, nsize));
+	return nptr;
+}
+
+void nvgFrameArenaParams(NVGcontext* ctx, const NVGarenaParams* params)
+{
+	ctx->arena->params = *params;
+	ctx->arena->rebuild = 1;
+}
+
+// Capacity of a per frame array, from its peak use during the last frame plus some headroom.
+static int nvg__frameCapacity(int peak, int init)
+{
+	return nvg__maxi(peak + peak/8, init);
+}
+
+// Returns the point arrays offset to the first point of a path.
+static NVGpoints nvg__pathPoints(NVGpathCache* c, int first)
+{
+	NVGpoints pts;
+	pts.x = c->points.x + first;
+	pts.y = c->points.y + first;
+	pts.dx = c->points.dx + first;
+	pts.dy = c->points.dy + first;
+	pts.len = c->points.len + first;
+	pts.dmx = c->points.dmx + first;
+	pts.dmy = c->points.dmy + first;
+	pts.flags = c->points.flags + first;
+	return pts;
+}
+
+// Grows the point arrays to hold cpoints points. All arrays live in one allocation.
+static int nvg__reservePoints(NVGarena* arena, NVGpathCache* c, int cpoints)
+{
+	NVGpoints pts;
+	float* mem;
+
+	if (cpoints <= c->cpoints)
+		return 1;
+
+	mem = (float*)nvgArenaAlloc(arena, (sizeof(float)*7 + 1) * cpoints);
+	if (mem == NULL) return 0;
+
+	pts.x = mem;
+	pts.y = pts.x + cpoints;
+	pts.dx = pts.y + cpoints;
+	pts.dy = pts.dx + cpoints;
+	pts.len = pts.dy + cpoints;
+	pts.dmx = pts.len + cpoints;
+	pts.dmy = pts.dmx + cpoints;
+	pts.flags = (unsigned char*)(pts.dmy + cpoints);
+
+	if (c->points.x != NULL) {
+		memcpy(pts.x, c->points.x, sizeof(float)*c->npoints);
+		memcpy(pts.y, c->points.y, sizeof(float)*c->npoints);
+		memcpy(pts.dx, c->points.dx, sizeof(float)*c->npoints);
+		memcpy(pts.dy, c->points.dy, sizeof(float)*c->npoints);
+		memcpy(pts.len, c->points.len, sizeof(float)*c->npoints);
+		memcpy(pts.dmx, c->points.dmx, sizeof(float)*c->npoints);
+		memcpy(pts.dmy, c->points.dmy, sizeof(float)*c->npoints);
+		memcpy(pts.flags, c->points.flags, c->npoints);
+	}
+
+	c->points = pts;
+	c->cpoints = cpoints;
+	return 1;
+}
+
+// Allocates the arrays of the path cache from the arena, after the arena has been reset.
+static int nvg__resetPathCache(NVGarena* arena, NVGpathCache* c)
+{
+	int cpoints = nvg__frameCapacity(nvg__maxi(c->peakPoints, c->npoints), NVG_INIT_POINTS_SIZE);
+	int cpaths = nvg__frameCapacity(nvg__maxi(c->peakPaths, c->npaths), NVG_INIT_PATHS_SIZE);
+	int cverts = nvg__frameCapacity(c->peakVerts, NVG_INIT_VERTS_SIZE);
+
+	memset(&c->points, 0, sizeof(c->points));
+	c->npoints = c->cpoints = 0;
+	c->npaths = c->cpaths = 0;
+	c->nverts = c->cverts = 0;
+	c->peakPoints = c->peakPaths = c->peakVerts = 0;
+
+	if (!nvg__reservePoints(arena, c, cpoints)) return 0;
+
+	c->paths = (NVGpath*)nvgArenaAlloc(arena, sizeof(NVGpath)*cpaths);
+	if (!c->paths) return 0;
+	c->cpaths = cpaths;
+
+	c->verts = (NVGvertex*)nvgArenaAlloc(arena, sizeof(NVGvertex)*cverts);
+	if (!c->verts) return 0;
+	c->cverts = cverts;
+
+	return 1;
+}
 
 static void nvg__deletePathCache(NVGpathCache* c)
 {
 	if (c == NULL) return;
-	if (c->points != NULL) free(c->points);
-	if (c->paths != NULL) free(c->paths);
-	if (c->verts != NULL) free(c->verts);
 	free(c);
 }
 
-static NVGpathCache* nvg__allocPathCache(void)
+static NVGpathCache* nvg__allocPathCache(NVGarena* arena)
 {
 	NVGpathCache* c = (NVGpathCache*)malloc(sizeof(NVGpathCache));
 	if (c == NULL) goto error;
 	memset(c, 0, sizeof(NVGpathCache));
 
-	c->points = (NVGpoint*)malloc(sizeof(NVGpoint)*NVG_INIT_POINTS_SIZE);
-	if (!c->points) goto error;
-	c->npoints = 0;
-	c->cpoints = NVG_INIT_POINTS_SIZE;
-
-	c->paths = (NVGpath*)malloc(sizeof(NVGpath)*NVG_INIT_PATHS_SIZE);
-	if (!c->paths) goto error;
-	c->npaths = 0;
-	c->cpaths = NVG_INIT_PATHS_SIZE;
-
-	c->verts = (NVGvertex*)malloc(sizeof(NVGvertex)*NVG_INIT_VERTS_SIZE);
-	if (!c->verts) goto error;
-	c->nverts = 0;
-	c->cverts = NVG_INIT_VERTS_SIZE;
+	if (!nvg__resetPathCache(arena, c)) goto error;
 
 	return c;
 error:
@@ -197,6 +762,130 @@ error:
 	return NULL;
 }
 
+// Allocates the per frame arrays from the arena, sized after their peak use in the last frame.
+static void nvg__resetFrameArrays(NVGcontext* ctx)
+{
+	int ccommands = nvg__frameCapacity(nvg__maxi(ctx->peakCommands, ctx->ncommands), NVG_INIT_COMMANDS_SIZE);
+
+	ctx->commands = (float*)nvgArenaAlloc(ctx->arena, sizeof(float)*ccommands);
+	ctx->ccommands = ctx->commands != NULL ? ccommands : 0;
+	ctx->ncommands = 0;
+	ctx->peakCommands = 0;
+
+	nvg__resetPathCache(ctx->arena, ctx->cache);
+	nvg__resetPathCache(ctx->arena, ctx->dashCache);
+
+	ctx->peakCalls = nvg__maxi(ctx->peakCalls, ctx->ncalls);
+	ctx->ccalls = ctx->tessPool != NULL ? nvg__frameCapacity(ctx->peakCalls, NVG_INIT_CALLS_SIZE) : 0;
+	ctx->calls = ctx->ccalls > 0 ? (NVGdeferredCall*)nvgArenaAlloc(ctx->arena, sizeof(NVGdeferredCall)*ctx->ccalls) : NULL;
+	if (ctx->calls == NULL) ctx->ccalls = 0;
+	ctx->ncalls = 0;
+	ctx->peakCalls = 0;
+}
+
+static void nvg__transformVerts(NVGvertex* dst, const NVGvertex* src, int nverts, const float* t)
+{
+	int i;
+	for (i = 0; i < nverts; i++) {
+		float x = src[i].x, y = src[i].y;
+		dst[i].x = x*t[0] + y*t[2] + t[4];
+		dst[i].y = x*t[1] + y*t[3] + t[5];
+		dst[i].u = src[i].u;
+		dst[i].v = src[i].v;
+	}
+}
+
+static void nvg__deleteTessellation(NVGtessellation* tess)
+{
+	if (tess->paths != NULL) free(tess->paths);
+	if (tess->verts != NULL) free(tess->verts);
+	memset(tess, 0, sizeof(*tess));
+}
+
+static void nvg__tessCacheRemove(NVGtessCache* tc, NVGtessCacheEntry* entry)
+{
+	NVGtessCacheEntry** prev = &tc->buckets[entry->hash & (NVG_TESS_CACHE_BUCKETS-1)];
+	while (*prev != entry)
+		prev = &(*prev)->next;
+	*prev = entry->next;
+
+	if (entry->lruPrev != NULL) entry->lruPrev->lruNext = entry->lruNext;
+	else tc->lruHead = entry->lruNext;
+	if (entry->lruNext != NULL) entry->lruNext->lruPrev = entry->lruPrev;
+	else tc->lruTail = entry->lruPrev;
+
+	tc->size -= entry->size;
+	nvg__deleteTessellation(&entry->tess);
+	free(entry->key);
+	free(entry);
+}
+
+static void nvg__tessCacheTrim(NVGtessCache* tc, int maxSize)
+{
+	while (tc->lruTail != NULL && tc->size > maxSize)
+		nvg__tessCacheRemove(tc, tc->lruTail);
+}
+
+static void nvg__deleteTessCache(NVGtessCache* tc)
+{
+	if (tc == NULL) return;
+	nvg__tessCacheTrim(tc, 0);
+	if (tc->key != NULL) free(tc->key);
+	if (tc->paths != NULL) free(tc->paths);
+	free(tc);
+}
+
+static NVGtessCache* nvg__allocTessCache(void)
+{
+	NVGtessCache* tc = (NVGtessCache*)malloc(sizeof(NVGtessCache));
+	if (tc == NULL) goto error;
+	memset(tc, 0, sizeof(NVGtessCache));
+	tc->maxSize = NVG_INIT_TESS_CACHE_SIZE;
+	return tc;
+error:
+	nvg__deleteTessCache(tc);
+	return NULL;
+}
+
+static void nvg__textCacheRemove(NVGtextCache* tc, NVGtextRun* run)
+{
+	NVGtextRun** prev = &tc->buckets[run->hash & (NVG_TEXT_CACHE_BUCKETS-1)];
+	while (*prev != run)
+		prev = &(*prev)->next;
+	*prev = run->next;
+
+	if (run->lruPrev != NULL) run->lruPrev->lruNext = run->lruNext;
+	else tc->lruHead = run->lruNext;
+	if (run->lruNext != NULL) run->lruNext->lruPrev = run->lruPrev;
+	else tc->lruTail = run->lruPrev;
+
+	tc->size -= run->size;
+	free(run);
+}
+
+static void nvg__textCacheTrim(NVGtextCache* tc, int maxSize)
+{
+	while (tc->lruTail != NULL && tc->size > maxSize)
+		nvg__textCacheRemove(tc, tc->lruTail);
+}
+
+static void nvg__deleteTextCache(NVGtextCache* tc)
+{
+	if (tc == NULL) return;
+	nvg__textCacheTrim(tc, 0);
+	if (tc->glyphs != NULL) free(tc->glyphs);
+	free(tc);
+}
+
+static NVGtextCache* nvg__allocTextCache(void)
+{
+	NVGtextCache* tc = (NVGtextCache*)malloc(sizeof(NVGtextCache));
+	if (tc == NULL) return NULL;
+	memset(tc, 0, sizeof(NVGtextCache));
+	tc->maxSize = NVG_INIT_TEXT_CACHE_SIZE;
+	return tc;
+}
+
 static void nvg__setDevicePixelRatio(NVGcontext* ctx, float ratio)
 {
 	ctx->tessTol = 0.25f / ratio;
@@ -283,6 +972,21 @@ static NVGstate* nvg__getState(NVGcontext* ctx)
 	return &ctx->states[ctx->nstates-1];
 }
 
+// Deferred tessellation, defined after the path expansion.
+static void nvg__submitDeferred(NVGcontext* ctx);
+static void nvg__deleteTessPool(NVGtessPool* pool);
+
+// Font atlas upload and glyph thread, defined with the text rendering.
+static void nvg__flushTextTexture(NVGcontext* ctx);
+static void nvg__submitGlyphs(NVGcontext* ctx);
+static void nvg__applyGlyphs(NVGcontext* ctx);
+static void nvg__deleteGlyphPool(NVGglyphPool* pool);
+
+static int nvg__fontImageFlags(NVGcontext* ctx)
+{
+	return ctx->params.sdfText ? NVG_IMAGE_SDF : 0;
+}
+
 NVGcontext* nvgCreateInternal(NVGparams* params)
 {
 	FONSparams fontParams;
@@ -295,14 +999,25 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	for (i = 0; i < NVG_MAX_FONTIMAGES; i++)
 		ctx->fontImages[i] = 0;
 
-	ctx->commands = (float*)malloc(sizeof(float)*NVG_INIT_COMMANDS_SIZE);
+	ctx->arena = nvg__allocArena();
+	if (ctx->arena == NULL) goto error;
+
+	ctx->commands = (float*)nvgArenaAlloc(ctx->arena, sizeof(float)*NVG_INIT_COMMANDS_SIZE);
 	if (!ctx->commands) goto error;
 	ctx->ncommands = 0;
 	ctx->ccommands = NVG_INIT_COMMANDS_SIZE;
 
-	ctx->cache = nvg__allocPathCache();
+	ctx->cache = nvg__allocPathCache(ctx->arena);
 	if (ctx->cache == NULL) goto error;
 
+	ctx->dashCache = nvg__allocPathCache(ctx->arena);
+	if (ctx->dashCache == NULL) goto error;
+
+	ctx->tessCache = nvg__allocTessCache();
+	if (ctx->tessCache == NULL) goto error;
+	ctx->textCache = nvg__allocTextCache();
+	if (ctx->textCache == NULL) goto error;
+
 	nvgSave(ctx);
 	nvgReset(ctx);
 
@@ -315,6 +1030,8 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	fontParams.width = NVG_INIT_FONTIMAGE_SIZE;
 	fontParams.height = NVG_INIT_FONTIMAGE_SIZE;
 	fontParams.flags = FONS_ZERO_TOPLEFT;
+	if (ctx->params.sdfText)
+		fontParams.flags |= FONS_SDF;
 	fontParams.renderCreate = NULL;
 	fontParams.renderUpdate = NULL;
 	fontParams.renderDraw = NULL;
@@ -324,7 +1041,7 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	if (ctx->fs == NULL) goto error;
 
 	// Create font texture
-	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, 0, NULL);
+	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, nvg__fontImageFlags(ctx), NULL);
 	if (ctx->fontImages[0] == 0) goto error;
 	ctx->fontImageIdx = 0;
 
@@ -344,9 +1061,14 @@ void nvgDeleteInternal(NVGcontext* ctx)
 {
 	int i;
 	if (ctx == NULL) return;
-	if (ctx->commands != NULL) free(ctx->commands);
+	nvg__deleteTessPool(ctx->tessPool);
 	if (ctx->cache != NULL) nvg__deletePathCache(ctx->cache);
+	if (ctx->dashCache != NULL) nvg__deletePathCache(ctx->dashCache);
+	if (ctx->tessCache != NULL) nvg__deleteTessCache(ctx->tessCache);
+	if (ctx->textCache != NULL) nvg__deleteTextCache(ctx->textCache);
 
+	// The glyph thread reads the font data.
+	nvg__deleteGlyphPool(ctx->glyphPool);
 	if (ctx->fs)
 		fonsDeleteInternal(ctx->fs);
 
@@ -360,6 +1082,9 @@ void nvgDeleteInternal(NVGcontext* ctx)
 	if (ctx->params.renderDelete != NULL)
 		ctx->params.renderDelete(ctx->params.userPtr);
 
+	// The render back-end allocates its per frame buffers from the arena too.
+	nvg__deleteArena(ctx->arena);
+
 	free(ctx);
 }
 
@@ -375,21 +1100,45 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 
 	nvg__setDevicePixelRatio(ctx, devicePixelRatio);
 
+	// Release the memory of the last frame. The render back-end allocates its buffers again in renderViewport.
+	nvg__arenaReset(ctx->arena);
+	nvg__resetFrameArrays(ctx);
+
+	// Glyphs on atlas pages unused for a frame may now be evicted to make room.
+	nvg__applyGlyphs(ctx);
+	fonsBeginFrame(ctx->fs);
+
 	ctx->params.renderViewport(ctx->params.userPtr, windowWidth, windowHeight, devicePixelRatio);
+	ctx->viewWidth = windowWidth;
+	ctx->viewHeight = windowHeight;
 
 	ctx->drawCallCount = 0;
 	ctx->fillTriCount = 0;
 	ctx->strokeTriCount = 0;
 	ctx->textTriCount = 0;
+	ctx->tessCacheHits = 0;
+	ctx->tessCacheMisses = 0;
+	ctx->textCacheHits = 0;
+	ctx->textCacheMisses = 0;
+	ctx->culledPathCount = 0;
+	ctx->culledGlyphCount = 0;
+	ctx->deferredCount = 0;
+	ctx->pendingGlyphCount = 0;
 }
 
 void nvgCancelFrame(NVGcontext* ctx)
 {
+	ctx->peakCalls = nvg__maxi(ctx->peakCalls, ctx->ncalls);
+	ctx->ncalls = 0;
 	ctx->params.renderCancel(ctx->params.userPtr);
 }
 
 void nvgEndFrame(NVGcontext* ctx)
 {
+	nvg__submitDeferred(ctx);
+	// Upload the glyphs added this frame before the back-end draws anything.
+	nvg__submitGlyphs(ctx);
+	nvg__flushTextTexture(ctx);
 	ctx->params.renderFlush(ctx->params.userPtr);
 	if (ctx->fontImageIdx != 0) {
 		int fontImage = ctx->fontImages[ctx->fontImageIdx];
@@ -696,6 +1445,40 @@ void nvgLineJoin(NVGcontext* ctx, int join)
 	state->lineJoin = join;
 }
 
+void nvgStrokeDash(NVGcontext* ctx, const float* pattern, int count, float offset)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float total = 0.0f;
+	int i;
+
+	state->ndashes = 0;
+	state->dashOffset = offset;
+	if (pattern == NULL || count <= 0 || count > NVG_MAX_DASHES)
+		return;
+
+	// Odd patterns are repeated to get matching dash and gap pairs.
+	if (count & 1) {
+		if (count*2 > NVG_MAX_DASHES)
+			return;
+		for (i = 0; i < count*2; i++)
+			state->dashes[i] = pattern[i % count];
+		count *= 2;
+	} else {
+		for (i = 0; i < count; i++)
+			state->dashes[i] = pattern[i];
+	}
+
+	for (i = 0; i < count; i++) {
+		if (state->dashes[i] < 0.0f)
+			return;
+		total += state->dashes[i];
+	}
+	if (total <= 0.0f)
+		return;
+
+	state->ndashes = count;
+}
+
 void nvgGlobalAlpha(NVGcontext* ctx, float alpha)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -1077,7 +1860,7 @@ static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
 	if (ctx->ncommands+nvals > ctx->ccommands) {
 		float* commands;
 		int ccommands = ctx->ncommands+nvals + ctx->ccommands/2;
-		commands = (float*)realloc(ctx->commands, sizeof(float)*ccommands);
+		commands = (float*)nvgArenaRealloc(ctx->arena, ctx->commands, sizeof(float)*ctx->ncommands, sizeof(float)*ccommands);
 		if (commands == NULL) return;
 		ctx->commands = commands;
 		ctx->ccommands = ccommands;
@@ -1126,8 +1909,11 @@ static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
 
 static void nvg__clearPathCache(NVGcontext* ctx)
 {
-	ctx->cache->npoints = 0;
-	ctx->cache->npaths = 0;
+	NVGpathCache* cache = ctx->cache;
+	cache->peakPoints = nvg__maxi(cache->peakPoints, cache->npoints);
+	cache->peakPaths = nvg__maxi(cache->peakPaths, cache->npaths);
+	cache->npoints = 0;
+	cache->npaths = 0;
 }
 
 static NVGpath* nvg__lastPath(NVGcontext* ctx)
@@ -1143,7 +1929,7 @@ static void nvg__addPath(NVGcontext* ctx)
 	if (ctx->cache->npaths+1 > ctx->cache->cpaths) {
 		NVGpath* paths;
 		int cpaths = ctx->cache->npaths+1 + ctx->cache->cpaths/2;
-		paths = (NVGpath*)realloc(ctx->cache->paths, sizeof(NVGpath)*cpaths);
+		paths = (NVGpath*)nvgArenaRealloc(ctx->arena, ctx->cache->paths, sizeof(NVGpath)*ctx->cache->npaths, sizeof(NVGpath)*cpaths);
 		if (paths == NULL) return;
 		ctx->cache->paths = paths;
 		ctx->cache->cpaths = cpaths;
@@ -1156,44 +1942,45 @@ static void nvg__addPath(NVGcontext* ctx)
 	ctx->cache->npaths++;
 }
 
-static NVGpoint* nvg__lastPoint(NVGcontext* ctx)
+static int nvg__lastPoint(NVGcontext* ctx)
 {
-	if (ctx->cache->npoints > 0)
-		return &ctx->cache->points[ctx->cache->npoints-1];
-	return NULL;
+	return ctx->cache->npoints-1;
+}
+
+static void nvg__appendPoint(NVGcontext* ctx, NVGpath* path, float x, float y, int flags)
+{
+	NVGpathCache* cache = ctx->cache;
+	int i;
+
+	if (cache->npoints+1 > cache->cpoints) {
+		if (!nvg__reservePoints(ctx->arena, cache, cache->npoints+1 + cache->cpoints/2)) return;
+	}
+
+	i = cache->npoints;
+	cache->points.x[i] = x;
+	cache->points.y[i] = y;
+	cache->points.flags[i] = (unsigned char)flags;
+
+	cache->npoints++;
+	path->count++;
 }
 
 static void nvg__addPoint(NVGcontext* ctx, float x, float y, int flags)
 {
+	NVGpathCache* cache = ctx->cache;
 	NVGpath* path = nvg__lastPath(ctx);
-	NVGpoint* pt;
+	int i;
 	if (path == NULL) return;
 
-	if (path->count > 0 && ctx->cache->npoints > 0) {
-		pt = nvg__lastPoint(ctx);
-		if (nvg__ptEquals(pt->x,pt->y, x,y, ctx->distTol)) {
-			pt->flags |= flags;
+	if (path->count > 0 && cache->npoints > 0) {
+		i = nvg__lastPoint(ctx);
+		if (nvg__ptEquals(cache->points.x[i],cache->points.y[i], x,y, ctx->distTol)) {
+			cache->points.flags[i] |= flags;
 			return;
 		}
 	}
 
-	if (ctx->cache->npoints+1 > ctx->cache->cpoints) {
-		NVGpoint* points;
-		int cpoints = ctx->cache->npoints+1 + ctx->cache->cpoints/2;
-		points = (NVGpoint*)realloc(ctx->cache->points, sizeof(NVGpoint)*cpoints);
-		if (points == NULL) return;
-		ctx->cache->points = points;
-		ctx->cache->cpoints = cpoints;
-	}
-
-	pt = &ctx->cache->points[ctx->cache->npoints];
-	memset(pt, 0, sizeof(*pt));
-	pt->x = x;
-	pt->y = y;
-	pt->flags = (unsigned char)flags;
-
-	ctx->cache->npoints++;
-	path->count++;
+	nvg__appendPoint(ctx, path, x, y, flags);
 }
 
 static void nvg__closePath(NVGcontext* ctx)
@@ -1219,10 +2006,12 @@ static float nvg__getAverageScale(float *t)
 
 static NVGvertex* nvg__allocTempVerts(NVGcontext* ctx, int nverts)
 {
+	ctx->cache->peakVerts = nvg__maxi(ctx->cache->peakVerts, nverts);
 	if (nverts > ctx->cache->cverts) {
 		NVGvertex* verts;
 		int cverts = (nverts + 0xff) & ~0xff; // Round up to prevent allocations when things change just slightly.
-		verts = (NVGvertex*)realloc(ctx->cache->verts, sizeof(NVGvertex)*cverts);
+		// The vertices are always written from the start, nothing needs to be copied.
+		verts = (NVGvertex*)nvgArenaRealloc(ctx->arena, ctx->cache->verts, 0, sizeof(NVGvertex)*cverts);
 		if (verts == NULL) return NULL;
 		ctx->cache->verts = verts;
 		ctx->cache->cverts = cverts;
@@ -1240,27 +2029,25 @@ static float nvg__triarea2(float ax, float ay, float bx, float by, float cx, flo
 	return acx*aby - abx*acy;
 }
 
-static float nvg__polyArea(NVGpoint* pts, int npts)
+static float nvg__polyArea(NVGpoints* pts, int npts)
 {
 	int i;
 	float area = 0;
-	for (i = 2; i < npts; i++) {
-		NVGpoint* a = &pts[0];
-		NVGpoint* b = &pts[i-1];
-		NVGpoint* c = &pts[i];
-		area += nvg__triarea2(a->x,a->y, b->x,b->y, c->x,c->y);
-	}
+	for (i = 2; i < npts; i++)
+		area += nvg__triarea2(pts->x[0],pts->y[0], pts->x[i-1],pts->y[i-1], pts->x[i],pts->y[i]);
 	return area * 0.5f;
 }
 
-static void nvg__polyReverse(NVGpoint* pts, int npts)
+// Only the positions and flags are reversed, the rest is calculated after winding is enforced.
+static void nvg__polyReverse(NVGpoints* pts, int npts)
 {
-	NVGpoint tmp;
+	float tx, ty;
+	unsigned char tf;
 	int i = 0, j = npts-1;
 	while (i < j) {
-		tmp = pts[i];
-		pts[i] = pts[j];
-		pts[j] = tmp;
+		tx = pts->x[i]; pts->x[i] = pts->x[j]; pts->x[j] = tx;
+		ty = pts->y[i]; pts->y[i] = pts->y[j]; pts->y[j] = ty;
+		tf = pts->flags[i]; pts->flags[i] = pts->flags[j]; pts->flags[j] = tf;
 		i++;
 		j--;
 	}
@@ -1275,66 +2062,166 @@ static void nvg__vset(NVGvertex* vtx, float x, float y, float u, float v)
 	vtx->v = v;
 }
 
-static void nvg__tesselateBezier(NVGcontext* ctx,
-								 float x1, float y1, float x2, float y2,
-								 float x3, float y3, float x4, float y4,
-								 int level, int type)
+// Flattening uses the parabola approximation from "Flattening quadratic Beziers" by Raph Levien.
+// The cubic is first split into quadratics, the number of segments is then calculated up front
+// for the whole curve and the points are distributed so that each segment has the same error.
+static float nvg__parabolaIntegral(float x)
 {
-	float x12,y12,x23,y23,x34,y34,x123,y123,x234,y234,x1234,y1234;
-	float dx,dy,d2,d3;
-
-	if (level > 10) return;
+	const float d = 0.67f;
+	return x / (1.0f - d + nvg__sqrtf(nvg__sqrtf(d*d*d*d + 0.25f*x*x)));
+}
 
-	x12 = (x1+x2)*0.5f;
-	y12 = (y1+y2)*0.5f;
-	x23 = (x2+x3)*0.5f;
-	y23 = (y2+y3)*0.5f;
-	x34 = (x3+x4)*0.5f;
-	y34 = (y3+y4)*0.5f;
-	x123 = (x12+x23)*0.5f;
-	y123 = (y12+y23)*0.5f;
+static float nvg__parabolaInvIntegral(float x)
+{
+	const float b = 0.39f;
+	return x * (1.0f - b + nvg__sqrtf(b*b + 0.25f*x*x));
+}
 
-	dx = x4 - x1;
-	dy = y4 - y1;
-	d2 = nvg__absf(((x2 - x4) * dy - (y2 - y4) * dx));
-	d3 = nvg__absf(((x3 - x4) * dy - (y3 - y4) * dx));
+static void nvg__bezierQuadParams(NVGbezierQuad* q, float sqrtTol)
+{
+	float d01x = q->x1 - q->x0, d01y = q->y1 - q->y0;
+	float d12x = q->x2 - q->x1, d12y = q->y2 - q->y1;
+	float ddx = d01x - d12x, ddy = d01y - d12y;
+	float cross = (q->x2 - q->x0)*ddy - (q->y2 - q->y0)*ddx;
+	float dd = nvg__sqrtf(ddx*ddx + ddy*ddy);
+	float x0, x2, invCross, sqrtScale, da;
 
-	if ((d2 + d3)*(d2 + d3) < ctx->tessTol * (dx*dx + dy*dy)) {
-		nvg__addPoint(ctx, x4, y4, type);
+	q->a0 = q->a2 = 0.0f;
+	if (dd < 1e-6f || nvg__absf(cross) <= 1e-6f*dd*dd) {
+		// Straight or folded back on itself, flatten uniformly.
+		q->val = nvg__sqrtf(dd);
 		return;
 	}
 
-/*	if (nvg__absf(x1+x3-x2-x2) + nvg__absf(y1+y3-y2-y2) + nvg__absf(x2+x4-x3-x3) + nvg__absf(y2+y4-y3-y3) < ctx->tessTol) {
-		nvg__addPoint(ctx, x4, y4, type);
-		return;
-	}*/
-
-	x234 = (x23+x34)*0.5f;
-	y234 = (y23+y34)*0.5f;
-	x1234 = (x123+x234)*0.5f;
-	y1234 = (y123+y234)*0.5f;
+	// Map the quadratic to a segment of the parabola y = x^2. As x2 - x0 = -dd^2 / cross, the
+	// scale of the mapping is cross^2 / dd^3.
+	invCross = 1.0f / cross;
+	x0 = (d01x*ddx + d01y*ddy) * invCross;
+	x2 = (d12x*ddx + d12y*ddy) * invCross;
+	sqrtScale = nvg__absf(cross) / (dd * nvg__sqrtf(dd));
+
+	q->a0 = nvg__parabolaIntegral(x0);
+	q->a2 = nvg__parabolaIntegral(x2);
+	da = nvg__absf(q->a2 - q->a0);
+	if ((x0 < 0.0f) == (x2 < 0.0f))
+		q->val = da * sqrtScale;
+	else
+		q->val = sqrtTol * da / nvg__parabolaIntegral(sqrtTol / sqrtScale);
+}
 
-	nvg__tesselateBezier(ctx, x1,y1, x12,y12, x123,y123, x1234,y1234, level+1, 0);
-	nvg__tesselateBezier(ctx, x1234,y1234, x234,y234, x34,y34, x4,y4, level+1, type);
+static void nvg__evalBezier(const float* c, float t, float* pd)
+{
+	float u = 1.0f - t;
+	pd[0] = u*u*u*c[0] + 3.0f*u*u*t*c[2] + 3.0f*u*t*t*c[4] + t*t*t*c[6];
+	pd[1] = u*u*u*c[1] + 3.0f*u*u*t*c[3] + 3.0f*u*t*t*c[5] + t*t*t*c[7];
+	pd[2] = 3.0f*(u*u*(c[2]-c[0]) + 2.0f*u*t*(c[4]-c[2]) + t*t*(c[6]-c[4]));
+	pd[3] = 3.0f*(u*u*(c[3]-c[1]) + 2.0f*u*t*(c[5]-c[3]) + t*t*(c[7]-c[5]));
 }
 
-static void nvg__flattenPaths(NVGcontext* ctx)
+// Approximates the cubic between two of its points with a quadratic sharing their positions and
+// tangents. pd0 and pd1 hold the point and derivative at either end, dt is their parameter distance.
+static void nvg__bezierQuad(NVGbezierQuad* q, const float* pd0, const float* pd1, float dt, float sqrtTol)
 {
-	NVGpathCache* cache = ctx->cache;
-//	NVGstate* state = nvg__getState(ctx);
-	NVGpoint* last;
-	NVGpoint* p0;
-	NVGpoint* p1;
-	NVGpoint* pts;
-	NVGpath* path;
-	int i, j;
-	float* cp1;
-	float* cp2;
-	float* p;
-	float area;
+	q->x0 = pd0[0];
+	q->y0 = pd0[1];
+	q->x1 = (2.0f*(pd0[0] + pd1[0]) + dt*(pd0[2] - pd1[2])) * 0.25f;
+	q->y1 = (2.0f*(pd0[1] + pd1[1]) + dt*(pd0[3] - pd1[3])) * 0.25f;
+	q->x2 = pd1[0];
+	q->y2 = pd1[1];
+	nvg__bezierQuadParams(q, sqrtTol);
+}
 
-	if (cache->npaths > 0)
-		return;
+static void nvg__tesselateBezier(NVGcontext* ctx,
+								 float x1, float y1, float x2, float y2,
+								 float x3, float y3, float x4, float y4,
+								 int type)
+{
+	NVGbezierQuad quads[NVG_BEZIER_QUAD_CACHE], tmp, *q;
+	float c[8] = { x1, y1, x2, y2, x3, y3, x4, y4 };
+	float tol = ctx->tessTol * NVG_BEZIER_TOL_SCALE;
+	float tol1 = tol*0.1f, sqrtTol = nvg__sqrtf(tol - tol1);
+	float ex = x4 - 3.0f*x3 + 3.0f*x2 - x1, ey = y4 - 3.0f*y3 + 3.0f*y2 - y1;
+	float dx = x4 - x1, dy = y4 - y1;
+	float d2 = nvg__absf((x2 - x4)*dy - (y2 - y4)*dx);
+	float d3 = nvg__absf((x3 - x4)*dy - (y3 - y4)*dx);
+	float pd[2][4], err, sum = 0.0f, step, target, val0, u0, uscale, t, u, dt;
+	int nquads, n, i, j;
+
+	// The curve stays within 3/4 of the larger control point distance from the chord.
+	if ((d2 + d3)*(d2 + d3)*0.5625f < tol*tol*(dx*dx + dy*dy)) {
+		nvg__addPoint(ctx, x4, y4, type);
+		return;
+	}
+
+	// Split to quadratics, keeping a tenth of the tolerance for the approximation error. The count
+	// is the sixth root of the error estimate, it is small so stepping to it is cheaper than cbrtf.
+	err = (ex*ex + ey*ey) / (432.0f*tol1*tol1);
+	for (nquads = 1; nquads < NVG_MAX_BEZIER_QUADS; nquads++) {
+		float n3 = (float)(nquads*nquads*nquads);
+		if (n3*n3 >= err) break;
+	}
+	dt = 1.0f / nquads;
+
+	// Neighbouring quadratics share their end points, evaluate each one once.
+	nvg__evalBezier(c, 0.0f, pd[0]);
+	for (i = 0; i < nquads; i++) {
+		q = i < NVG_BEZIER_QUAD_CACHE ? &quads[i] : &tmp;
+		nvg__evalBezier(c, (i+1)*dt, pd[(i+1)&1]);
+		nvg__bezierQuad(q, pd[i&1], pd[(i+1)&1], dt, sqrtTol);
+		sum += q->val;
+	}
+
+	n = nvg__clampi((int)ceilf(0.5f * sum / sqrtTol), 1, NVG_MAX_BEZIER_SEGS);
+	step = sum / n;
+
+	j = 1;
+	val0 = 0.0f;
+	for (i = 0; i < nquads && j < n; i++) {
+		if (i < NVG_BEZIER_QUAD_CACHE) {
+			q = &quads[i];
+		} else {
+			// Only very long curves have more quadratics than fit the cache, rebuild those.
+			q = &tmp;
+			nvg__evalBezier(c, i*dt, pd[0]);
+			nvg__evalBezier(c, (i+1)*dt, pd[1]);
+			nvg__bezierQuad(q, pd[0], pd[1], dt, sqrtTol);
+		}
+		if ((target = j*step) < val0 + q->val) {
+			u0 = 0.0f;
+			uscale = 0.0f;
+			if (q->a0 != q->a2) {
+				u0 = nvg__parabolaInvIntegral(q->a0);
+				uscale = 1.0f / (nvg__parabolaInvIntegral(q->a2) - u0);
+			}
+			do {
+				t = (target - val0) / q->val;
+				if (uscale != 0.0f)
+					t = (nvg__parabolaInvIntegral(q->a0 + (q->a2 - q->a0)*t) - u0) * uscale;
+				u = 1.0f - t;
+				nvg__addPoint(ctx, u*u*q->x0 + 2.0f*u*t*q->x1 + t*t*q->x2, u*u*q->y0 + 2.0f*u*t*q->y1 + t*t*q->y2, 0);
+				j++;
+			} while (j < n && (target = j*step) < val0 + q->val);
+		}
+		val0 += q->val;
+	}
+
+	nvg__addPoint(ctx, x4, y4, type);
+}
+
+static void nvg__flattenPaths(NVGcontext* ctx)
+{
+	NVGpathCache* cache = ctx->cache;
+//	NVGstate* state = nvg__getState(ctx);
+	NVGpoints pts;
+	NVGpath* path;
+	int i, j, last;
+	float* cp1;
+	float* cp2;
+	float* p;
+	float area;
+
+	if (cache->npaths > 0)
+		return;
 
 	// Flatten
 	i = 0;
@@ -1354,11 +2241,11 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 			break;
 		case NVG_BEZIERTO:
 			last = nvg__lastPoint(ctx);
-			if (last != NULL) {
+			if (last >= 0) {
 				cp1 = &ctx->commands[i+1];
 				cp2 = &ctx->commands[i+3];
 				p = &ctx->commands[i+5];
-				nvg__tesselateBezier(ctx, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], 0, NVG_PT_CORNER);
+				nvg__tesselateBezier(ctx, cache->points.x[last],cache->points.y[last], cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], NVG_PT_CORNER);
 			}
 			i += 7;
 			break;
@@ -1381,40 +2268,169 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 	// Calculate the direction and length of line segments.
 	for (j = 0; j < cache->npaths; j++) {
 		path = &cache->paths[j];
-		pts = &cache->points[path->first];
+		pts = nvg__pathPoints(cache, path->first);
 
 		// If the first and last points are the same, remove the last, mark as closed path.
-		p0 = &pts[path->count-1];
-		p1 = &pts[0];
-		if (nvg__ptEquals(p0->x,p0->y, p1->x,p1->y, ctx->distTol)) {
+		if (nvg__ptEquals(pts.x[path->count-1],pts.y[path->count-1], pts.x[0],pts.y[0], ctx->distTol)) {
 			path->count--;
-			p0 = &pts[path->count-1];
 			path->closed = 1;
 		}
 
 		// Enforce winding.
 		if (path->count > 2) {
-			area = nvg__polyArea(pts, path->count);
+			area = nvg__polyArea(&pts, path->count);
 			if (path->winding == NVG_CCW && area < 0.0f)
-				nvg__polyReverse(pts, path->count);
+				nvg__polyReverse(&pts, path->count);
 			if (path->winding == NVG_CW && area > 0.0f)
-				nvg__polyReverse(pts, path->count);
+				nvg__polyReverse(&pts, path->count);
+		}
+
+		path->bounds[0] = path->bounds[1] = 1e6f;
+		path->bounds[2] = path->bounds[3] = -1e6f;
+
+		// Calculate segment direction and length, and update bounds.
+		nvg__setupSegments(&pts, path->count, path->bounds);
+
+		cache->bounds[0] = nvg__minf(cache->bounds[0], path->bounds[0]);
+		cache->bounds[1] = nvg__minf(cache->bounds[1], path->bounds[1]);
+		cache->bounds[2] = nvg__maxf(cache->bounds[2], path->bounds[2]);
+		cache->bounds[3] = nvg__maxf(cache->bounds[3], path->bounds[3]);
+	}
+}
+
+// Returns true if the bounds of any two paths, grown by pad, overlap.
+static int nvg__pathBoundsOverlap(NVGpathCache* cache, float pad)
+{
+	int i, j;
+	if (cache->npaths > NVG_MAX_DISJOINT_PATHS)
+		return 1;
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* a = &cache->paths[i];
+		for (j = 0; j < i; j++) {
+			NVGpath* b = &cache->paths[j];
+			if (a->bounds[0] - pad < b->bounds[2] + pad && b->bounds[0] - pad < a->bounds[2] + pad &&
+				a->bounds[1] - pad < b->bounds[3] + pad && b->bounds[1] - pad < a->bounds[3] + pad)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+// Splits the flattened paths into dashes by arc length. The dashes are stored in the dash cache,
+// which becomes the current cache, so that the flattened paths stay intact for subsequent fills.
+static void nvg__dashPaths(NVGcontext* ctx, const float* dashes, int ndashes, float offset)
+{
+	NVGpathCache* src = ctx->cache;
+	NVGpathCache* cache = ctx->dashCache;
+	NVGpath* path;
+	NVGpoints pts;
+	float total = 0.0f;
+	int i, j, k;
+
+	ctx->cache = cache;
+	nvg__clearPathCache(ctx);
+
+	for (k = 0; k < ndashes; k++)
+		total += dashes[k];
+
+	for (j = 0; j < src->npaths; j++) {
+		NVGpath* spath = &src->paths[j];
+		NVGpoints spts = nvg__pathPoints(src, spath->first);
+		int nseg = spath->closed ? spath->count : spath->count-1;
+		int on, firstDash = -1;
+		float remain;
+
+		if (nseg <= 0)
+			continue;
+
+		// Find the dash at the start of the path, an empty dash at the start is drawn.
+		remain = nvg__modf(offset, total);
+		if (remain < 0.0f) remain += total;
+		for (k = 0; remain > dashes[k] || (remain == dashes[k] && dashes[k] > 0.0f); k = (k+1) % ndashes)
+			remain -= dashes[k];
+		remain = dashes[k] - remain;
+		on = (k & 1) == 0;
+
+		if (on) {
+			nvg__addPath(ctx);
+			nvg__addPoint(ctx, spts.x[0], spts.y[0], NVG_PT_CORNER);
+			firstDash = cache->npaths-1;
 		}
 
-		for(i = 0; i < path->count; i++) {
-			// Calculate segment direction and length
-			p0->dx = p1->x - p0->x;
-			p0->dy = p1->y - p0->y;
-			p0->len = nvg__normalize(&p0->dx, &p0->dy);
-			// Update bounds
-			cache->bounds[0] = nvg__minf(cache->bounds[0], p0->x);
-			cache->bounds[1] = nvg__minf(cache->bounds[1], p0->y);
-			cache->bounds[2] = nvg__maxf(cache->bounds[2], p0->x);
-			cache->bounds[3] = nvg__maxf(cache->bounds[3], p0->y);
-			// Advance
-			p0 = p1++;
+		for (i = 0; i < nseg; i++) {
+			int a = i;
+			int b = (i+1) % spath->count;
+			float pos = 0.0f;
+
+			while (spts.len[a] - pos >= remain) {
+				float x, y;
+				pos += remain;
+				x = spts.x[a] + spts.dx[a] * pos;
+				y = spts.y[a] + spts.dy[a] * pos;
+				if (on) {
+					NVGpath* dash = nvg__lastPath(ctx);
+					nvg__addPoint(ctx, x, y, NVG_PT_CORNER);
+					// An empty dash would collapse into one point, keep a tiny segment along
+					// the path instead, so that square and round caps draw a dot.
+					if (dash != NULL && dash->count == 1)
+						nvg__appendPoint(ctx, dash, x + spts.dx[a] * ctx->distTol*0.5f, y + spts.dy[a] * ctx->distTol*0.5f, NVG_PT_CORNER);
+				} else {
+					nvg__addPath(ctx);
+					nvg__addPoint(ctx, x, y, NVG_PT_CORNER);
+				}
+				on = !on;
+				k = (k+1) % ndashes;
+				remain = dashes[k];
+			}
+			remain -= spts.len[a] - pos;
+
+			if (on)
+				nvg__addPoint(ctx, spts.x[b], spts.y[b], spts.flags[b] & NVG_PT_CORNER);
+		}
+
+		// On closed paths, a dash which runs over the start point continues with the first dash.
+		if (spath->closed && firstDash != -1) {
+			NVGpath* first = &cache->paths[firstDash];
+			NVGpath* last = nvg__lastPath(ctx);
+			int n = last->first + last->count-1;
+			if (nvg__ptEquals(cache->points.x[n], cache->points.y[n], spts.x[0], spts.y[0], ctx->distTol)) {
+				if (last == first) {
+					// The dash covers the whole path.
+					if (last->count > 2) {
+						last->count--;
+						last->closed = 1;
+					}
+				} else {
+					for (i = 1; i < first->count; i++) {
+						n = first->first + i;
+						nvg__addPoint(ctx, cache->points.x[n], cache->points.y[n], cache->points.flags[n]);
+					}
+					first->count = 0;
+				}
+			}
 		}
 	}
+
+	// Drop degenerate dashes and calculate the direction and length of the dash segments.
+	cache->bounds[0] = cache->bounds[1] = 1e6f;
+	cache->bounds[2] = cache->bounds[3] = -1e6f;
+	for (j = 0, k = 0; j < cache->npaths; j++) {
+		if (cache->paths[j].count < 2)
+			continue;
+		path = &cache->paths[k++];
+		*path = cache->paths[j];
+		pts = nvg__pathPoints(cache, path->first);
+
+		path->bounds[0] = path->bounds[1] = 1e6f;
+		path->bounds[2] = path->bounds[3] = -1e6f;
+		nvg__setupSegments(&pts, path->count, path->bounds);
+
+		cache->bounds[0] = nvg__minf(cache->bounds[0], path->bounds[0]);
+		cache->bounds[1] = nvg__minf(cache->bounds[1], path->bounds[1]);
+		cache->bounds[2] = nvg__maxf(cache->bounds[2], path->bounds[2]);
+		cache->bounds[3] = nvg__maxf(cache->bounds[3], path->bounds[3]);
+	}
+	cache->npaths = k;
 }
 
 static int nvg__curveDivs(float r, float arc, float tol)
@@ -1423,162 +2439,162 @@ static int nvg__curveDivs(float r, float arc, float tol)
 	return nvg__maxi(2, (int)ceilf(arc / da));
 }
 
-static void nvg__chooseBevel(int bevel, NVGpoint* p0, NVGpoint* p1, float w,
+static void nvg__chooseBevel(int bevel, const NVGpoints* pts, int i0, int i1, float w,
 							float* x0, float* y0, float* x1, float* y1)
 {
 	if (bevel) {
-		*x0 = p1->x + p0->dy * w;
-		*y0 = p1->y - p0->dx * w;
-		*x1 = p1->x + p1->dy * w;
-		*y1 = p1->y - p1->dx * w;
+		*x0 = pts->x[i1] + pts->dy[i0] * w;
+		*y0 = pts->y[i1] - pts->dx[i0] * w;
+		*x1 = pts->x[i1] + pts->dy[i1] * w;
+		*y1 = pts->y[i1] - pts->dx[i1] * w;
 	} else {
-		*x0 = p1->x + p1->dmx * w;
-		*y0 = p1->y + p1->dmy * w;
-		*x1 = p1->x + p1->dmx * w;
-		*y1 = p1->y + p1->dmy * w;
+		*x0 = pts->x[i1] + pts->dmx[i1] * w;
+		*y0 = pts->y[i1] + pts->dmy[i1] * w;
+		*x1 = pts->x[i1] + pts->dmx[i1] * w;
+		*y1 = pts->y[i1] + pts->dmy[i1] * w;
 	}
 }
 
-static NVGvertex* nvg__roundJoin(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1,
+static NVGvertex* nvg__roundJoin(NVGvertex* dst, const NVGpoints* pts, int i0, int i1,
 								 float lw, float rw, float lu, float ru, int ncap,
 								 float fringe)
 {
 	int i, n;
-	float dlx0 = p0->dy;
-	float dly0 = -p0->dx;
-	float dlx1 = p1->dy;
-	float dly1 = -p1->dx;
+	float dlx0 = pts->dy[i0];
+	float dly0 = -pts->dx[i0];
+	float dlx1 = pts->dy[i1];
+	float dly1 = -pts->dx[i1];
 	NVG_NOTUSED(fringe);
 
-	if (p1->flags & NVG_PT_LEFT) {
+	if (pts->flags[i1] & NVG_PT_LEFT) {
 		float lx0,ly0,lx1,ly1,a0,a1;
-		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, lw, &lx0,&ly0, &lx1,&ly1);
+		nvg__chooseBevel(pts->flags[i1] & NVG_PR_INNERBEVEL, pts, i0, i1, lw, &lx0,&ly0, &lx1,&ly1);
 		a0 = atan2f(-dly0, -dlx0);
 		a1 = atan2f(-dly1, -dlx1);
 		if (a1 > a0) a1 -= NVG_PI*2;
 
 		nvg__vset(dst, lx0, ly0, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+		nvg__vset(dst, pts->x[i1] - dlx0*rw, pts->y[i1] - dly0*rw, ru,1); dst++;
 
 		n = nvg__clampi((int)ceilf(((a0 - a1) / NVG_PI) * ncap), 2, ncap);
 		for (i = 0; i < n; i++) {
 			float u = i/(float)(n-1);
 			float a = a0 + u*(a1-a0);
-			float rx = p1->x + cosf(a) * rw;
-			float ry = p1->y + sinf(a) * rw;
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			float rx = pts->x[i1] + cosf(a) * rw;
+			float ry = pts->y[i1] + sinf(a) * rw;
+			nvg__vset(dst, pts->x[i1], pts->y[i1], 0.5f,1); dst++;
 			nvg__vset(dst, rx, ry, ru,1); dst++;
 		}
 
 		nvg__vset(dst, lx1, ly1, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+		nvg__vset(dst, pts->x[i1] - dlx1*rw, pts->y[i1] - dly1*rw, ru,1); dst++;
 
 	} else {
 		float rx0,ry0,rx1,ry1,a0,a1;
-		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, -rw, &rx0,&ry0, &rx1,&ry1);
+		nvg__chooseBevel(pts->flags[i1] & NVG_PR_INNERBEVEL, pts, i0, i1, -rw, &rx0,&ry0, &rx1,&ry1);
 		a0 = atan2f(dly0, dlx0);
 		a1 = atan2f(dly1, dlx1);
 		if (a1 < a0) a1 += NVG_PI*2;
 
-		nvg__vset(dst, p1->x + dlx0*rw, p1->y + dly0*rw, lu,1); dst++;
+		nvg__vset(dst, pts->x[i1] + dlx0*rw, pts->y[i1] + dly0*rw, lu,1); dst++;
 		nvg__vset(dst, rx0, ry0, ru,1); dst++;
 
 		n = nvg__clampi((int)ceilf(((a1 - a0) / NVG_PI) * ncap), 2, ncap);
 		for (i = 0; i < n; i++) {
 			float u = i/(float)(n-1);
 			float a = a0 + u*(a1-a0);
-			float lx = p1->x + cosf(a) * lw;
-			float ly = p1->y + sinf(a) * lw;
+			float lx = pts->x[i1] + cosf(a) * lw;
+			float ly = pts->y[i1] + sinf(a) * lw;
 			nvg__vset(dst, lx, ly, lu,1); dst++;
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			nvg__vset(dst, pts->x[i1], pts->y[i1], 0.5f,1); dst++;
 		}
 
-		nvg__vset(dst, p1->x + dlx1*rw, p1->y + dly1*rw, lu,1); dst++;
+		nvg__vset(dst, pts->x[i1] + dlx1*rw, pts->y[i1] + dly1*rw, lu,1); dst++;
 		nvg__vset(dst, rx1, ry1, ru,1); dst++;
 
 	}
 	return dst;
 }
 
-static NVGvertex* nvg__bevelJoin(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1,
+static NVGvertex* nvg__bevelJoin(NVGvertex* dst, const NVGpoints* pts, int i0, int i1,
 										float lw, float rw, float lu, float ru, float fringe)
 {
 	float rx0,ry0,rx1,ry1;
 	float lx0,ly0,lx1,ly1;
-	float dlx0 = p0->dy;
-	float dly0 = -p0->dx;
-	float dlx1 = p1->dy;
-	float dly1 = -p1->dx;
+	float dlx0 = pts->dy[i0];
+	float dly0 = -pts->dx[i0];
+	float dlx1 = pts->dy[i1];
+	float dly1 = -pts->dx[i1];
 	NVG_NOTUSED(fringe);
 
-	if (p1->flags & NVG_PT_LEFT) {
-		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, lw, &lx0,&ly0, &lx1,&ly1);
+	if (pts->flags[i1] & NVG_PT_LEFT) {
+		nvg__chooseBevel(pts->flags[i1] & NVG_PR_INNERBEVEL, pts, i0, i1, lw, &lx0,&ly0, &lx1,&ly1);
 
 		nvg__vset(dst, lx0, ly0, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+		nvg__vset(dst, pts->x[i1] - dlx0*rw, pts->y[i1] - dly0*rw, ru,1); dst++;
 
-		if (p1->flags & NVG_PT_BEVEL) {
+		if (pts->flags[i1] & NVG_PT_BEVEL) {
 			nvg__vset(dst, lx0, ly0, lu,1); dst++;
-			nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+			nvg__vset(dst, pts->x[i1] - dlx0*rw, pts->y[i1] - dly0*rw, ru,1); dst++;
 
 			nvg__vset(dst, lx1, ly1, lu,1); dst++;
-			nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+			nvg__vset(dst, pts->x[i1] - dlx1*rw, pts->y[i1] - dly1*rw, ru,1); dst++;
 		} else {
-			rx0 = p1->x - p1->dmx * rw;
-			ry0 = p1->y - p1->dmy * rw;
+			rx0 = pts->x[i1] - pts->dmx[i1] * rw;
+			ry0 = pts->y[i1] - pts->dmy[i1] * rw;
 
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
-			nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+			nvg__vset(dst, pts->x[i1], pts->y[i1], 0.5f,1); dst++;
+			nvg__vset(dst, pts->x[i1] - dlx0*rw, pts->y[i1] - dly0*rw, ru,1); dst++;
 
 			nvg__vset(dst, rx0, ry0, ru,1); dst++;
 			nvg__vset(dst, rx0, ry0, ru,1); dst++;
 
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
-			nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+			nvg__vset(dst, pts->x[i1], pts->y[i1], 0.5f,1); dst++;
+			nvg__vset(dst, pts->x[i1] - dlx1*rw, pts->y[i1] - dly1*rw, ru,1); dst++;
 		}
 
 		nvg__vset(dst, lx1, ly1, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+		nvg__vset(dst, pts->x[i1] - dlx1*rw, pts->y[i1] - dly1*rw, ru,1); dst++;
 
 	} else {
-		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, -rw, &rx0,&ry0, &rx1,&ry1);
+		nvg__chooseBevel(pts->flags[i1] & NVG_PR_INNERBEVEL, pts, i0, i1, -rw, &rx0,&ry0, &rx1,&ry1);
 
-		nvg__vset(dst, p1->x + dlx0*lw, p1->y + dly0*lw, lu,1); dst++;
+		nvg__vset(dst, pts->x[i1] + dlx0*lw, pts->y[i1] + dly0*lw, lu,1); dst++;
 		nvg__vset(dst, rx0, ry0, ru,1); dst++;
 
-		if (p1->flags & NVG_PT_BEVEL) {
-			nvg__vset(dst, p1->x + dlx0*lw, p1->y + dly0*lw, lu,1); dst++;
+		if (pts->flags[i1] & NVG_PT_BEVEL) {
+			nvg__vset(dst, pts->x[i1] + dlx0*lw, pts->y[i1] + dly0*lw, lu,1); dst++;
 			nvg__vset(dst, rx0, ry0, ru,1); dst++;
 
-			nvg__vset(dst, p1->x + dlx1*lw, p1->y + dly1*lw, lu,1); dst++;
+			nvg__vset(dst, pts->x[i1] + dlx1*lw, pts->y[i1] + dly1*lw, lu,1); dst++;
 			nvg__vset(dst, rx1, ry1, ru,1); dst++;
 		} else {
-			lx0 = p1->x + p1->dmx * lw;
-			ly0 = p1->y + p1->dmy * lw;
+			lx0 = pts->x[i1] + pts->dmx[i1] * lw;
+			ly0 = pts->y[i1] + pts->dmy[i1] * lw;
 
-			nvg__vset(dst, p1->x + dlx0*lw, p1->y + dly0*lw, lu,1); dst++;
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			nvg__vset(dst, pts->x[i1] + dlx0*lw, pts->y[i1] + dly0*lw, lu,1); dst++;
+			nvg__vset(dst, pts->x[i1], pts->y[i1], 0.5f,1); dst++;
 
 			nvg__vset(dst, lx0, ly0, lu,1); dst++;
 			nvg__vset(dst, lx0, ly0, lu,1); dst++;
 
-			nvg__vset(dst, p1->x + dlx1*lw, p1->y + dly1*lw, lu,1); dst++;
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			nvg__vset(dst, pts->x[i1] + dlx1*lw, pts->y[i1] + dly1*lw, lu,1); dst++;
+			nvg__vset(dst, pts->x[i1], pts->y[i1], 0.5f,1); dst++;
 		}
 
-		nvg__vset(dst, p1->x + dlx1*lw, p1->y + dly1*lw, lu,1); dst++;
+		nvg__vset(dst, pts->x[i1] + dlx1*lw, pts->y[i1] + dly1*lw, lu,1); dst++;
 		nvg__vset(dst, rx1, ry1, ru,1); dst++;
 	}
 
 	return dst;
 }
 
-static NVGvertex* nvg__buttCapStart(NVGvertex* dst, NVGpoint* p,
+static NVGvertex* nvg__buttCapStart(NVGvertex* dst, const NVGpoints* pts, int ip,
 									float dx, float dy, float w, float d,
 									float aa, float u0, float u1)
 {
-	float px = p->x - dx*d;
-	float py = p->y - dy*d;
+	float px = pts->x[ip] - dx*d;
+	float py = pts->y[ip] - dy*d;
 	float dlx = dy;
 	float dly = -dx;
 	nvg__vset(dst, px + dlx*w - dx*aa, py + dly*w - dy*aa, u0,0); dst++;
@@ -1588,12 +2604,12 @@ static NVGvertex* nvg__buttCapStart(NVGvertex* dst, NVGpoint* p,
 	return dst;
 }
 
-static NVGvertex* nvg__buttCapEnd(NVGvertex* dst, NVGpoint* p,
+static NVGvertex* nvg__buttCapEnd(NVGvertex* dst, const NVGpoints* pts, int ip,
 								  float dx, float dy, float w, float d,
 								  float aa, float u0, float u1)
 {
-	float px = p->x + dx*d;
-	float py = p->y + dy*d;
+	float px = pts->x[ip] + dx*d;
+	float py = pts->y[ip] + dy*d;
 	float dlx = dy;
 	float dly = -dx;
 	nvg__vset(dst, px + dlx*w, py + dly*w, u0,1); dst++;
@@ -1604,13 +2620,13 @@ static NVGvertex* nvg__buttCapEnd(NVGvertex* dst, NVGpoint* p,
 }
 
 
-static NVGvertex* nvg__roundCapStart(NVGvertex* dst, NVGpoint* p,
+static NVGvertex* nvg__roundCapStart(NVGvertex* dst, const NVGpoints* pts, int ip,
 									 float dx, float dy, float w, int ncap,
 									 float aa, float u0, float u1)
 {
 	int i;
-	float px = p->x;
-	float py = p->y;
+	float px = pts->x[ip];
+	float py = pts->y[ip];
 	float dlx = dy;
 	float dly = -dx;
 	NVG_NOTUSED(aa);
@@ -1625,13 +2641,13 @@ static NVGvertex* nvg__roundCapStart(NVGvertex* dst, NVGpoint* p,
 	return dst;
 }
 
-static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, NVGpoint* p,
+static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, const NVGpoints* pts, int ip,
 								   float dx, float dy, float w, int ncap,
 								   float aa, float u0, float u1)
 {
 	int i;
-	float px = p->x;
-	float py = p->y;
+	float px = pts->x[ip];
+	float py = pts->y[ip];
 	float dlx = dy;
 	float dly = -dx;
 	NVG_NOTUSED(aa);
@@ -1647,82 +2663,222 @@ static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, NVGpoint* p,
 }
 
 
+// Calculates the extrusion and join flags at point i1, where the segment starting at point i0 ends.
+static int nvg__joinPoint(NVGpoints* pts, int i0, int i1, float iw, int bevelJoins, float miterLimit)
+{
+	float dlx0 = pts->dy[i0];
+	float dly0 = -pts->dx[i0];
+	float dlx1 = pts->dy[i1];
+	float dly1 = -pts->dx[i1];
+	float dmx, dmy, dmr2, cross, limit;
+	int flags;
+
+	// Calculate extrusions
+	dmx = (dlx0 + dlx1) * 0.5f;
+	dmy = (dly0 + dly1) * 0.5f;
+	dmr2 = dmx*dmx + dmy*dmy;
+	if (dmr2 > 0.000001f) {
+		float scale = 1.0f / dmr2;
+		if (scale > 600.0f) {
+			scale = 600.0f;
+		}
+		dmx *= scale;
+		dmy *= scale;
+	}
+	pts->dmx[i1] = dmx;
+	pts->dmy[i1] = dmy;
+
+	// Clear flags, but keep the corner.
+	flags = pts->flags[i1] & NVG_PT_CORNER;
+
+	// Keep track of left turns.
+	cross = pts->dx[i1] * pts->dy[i0] - pts->dx[i0] * pts->dy[i1];
+	if (cross > 0.0f)
+		flags |= NVG_PT_LEFT;
+
+	// Calculate if we should use bevel or miter for inner join.
+	limit = nvg__maxf(1.01f, nvg__minf(pts->len[i0], pts->len[i1]) * iw);
+	if ((dmr2 * limit*limit) < 1.0f)
+		flags |= NVG_PR_INNERBEVEL;
+
+	// Check to see if the corner needs to be beveled.
+	if (flags & NVG_PT_CORNER) {
+		if ((dmr2 * miterLimit*miterLimit) < 1.0f || bevelJoins)
+			flags |= NVG_PT_BEVEL;
+	}
+
+	pts->flags[i1] = (unsigned char)flags;
+	return flags;
+}
+
 static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float miterLimit)
 {
 	NVGpathCache* cache = ctx->cache;
-	int i, j;
+	int i, j, flags;
+	int bevelJoins = lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND;
 	float iw = 0.0f;
+#if defined(NVG_SIMD_NEON)
+	float32x4_t half = vdupq_n_f32(0.5f), one = vdupq_n_f32(1.0f), eps = vdupq_n_f32(0.000001f);
+	float32x4_t maxScale = vdupq_n_f32(600.0f), minLimit = vdupq_n_f32(1.01f), vml = vdupq_n_f32(miterLimit);
+	uint32x4_t vbevelJoins = vdupq_n_u32(bevelJoins ? 0xffffffff : 0);
+	uint32x4_t corner = vdupq_n_u32(NVG_PT_CORNER), left = vdupq_n_u32(NVG_PT_LEFT);
+	uint32x4_t bevel = vdupq_n_u32(NVG_PT_BEVEL), innerBevel = vdupq_n_u32(NVG_PR_INNERBEVEL);
+#elif defined(NVG_SIMD_SSE2)
+	__m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f), eps = _mm_set1_ps(0.000001f), sign = _mm_set1_ps(-0.0f);
+	__m128 maxScale = _mm_set1_ps(600.0f), minLimit = _mm_set1_ps(1.01f), vml = _mm_set1_ps(miterLimit);
+	__m128 vbevelJoins = _mm_castsi128_ps(_mm_set1_epi32(bevelJoins ? -1 : 0));
+	__m128i corner = _mm_set1_epi32(NVG_PT_CORNER), left = _mm_set1_epi32(NVG_PT_LEFT);
+	__m128i bevel = _mm_set1_epi32(NVG_PT_BEVEL), innerBevel = _mm_set1_epi32(NVG_PR_INNERBEVEL);
+#endif
 
 	if (w > 0.0f) iw = 1.0f / w;
 
 	// Calculate which joins needs extra vertices to append, and gather vertex count.
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
-		NVGpoint* pts = &cache->points[path->first];
-		NVGpoint* p0 = &pts[path->count-1];
-		NVGpoint* p1 = &pts[0];
+		NVGpoints pts = nvg__pathPoints(cache, path->first);
 		int nleft = 0;
 
 		path->nbevel = 0;
 
 		for (j = 0; j < path->count; j++) {
-			float dlx0, dly0, dlx1, dly1, dmr2, cross, limit;
-			dlx0 = p0->dy;
-			dly0 = -p0->dx;
-			dlx1 = p1->dy;
-			dly1 = -p1->dx;
-			// Calculate extrusions
-			p1->dmx = (dlx0 + dlx1) * 0.5f;
-			p1->dmy = (dly0 + dly1) * 0.5f;
-			dmr2 = p1->dmx*p1->dmx + p1->dmy*p1->dmy;
-			if (dmr2 > 0.000001f) {
-				float scale = 1.0f / dmr2;
-				if (scale > 600.0f) {
-					scale = 600.0f;
-				}
-				p1->dmx *= scale;
-				p1->dmy *= scale;
+#if defined(NVG_SIMD_NEON)
+			// Join four points at a time, their segments start at the previous points.
+			if (j > 0 && j+4 <= path->count) {
+				float32x4_t dx0 = vld1q_f32(&pts.dx[j-1]), dy0 = vld1q_f32(&pts.dy[j-1]);
+				float32x4_t dx1 = vld1q_f32(&pts.dx[j]), dy1 = vld1q_f32(&pts.dy[j]);
+				float32x4_t dmx = vmulq_f32(vaddq_f32(dy0, dy1), half);
+				float32x4_t dmy = vmulq_f32(vaddq_f32(vnegq_f32(dx0), vnegq_f32(dx1)), half);
+				float32x4_t dmr2 = vaddq_f32(vmulq_f32(dmx, dmx), vmulq_f32(dmy, dmy));
+				float32x4_t scale = vbslq_f32(vcgtq_f32(dmr2, eps), vminq_f32(vdivq_f32(one, dmr2), maxScale), one);
+				float32x4_t cross = vsubq_f32(vmulq_f32(dx1, dy0), vmulq_f32(dx0, dy1));
+				float32x4_t limit = vmaxq_f32(minLimit, vmulq_f32(vminq_f32(vld1q_f32(&pts.len[j-1]), vld1q_f32(&pts.len[j])), vdupq_n_f32(iw)));
+				uint32x4_t isLeft = vcgtq_f32(cross, vdupq_n_f32(0.0f));
+				uint32x4_t isInner = vcltq_f32(vmulq_f32(vmulq_f32(dmr2, limit), limit), one);
+				uint32x4_t isBevel = vorrq_u32(vcltq_f32(vmulq_f32(vmulq_f32(dmr2, vml), vml), one), vbevelJoins);
+				uint32_t packed;
+				uint32x4_t f;
+				uint16x4_t f16;
+				memcpy(&packed, &pts.flags[j], 4);
+				f = vandq_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed))))), corner);
+				isBevel = vandq_u32(isBevel, vceqq_u32(f, corner));
+				f = vorrq_u32(f, vandq_u32(isLeft, left));
+				f = vorrq_u32(f, vandq_u32(isInner, innerBevel));
+				f = vorrq_u32(f, vandq_u32(isBevel, bevel));
+				f16 = vmovn_u32(f);
+				packed = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(f16, f16))), 0);
+				memcpy(&pts.flags[j], &packed, 4);
+				vst1q_f32(&pts.dmx[j], vmulq_f32(dmx, scale));
+				vst1q_f32(&pts.dmy[j], vmulq_f32(dmy, scale));
+				nleft += vaddvq_u32(vshrq_n_u32(isLeft, 31));
+				path->nbevel += vaddvq_u32(vshrq_n_u32(vorrq_u32(isInner, isBevel), 31));
+				j += 3;
+				continue;
 			}
+#elif defined(NVG_SIMD_SSE2)
+			// Join four points at a time, their segments start at the previous points.
+			if (j > 0 && j+4 <= path->count) {
+				__m128 dx0 = _mm_loadu_ps(&pts.dx[j-1]), dy0 = _mm_loadu_ps(&pts.dy[j-1]);
+				__m128 dx1 = _mm_loadu_ps(&pts.dx[j]), dy1 = _mm_loadu_ps(&pts.dy[j]);
+				__m128 dmx = _mm_mul_ps(_mm_add_ps(dy0, dy1), half);
+				__m128 dmy = _mm_mul_ps(_mm_add_ps(_mm_xor_ps(dx0, sign), _mm_xor_ps(dx1, sign)), half);
+				__m128 dmr2 = _mm_add_ps(_mm_mul_ps(dmx, dmx), _mm_mul_ps(dmy, dmy));
+				__m128 isScaled = _mm_cmpgt_ps(dmr2, eps);
+				__m128 scale = _mm_or_ps(_mm_and_ps(isScaled, _mm_min_ps(_mm_div_ps(one, dmr2), maxScale)), _mm_andnot_ps(isScaled, one));
+				__m128 cross = _mm_sub_ps(_mm_mul_ps(dx1, dy0), _mm_mul_ps(dx0, dy1));
+				__m128 limit = _mm_max_ps(minLimit, _mm_mul_ps(_mm_min_ps(_mm_loadu_ps(&pts.len[j-1]), _mm_loadu_ps(&pts.len[j])), _mm_set1_ps(iw)));
+				__m128 isLeft = _mm_cmpgt_ps(cross, _mm_setzero_ps());
+				__m128 isInner = _mm_cmplt_ps(_mm_mul_ps(_mm_mul_ps(dmr2, limit), limit), one);
+				__m128 isBevel = _mm_or_ps(_mm_cmplt_ps(_mm_mul_ps(_mm_mul_ps(dmr2, vml), vml), one), vbevelJoins);
+				int packed;
+				__m128i f;
+				memcpy(&packed, &pts.flags[j], 4);
+				f = _mm_cvtsi32_si128(packed);
+				f = _mm_unpacklo_epi16(_mm_unpacklo_epi8(f, _mm_setzero_si128()), _mm_setzero_si128());
+				f = _mm_and_si128(f, corner);
+				isBevel = _mm_and_ps(isBevel, _mm_castsi128_ps(_mm_cmpeq_epi32(f, corner)));
+				f = _mm_or_si128(f, _mm_and_si128(_mm_castps_si128(isLeft), left));
+				f = _mm_or_si128(f, _mm_and_si128(_mm_castps_si128(isInner), innerBevel));
+				f = _mm_or_si128(f, _mm_and_si128(_mm_castps_si128(isBevel), bevel));
+				f = _mm_packs_epi32(f, f);
+				packed = _mm_cvtsi128_si32(_mm_packus_epi16(f, f));
+				memcpy(&pts.flags[j], &packed, 4);
+				_mm_storeu_ps(&pts.dmx[j], _mm_mul_ps(dmx, scale));
+				_mm_storeu_ps(&pts.dmy[j], _mm_mul_ps(dmy, scale));
+				nleft += nvg__bitCount4(_mm_movemask_ps(isLeft));
+				path->nbevel += nvg__bitCount4(_mm_movemask_ps(_mm_or_ps(isInner, isBevel)));
+				j += 3;
+				continue;
+			}
+#endif
+			flags = nvg__joinPoint(&pts, j > 0 ? j-1 : path->count-1, j, iw, bevelJoins, miterLimit);
+			if (flags & NVG_PT_LEFT)
+				nleft++;
+			if ((flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0)
+				path->nbevel++;
+		}
 
-			// Clear flags, but keep the corner.
-			p1->flags = (p1->flags & NVG_PT_CORNER) ? NVG_PT_CORNER : 0;
+		path->convex = (nleft == path->count) ? 1 : 0;
+	}
+}
 
-			// Keep track of left turns.
-			cross = p1->dx * p0->dy - p0->dx * p1->dy;
-			if (cross > 0.0f) {
-				nleft++;
-				p1->flags |= NVG_PT_LEFT;
-			}
+// Returns the tangent of half the turn angle at point i1, or -1 for turns sharper than 90 degrees.
+static float nvg__halfTurnTan(const NVGpoints* pts, int i0, int i1)
+{
+	float cross = pts->dx[i1] * pts->dy[i0] - pts->dx[i0] * pts->dy[i1];
+	float dot = pts->dx[i0] * pts->dx[i1] + pts->dy[i0] * pts->dy[i1];
+	if (dot < -0.0001f) return -1.0f;
+	return nvg__absf(cross) / (1.0f + dot);
+}
 
-			// Calculate if we should use bevel or miter for inner join.
-			limit = nvg__maxf(1.01f, nvg__minf(p0->len, p1->len) * iw);
-			if ((dmr2 * limit*limit) < 1.0f)
-				p1->flags |= NVG_PR_INNERBEVEL;
+// Returns true if the stroke of the path cannot overlap itself, i.e. each pixel is covered at most once.
+// Accepts closed convex outlines and gently bending open lines, whose segments are long enough
+// for the inner joins to not fold over.
+static int nvg__strokeNoOverlap(NVGpath* path, const NVGpoints* pts, float w, float fringe)
+{
+	float t0, t1, turn = 0.0f;
+	int j, nseg, nleft = 0, nright = 0;
 
-			// Check to see if the corner needs to be beveled.
-			if (p1->flags & NVG_PT_CORNER) {
-				if ((dmr2 * miterLimit*miterLimit) < 1.0f || lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND) {
-					p1->flags |= NVG_PT_BEVEL;
-				}
-			}
+	if (path->count < 2)
+		return 1;
 
-			if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0)
-				path->nbevel++;
+	nseg = path->closed ? path->count : path->count-1;
+	t1 = path->closed ? nvg__halfTurnTan(pts, path->count-1, 0) : 0.0f;
+	if (t1 < 0.0f)
+		return 0;
 
-			p0 = p1++;
+	for (j = 0; j < nseg; j++) {
+		int i0 = j;
+		int i1 = (j+1) % path->count;
+		t0 = t1;
+		t1 = 0.0f;
+		if (path->closed || j+1 < path->count-1) {
+			float cross = pts->dx[i1] * pts->dy[i0] - pts->dx[i0] * pts->dy[i1];
+			if ((pts->flags[i1] & NVG_PR_INNERBEVEL) != 0)
+				return 0;
+			t1 = nvg__halfTurnTan(pts, i0, i1);
+			if (t1 < 0.0f)
+				return 0;
+			if (cross > 0.0001f) nleft++;
+			if (cross < -0.0001f) nright++;
+			turn += nvg__atan2f(nvg__absf(cross), pts->dx[i0] * pts->dx[i1] + pts->dy[i0] * pts->dy[i1]);
 		}
-
-		path->convex = (nleft == path->count) ? 1 : 0;
+		// The inner joins at both ends eat w*tan(a/2) of the segment.
+		if (pts->len[i0] < w * (t0 + t1) + fringe)
+			return 0;
 	}
-}
 
+	if (path->closed)
+		return (nleft == 0 || nright == 0) && turn < NVG_PI*2 + 0.1f;
+	return turn < NVG_PI*0.5f + 0.01f;
+}
 
 static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap, int lineJoin, float miterLimit)
 {
 	NVGpathCache* cache = ctx->cache;
 	NVGvertex* verts;
 	NVGvertex* dst;
-	int cverts, i, j;
+	int cverts, nooverlap, i, j;
 	float aa = fringe;//ctx->fringeWidth;
 	float u0 = 0.0f, u1 = 1.0f;
 	int ncap = nvg__curveDivs(w, NVG_PI, ctx->tessTol);	// Calculate divisions per half circle.
@@ -1737,6 +2893,16 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 
 	nvg__calculateJoins(ctx, w, lineJoin, miterLimit);
 
+	// Let the renderer know if the stroke can be drawn without stenciling.
+	nooverlap = !nvg__pathBoundsOverlap(cache, w * nvg__maxf(miterLimit, 1.5f) + aa);
+	for (i = 0; i < cache->npaths && nooverlap; i++) {
+		NVGpath* path = &cache->paths[i];
+		NVGpoints pts = nvg__pathPoints(cache, path->first);
+		nooverlap = nvg__strokeNoOverlap(path, &pts, w, aa);
+	}
+	for (i = 0; i < cache->npaths; i++)
+		cache->paths[i].nooverlap = nooverlap;
+
 	// Calculate max vertex usage.
 	cverts = 0;
 	for (i = 0; i < cache->npaths; i++) {
@@ -1761,9 +2927,8 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
-		NVGpoint* pts = &cache->points[path->first];
-		NVGpoint* p0;
-		NVGpoint* p1;
+		NVGpoints pts = nvg__pathPoints(cache, path->first);
+		int i0, i1;
 		int s, e, loop;
 		float dx, dy;
 
@@ -1777,43 +2942,43 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 
 		if (loop) {
 			// Looping
-			p0 = &pts[path->count-1];
-			p1 = &pts[0];
+			i0 = path->count-1;
+			i1 = 0;
 			s = 0;
 			e = path->count;
 		} else {
 			// Add cap
-			p0 = &pts[0];
-			p1 = &pts[1];
+			i0 = 0;
+			i1 = 1;
 			s = 1;
 			e = path->count-1;
 		}
 
 		if (loop == 0) {
 			// Add cap
-			dx = p1->x - p0->x;
-			dy = p1->y - p0->y;
+			dx = pts.x[i1] - pts.x[i0];
+			dy = pts.y[i1] - pts.y[i0];
 			nvg__normalize(&dx, &dy);
 			if (lineCap == NVG_BUTT)
-				dst = nvg__buttCapStart(dst, p0, dx, dy, w, -aa*0.5f, aa, u0, u1);
+				dst = nvg__buttCapStart(dst, &pts, i0, dx, dy, w, -aa*0.5f, aa, u0, u1);
 			else if (lineCap == NVG_BUTT || lineCap == NVG_SQUARE)
-				dst = nvg__buttCapStart(dst, p0, dx, dy, w, w-aa, aa, u0, u1);
+				dst = nvg__buttCapStart(dst, &pts, i0, dx, dy, w, w-aa, aa, u0, u1);
 			else if (lineCap == NVG_ROUND)
-				dst = nvg__roundCapStart(dst, p0, dx, dy, w, ncap, aa, u0, u1);
+				dst = nvg__roundCapStart(dst, &pts, i0, dx, dy, w, ncap, aa, u0, u1);
 		}
 
 		for (j = s; j < e; ++j) {
-			if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
+			if ((pts.flags[i1] & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
 				if (lineJoin == NVG_ROUND) {
-					dst = nvg__roundJoin(dst, p0, p1, w, w, u0, u1, ncap, aa);
+					dst = nvg__roundJoin(dst, &pts, i0, i1, w, w, u0, u1, ncap, aa);
 				} else {
-					dst = nvg__bevelJoin(dst, p0, p1, w, w, u0, u1, aa);
+					dst = nvg__bevelJoin(dst, &pts, i0, i1, w, w, u0, u1, aa);
 				}
 			} else {
-				nvg__vset(dst, p1->x + (p1->dmx * w), p1->y + (p1->dmy * w), u0,1); dst++;
-				nvg__vset(dst, p1->x - (p1->dmx * w), p1->y - (p1->dmy * w), u1,1); dst++;
+				nvg__vset(dst, pts.x[i1] + (pts.dmx[i1] * w), pts.y[i1] + (pts.dmy[i1] * w), u0,1); dst++;
+				nvg__vset(dst, pts.x[i1] - (pts.dmx[i1] * w), pts.y[i1] - (pts.dmy[i1] * w), u1,1); dst++;
 			}
-			p0 = p1++;
+			i0 = i1++;
 		}
 
 		if (loop) {
@@ -1822,15 +2987,95 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 			nvg__vset(dst, verts[1].x, verts[1].y, u1,1); dst++;
 		} else {
 			// Add cap
-			dx = p1->x - p0->x;
-			dy = p1->y - p0->y;
+			dx = pts.x[i1] - pts.x[i0];
+			dy = pts.y[i1] - pts.y[i0];
 			nvg__normalize(&dx, &dy);
 			if (lineCap == NVG_BUTT)
-				dst = nvg__buttCapEnd(dst, p1, dx, dy, w, -aa*0.5f, aa, u0, u1);
+				dst = nvg__buttCapEnd(dst, &pts, i1, dx, dy, w, -aa*0.5f, aa, u0, u1);
 			else if (lineCap == NVG_BUTT || lineCap == NVG_SQUARE)
-				dst = nvg__buttCapEnd(dst, p1, dx, dy, w, w-aa, aa, u0, u1);
+				dst = nvg__buttCapEnd(dst, &pts, i1, dx, dy, w, w-aa, aa, u0, u1);
 			else if (lineCap == NVG_ROUND)
-				dst = nvg__roundCapEnd(dst, p1, dx, dy, w, ncap, aa, u0, u1);
+				dst = nvg__roundCapEnd(dst, &pts, i1, dx, dy, w, ncap, aa, u0, u1);
+		}
+
+		path->nstroke = (int)(dst - verts);
+
+		verts = dst;
+	}
+
+	return 1;
+}
+
+// Expands strokes which are at most one pixel wide. The joins are not calculated, the strip
+// shares one pair of mitered vertices at each point, so neighbouring segments do not overlap.
+// Miters are shortened to the miter limit, round caps and joins are drawn square at this size.
+static int nvg__expandHairline(NVGcontext* ctx, float w, float aa, int lineCap, float miterLimit)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGvertex* verts;
+	NVGvertex* dst;
+	int cverts, i, j;
+	float limit = nvg__maxf(miterLimit, 1.0f);
+
+	w += aa * 0.5f;
+
+	// Calculate max vertex usage.
+	cverts = 0;
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		cverts += (path->count + 1)*2 + 8; // plus one for loop, and caps
+	}
+
+	verts = nvg__allocTempVerts(ctx, cverts);
+	if (verts == NULL) return 0;
+
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		NVGpoints pts = nvg__pathPoints(cache, path->first);
+		int loop = (path->closed == 0) ? 0 : 1;
+		int nseg = loop ? path->count : path->count-1;
+		float d = lineCap == NVG_BUTT ? -aa*0.5f : w-aa;
+
+		path->fill = 0;
+		path->nfill = 0;
+		path->nooverlap = 0;
+
+		dst = verts;
+		path->stroke = dst;
+
+		if (nseg > 0) {
+			if (loop == 0)
+				dst = nvg__buttCapStart(dst, &pts, 0, pts.dx[0], pts.dy[0], w, d, aa, 0.0f, 1.0f);
+
+			for (j = loop ? 0 : 1; j < path->count - (loop ? 0 : 1); j++) {
+				int i0 = j > 0 ? j-1 : path->count-1;
+				float dmx = (pts.dy[i0] + pts.dy[j]) * 0.5f;
+				float dmy = (-pts.dx[i0] - pts.dx[j]) * 0.5f;
+				float dmr2 = dmx*dmx + dmy*dmy;
+				// Scale the average normal to the miter, which is 1/sqrt(dmr2) long.
+				if (dmr2 * limit*limit >= 1.0f) {
+					dmx /= dmr2;
+					dmy /= dmr2;
+				} else if (dmr2 > 0.000001f) {
+					float scale = limit / nvg__sqrtf(dmr2);
+					dmx *= scale;
+					dmy *= scale;
+				} else {
+					dmx = pts.dy[j];
+					dmy = -pts.dx[j];
+				}
+				nvg__vset(dst, pts.x[j] + dmx * w, pts.y[j] + dmy * w, 0.0f,1); dst++;
+				nvg__vset(dst, pts.x[j] - dmx * w, pts.y[j] - dmy * w, 1.0f,1); dst++;
+			}
+
+			if (loop) {
+				// Loop it
+				nvg__vset(dst, verts[0].x, verts[0].y, 0.0f,1); dst++;
+				nvg__vset(dst, verts[1].x, verts[1].y, 1.0f,1); dst++;
+			} else {
+				int i0 = path->count-2;
+				dst = nvg__buttCapEnd(dst, &pts, path->count-1, pts.dx[i0], pts.dy[i0], w, d, aa, 0.0f, 1.0f);
+			}
 		}
 
 		path->nstroke = (int)(dst - verts);
@@ -1864,13 +3109,27 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 	verts = nvg__allocTempVerts(ctx, cverts);
 	if (verts == NULL) return 0;
 
-	convex = cache->npaths == 1 && cache->paths[0].convex;
+	// Convex paths which do not overlap each other (including their fringes)
+	// can be drawn path by path without stenciling.
+	convex = 1;
+	for (i = 0; i < cache->npaths; i++) {
+		if (!cache->paths[i].convex) {
+			convex = 0;
+			break;
+		}
+	}
+	if (convex && nvg__pathBoundsOverlap(cache, aa))
+		convex = 0;
+	if (!convex) {
+		// Let the renderer know that the paths need to be stenciled.
+		for (i = 0; i < cache->npaths; i++)
+			cache->paths[i].convex = 0;
+	}
 
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
-		NVGpoint* pts = &cache->points[path->first];
-		NVGpoint* p0;
-		NVGpoint* p1;
+		NVGpoints pts = nvg__pathPoints(cache, path->first);
+		int i0, i1;
 		float rw, lw, woff;
 		float ru, lu;
 
@@ -1881,34 +3140,34 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 
 		if (fringe) {
 			// Looping
-			p0 = &pts[path->count-1];
-			p1 = &pts[0];
+			i0 = path->count-1;
+			i1 = 0;
 			for (j = 0; j < path->count; ++j) {
-				if (p1->flags & NVG_PT_BEVEL) {
-					float dlx0 = p0->dy;
-					float dly0 = -p0->dx;
-					float dlx1 = p1->dy;
-					float dly1 = -p1->dx;
-					if (p1->flags & NVG_PT_LEFT) {
-						float lx = p1->x + p1->dmx * woff;
-						float ly = p1->y + p1->dmy * woff;
+				if (pts.flags[i1] & NVG_PT_BEVEL) {
+					float dlx0 = pts.dy[i0];
+					float dly0 = -pts.dx[i0];
+					float dlx1 = pts.dy[i1];
+					float dly1 = -pts.dx[i1];
+					if (pts.flags[i1] & NVG_PT_LEFT) {
+						float lx = pts.x[i1] + pts.dmx[i1] * woff;
+						float ly = pts.y[i1] + pts.dmy[i1] * woff;
 						nvg__vset(dst, lx, ly, 0.5f,1); dst++;
 					} else {
-						float lx0 = p1->x + dlx0 * woff;
-						float ly0 = p1->y + dly0 * woff;
-						float lx1 = p1->x + dlx1 * woff;
-						float ly1 = p1->y + dly1 * woff;
+						float lx0 = pts.x[i1] + dlx0 * woff;
+						float ly0 = pts.y[i1] + dly0 * woff;
+						float lx1 = pts.x[i1] + dlx1 * woff;
+						float ly1 = pts.y[i1] + dly1 * woff;
 						nvg__vset(dst, lx0, ly0, 0.5f,1); dst++;
 						nvg__vset(dst, lx1, ly1, 0.5f,1); dst++;
 					}
 				} else {
-					nvg__vset(dst, p1->x + (p1->dmx * woff), p1->y + (p1->dmy * woff), 0.5f,1); dst++;
+					nvg__vset(dst, pts.x[i1] + (pts.dmx[i1] * woff), pts.y[i1] + (pts.dmy[i1] * woff), 0.5f,1); dst++;
 				}
-				p0 = p1++;
+				i0 = i1++;
 			}
 		} else {
 			for (j = 0; j < path->count; ++j) {
-				nvg__vset(dst, pts[j].x, pts[j].y, 0.5f,1);
+				nvg__vset(dst, pts.x[j], pts.y[j], 0.5f,1);
 				dst++;
 			}
 		}
@@ -1933,17 +3192,17 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 			}
 
 			// Looping
-			p0 = &pts[path->count-1];
-			p1 = &pts[0];
+			i0 = path->count-1;
+			i1 = 0;
 
 			for (j = 0; j < path->count; ++j) {
-				if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
-					dst = nvg__bevelJoin(dst, p0, p1, lw, rw, lu, ru, ctx->fringeWidth);
+				if ((pts.flags[i1] & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
+					dst = nvg__bevelJoin(dst, &pts, i0, i1, lw, rw, lu, ru, ctx->fringeWidth);
 				} else {
-					nvg__vset(dst, p1->x + (p1->dmx * lw), p1->y + (p1->dmy * lw), lu,1); dst++;
-					nvg__vset(dst, p1->x - (p1->dmx * rw), p1->y - (p1->dmy * rw), ru,1); dst++;
+					nvg__vset(dst, pts.x[i1] + (pts.dmx[i1] * lw), pts.y[i1] + (pts.dmy[i1] * lw), lu,1); dst++;
+					nvg__vset(dst, pts.x[i1] - (pts.dmx[i1] * rw), pts.y[i1] - (pts.dmy[i1] * rw), ru,1); dst++;
 				}
-				p0 = p1++;
+				i0 = i1++;
 			}
 
 			// Loop it
@@ -1965,6 +3224,7 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 // Draw
 void nvgBeginPath(NVGcontext* ctx)
 {
+	ctx->peakCommands = nvg__maxi(ctx->peakCommands, ctx->ncommands);
 	ctx->ncommands = 0;
 	nvg__clearPathCache(ctx);
 }
@@ -2216,124 +3476,1153 @@ void nvgDebugDumpPathCache(NVGcontext* ctx)
 	}
 }
 
-void nvgFill(NVGcontext* ctx)
+// Copies the expanded paths, transforming the vertices by xform.
+static int nvg__saveTessellation(NVGtessellation* tess, const NVGpath* paths, int npaths, const float* xform)
 {
-	NVGstate* state = nvg__getState(ctx);
-	const NVGpath* path;
-	NVGpaint fillPaint = state->fill;
-	int i;
-
-	nvg__flattenPaths(ctx);
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
-	else
-		nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+	NVGvertex* dst;
+	int i, nverts = 0;
+
+	for (i = 0; i < npaths; i++)
+		nverts += paths[i].nfill + paths[i].nstroke;
+
+	tess->paths = (NVGpath*)malloc(sizeof(NVGpath)*nvg__maxi(npaths, 1));
+	if (tess->paths == NULL) goto error;
+	tess->verts = (NVGvertex*)malloc(sizeof(NVGvertex)*nvg__maxi(nverts, 1));
+	if (tess->verts == NULL) goto error;
+	tess->npaths = npaths;
+	tess->nverts = nverts;
+
+	dst = tess->verts;
+	for (i = 0; i < npaths; i++) {
+		NVGpath* path = &tess->paths[i];
+		*path = paths[i];
+		if (path->nfill > 0) {
+			nvg__transformVerts(dst, path->fill, path->nfill, xform);
+			path->fill = dst;
+			dst += path->nfill;
+		}
+		if (path->nstroke > 0) {
+			nvg__transformVerts(dst, path->stroke, path->nstroke, xform);
+			path->stroke = dst;
+			dst += path->nstroke;
+		}
+	}
 
-	// Apply global alpha
-	fillPaint.innerColor.a *= state->alpha;
-	fillPaint.outerColor.a *= state->alpha;
+	tess->bounds[0] = tess->bounds[1] = 1e6f;
+	tess->bounds[2] = tess->bounds[3] = -1e6f;
+	for (i = 0, dst = tess->verts; i < nverts; i++, dst++) {
+		tess->bounds[0] = nvg__minf(tess->bounds[0], dst->x);
+		tess->bounds[1] = nvg__minf(tess->bounds[1], dst->y);
+		tess->bounds[2] = nvg__maxf(tess->bounds[2], dst->x);
+		tess->bounds[3] = nvg__maxf(tess->bounds[3], dst->y);
+	}
 
-	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
-						   ctx->cache->bounds, ctx->cache->paths, ctx->cache->npaths);
+	return 1;
 
-	// Count triangles
-	for (i = 0; i < ctx->cache->npaths; i++) {
-		path = &ctx->cache->paths[i];
-		ctx->fillTriCount += path->nfill-2;
-		ctx->fillTriCount += path->nstroke-2;
-		ctx->drawCallCount += 2;
-	}
+error:
+	nvg__deleteTessellation(tess);
+	return 0;
 }
 
-void nvgStroke(NVGcontext* ctx)
+// Transforms the saved paths by xform into the temp vertices and the given path array,
+// and calculates the bounds of the result.
+static int nvg__restoreTessellation(NVGcontext* ctx, NVGtessellation* tess, NVGpath* paths, const float* xform, float* bounds)
 {
-	NVGstate* state = nvg__getState(ctx);
-	float scale = nvg__getAverageScale(state->xform);
-	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
-	NVGpaint strokePaint = state->stroke;
-	const NVGpath* path;
+	NVGvertex* verts;
+	NVGvertex* dst;
 	int i;
 
+	verts = nvg__allocTempVerts(ctx, tess->nverts);
+	if (verts == NULL) return 0;
 
-	if (strokeWidth < ctx->fringeWidth) {
-		// If the stroke width is less than pixel size, use alpha to emulate coverage.
-		// Since coverage is area, scale by alpha*alpha.
-		float alpha = nvg__clampf(strokeWidth / ctx->fringeWidth, 0.0f, 1.0f);
-		strokePaint.innerColor.a *= alpha*alpha;
-		strokePaint.outerColor.a *= alpha*alpha;
-		strokeWidth = ctx->fringeWidth;
-	}
-
-	// Apply global alpha
-	strokePaint.innerColor.a *= state->alpha;
-	strokePaint.outerColor.a *= state->alpha;
-
-	nvg__flattenPaths(ctx);
-
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
-	else
-		nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
-
-	ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
-							 strokeWidth, ctx->cache->paths, ctx->cache->npaths);
+	nvg__transformVerts(verts, tess->verts, tess->nverts, xform);
 
-	// Count triangles
-	for (i = 0; i < ctx->cache->npaths; i++) {
-		path = &ctx->cache->paths[i];
-		ctx->strokeTriCount += path->nstroke-2;
-		ctx->drawCallCount++;
+	bounds[0] = bounds[1] = 1e6f;
+	bounds[2] = bounds[3] = -1e6f;
+	for (i = 0, dst = verts; i < tess->nverts; i++, dst++) {
+		bounds[0] = nvg__minf(bounds[0], dst->x);
+		bounds[1] = nvg__minf(bounds[1], dst->y);
+		bounds[2] = nvg__maxf(bounds[2], dst->x);
+		bounds[3] = nvg__maxf(bounds[3], dst->y);
 	}
-}
 
-// Add fonts
-int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename)
-{
-	return fonsAddFont(ctx->fs, name, filename, 0);
-}
-
-int nvgCreateFontAtIndex(NVGcontext* ctx, const char* name, const char* filename, const int fontIndex)
-{
-	return fonsAddFont(ctx->fs, name, filename, fontIndex);
-}
+	for (i = 0; i < tess->npaths; i++) {
+		paths[i] = tess->paths[i];
+		if (paths[i].nfill > 0)
+			paths[i].fill = verts + (tess->paths[i].fill - tess->verts);
+		if (paths[i].nstroke > 0)
+			paths[i].stroke = verts + (tess->paths[i].stroke - tess->verts);
+	}
 
-int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData)
-{
-	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, 0);
+	return 1;
 }
 
-int nvgCreateFontMemAtIndex(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData, const int fontIndex)
+// Tessellation cache
+static int nvg__floatBits(float f)
 {
-	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, fontIndex);
+	union { float f; int i; } u;
+	u.f = f;
+	return u.i;
 }
 
-int nvgFindFont(NVGcontext* ctx, const char* name)
+static int nvg__quantizeKey(float a)
 {
-	if (name == NULL) return -1;
-	return fonsGetFontByName(ctx->fs, name);
+	return (int)floorf(a * 256.0f + 0.5f);
 }
 
-
-int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
+static NVGtessCacheEntry* nvg__tessCacheLookup(NVGtessCache* tc, const int* key, int nkey, unsigned int hash)
 {
-	if(baseFont == -1 || fallbackFont == -1) return 0;
-	return fonsAddFallbackFont(ctx->fs, baseFont, fallbackFont);
+	NVGtessCacheEntry* entry;
+	for (entry = tc->buckets[hash & (NVG_TESS_CACHE_BUCKETS-1)]; entry != NULL; entry = entry->next) {
+		if (entry->hash == hash && entry->nkey == nkey && memcmp(entry->key, key, sizeof(int)*nkey) == 0)
+			break;
+	}
+	return entry;
 }
 
-int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallbackFont)
+// Builds the cache key of the current path, and returns the matching entry if there is one.
+// The key holds the fill or stroke style, and the path commands relative to the translation
+// of the current transform.
+static NVGtessCacheEntry* nvg__tessCacheFind(NVGcontext* ctx, int stroke)
 {
-	return nvgAddFallbackFontId(ctx, nvgFindFont(ctx, baseFont), nvgFindFont(ctx, fallbackFont));
-}
+	NVGtessCache* tc = ctx->tessCache;
+	NVGstate* state = nvg__getState(ctx);
+	NVGtessCacheEntry* entry;
+	float tx = state->xform[4], ty = state->xform[5];
+	float scale;
+	unsigned int hash = 2166136261u;
+	int* key;
+	int i, j, n, cmd;
+
+	tc->nkey = 0;
+	if (tc->maxSize <= 0 || ctx->ncommands == 0)
+		return NULL;
+
+	n = 16 + NVG_MAX_DASHES + ctx->ncommands;
+	if (n > tc->ckey) {
+		int ckey = n + tc->ckey/2;
+		key = (int*)realloc(tc->key, sizeof(int)*ckey);
+		if (key == NULL) return NULL;
+		tc->key = key;
+		tc->ckey = ckey;
+	}
 
-void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont)
-{
-	fonsResetFallbackFont(ctx->fs, baseFont);
-}
+	key = tc->key;
+	n = 0;
+	key[n++] = stroke;
+	key[n++] = ctx->params.edgeAntiAlias && state->shapeAntiAlias;
+	key[n++] = nvg__floatBits(ctx->tessTol);
+	key[n++] = nvg__floatBits(ctx->distTol);
+	key[n++] = nvg__floatBits(ctx->fringeWidth);
+	if (stroke) {
+		scale = nvg__getAverageScale(state->xform);
+		key[n++] = nvg__floatBits(state->strokeWidth * scale);
+		key[n++] = state->lineCap;
+		key[n++] = state->lineJoin;
+		key[n++] = nvg__floatBits(state->miterLimit);
+		key[n++] = state->ndashes;
+		for (i = 0; i < state->ndashes; i++)
+			key[n++] = nvg__floatBits(state->dashes[i] * scale);
+		key[n++] = nvg__floatBits(state->dashOffset * scale);
+	}
 
-void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont)
-{
-	nvgResetFallbackFontsId(ctx, nvgFindFont(ctx, baseFont));
-}
+	i = 0;
+	while (i < ctx->ncommands) {
+		cmd = (int)ctx->commands[i];
+		key[n++] = cmd;
+		switch (cmd) {
+		case NVG_MOVETO:
+		case NVG_LINETO:
+		case NVG_BEZIERTO:
+			j = cmd == NVG_BEZIERTO ? 3 : 1;
+			for (i++; j > 0; j--, i += 2) {
+				key[n++] = nvg__quantizeKey(ctx->commands[i] - tx);
+				key[n++] = nvg__quantizeKey(ctx->commands[i+1] - ty);
+			}
+			break;
+		case NVG_WINDING:
+			key[n++] = (int)ctx->commands[i+1];
+			i += 2;
+			break;
+		default:
+			i++;
+			break;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		hash ^= (unsigned int)key[i];
+		hash *= 16777619u;
+	}
+	tc->nkey = n;
+	tc->hash = hash;
+
+	entry = nvg__tessCacheLookup(tc, key, n, hash);
+	if (entry == NULL) {
+		ctx->tessCacheMisses++;
+		return NULL;
+	}
+
+	// Move to front of the LRU list.
+	if (entry->lruPrev != NULL) {
+		entry->lruPrev->lruNext = entry->lruNext;
+		if (entry->lruNext != NULL) entry->lruNext->lruPrev = entry->lruPrev;
+		else tc->lruTail = entry->lruPrev;
+		entry->lruPrev = NULL;
+		entry->lruNext = tc->lruHead;
+		tc->lruHead->lruPrev = entry;
+		tc->lruHead = entry;
+	}
+
+	ctx->tessCacheHits++;
+	return entry;
+}
+
+// Transforms the cached paths to the current translation.
+static NVGpath* nvg__tessCacheRestore(NVGcontext* ctx, NVGtessCacheEntry* entry, float* bounds)
+{
+	NVGtessCache* tc = ctx->tessCache;
+	NVGstate* state = nvg__getState(ctx);
+	float xform[6];
+
+	if (entry->tess.npaths > tc->cpaths) {
+		NVGpath* paths = (NVGpath*)realloc(tc->paths, sizeof(NVGpath)*entry->tess.npaths);
+		if (paths == NULL) return NULL;
+		tc->paths = paths;
+		tc->cpaths = entry->tess.npaths;
+	}
+
+	nvgTransformTranslate(xform, state->xform[4], state->xform[5]);
+	if (!nvg__restoreTessellation(ctx, &entry->tess, tc->paths, xform, bounds))
+		return NULL;
+	return tc->paths;
+}
+
+// Adds expanded paths under the given key. tx,ty is the translation the paths were expanded with.
+// Deferred tessellation misses every draw of a path in the frame, only the first one is added.
+static void nvg__tessCacheAdd(NVGtessCache* tc, const int* key, int nkey, unsigned int hash, float tx, float ty,
+							  const NVGpath* paths, int npaths, float strokeWidth, float coverage)
+{
+	NVGtessCacheEntry* entry = NULL;
+	NVGtessCacheEntry** bucket;
+	float xform[6];
+	int i, size;
+
+	if (nkey == 0) return;
+	if (nvg__tessCacheLookup(tc, key, nkey, hash) != NULL) return;
+
+	size = sizeof(NVGtessCacheEntry) + sizeof(int)*nkey + sizeof(NVGpath)*npaths;
+	for (i = 0; i < npaths; i++)
+		size += sizeof(NVGvertex)*(paths[i].nfill + paths[i].nstroke);
+	if (size > tc->maxSize) return;
+	nvg__tessCacheTrim(tc, tc->maxSize - size);
+
+	entry = (NVGtessCacheEntry*)malloc(sizeof(NVGtessCacheEntry));
+	if (entry == NULL) goto error;
+	memset(entry, 0, sizeof(NVGtessCacheEntry));
+
+	entry->key = (int*)malloc(sizeof(int)*nkey);
+	if (entry->key == NULL) goto error;
+	memcpy(entry->key, key, sizeof(int)*nkey);
+	entry->nkey = nkey;
+	entry->hash = hash;
+
+	nvgTransformTranslate(xform, -tx, -ty);
+	if (!nvg__saveTessellation(&entry->tess, paths, npaths, xform)) goto error;
+	entry->strokeWidth = strokeWidth;
+	entry->coverage = coverage;
+	entry->size = size;
+
+	bucket = &tc->buckets[entry->hash & (NVG_TESS_CACHE_BUCKETS-1)];
+	entry->next = *bucket;
+	*bucket = entry;
+	entry->lruNext = tc->lruHead;
+	if (tc->lruHead != NULL) tc->lruHead->lruPrev = entry;
+	else tc->lruTail = entry;
+	tc->lruHead = entry;
+	tc->size += size;
+	return;
+
+error:
+	if (entry != NULL) {
+		if (entry->key != NULL) free(entry->key);
+		free(entry);
+	}
+}
+
+// Adds the expanded paths of the cache under the key built by the last nvg__tessCacheFind().
+static void nvg__tessCacheInsert(NVGcontext* ctx, NVGpathCache* cache, float strokeWidth, float coverage)
+{
+	NVGtessCache* tc = ctx->tessCache;
+	NVGstate* state = nvg__getState(ctx);
+
+	nvg__tessCacheAdd(tc, tc->key, tc->nkey, tc->hash, state->xform[4], state->xform[5],
+					  cache->paths, cache->npaths, strokeWidth, coverage);
+	tc->nkey = 0;
+}
+
+void nvgTessellationCacheSize(NVGcontext* ctx, int bytes)
+{
+	NVGtessCache* tc = ctx->tessCache;
+	tc->maxSize = nvg__maxi(bytes, 0);
+	nvg__tessCacheTrim(tc, tc->maxSize);
+}
+
+void nvgGetFrameStats(NVGcontext* ctx, NVGframeStats* stats)
+{
+	NVGarenaBlock* block;
+	int i;
+	stats->drawCalls = ctx->drawCallCount;
+	stats->fillTriangles = ctx->fillTriCount;
+	stats->strokeTriangles = ctx->strokeTriCount;
+	stats->textTriangles = ctx->textTriCount;
+	stats->tessCacheHits = ctx->tessCacheHits;
+	stats->tessCacheMisses = ctx->tessCacheMisses;
+	stats->tessCacheMemory = ctx->tessCache->size;
+	stats->textCacheHits = ctx->textCacheHits;
+	stats->textCacheMisses = ctx->textCacheMisses;
+	stats->textCacheMemory = ctx->textCache->size;
+	stats->culledPaths = ctx->culledPathCount;
+	stats->culledGlyphs = ctx->culledGlyphCount;
+	stats->deferredPaths = ctx->deferredCount;
+	stats->pendingGlyphs = ctx->pendingGlyphCount;
+	stats->arenaUsed = ctx->arena->frameUsed;
+	stats->arenaSize = 0;
+	for (block = ctx->arena->block; block != NULL; block = block->next)
+		stats->arenaSize += block->size;
+	for (i = 0; i < NVG_MAX_ARENA_FRAMES; i++) {
+		for (block = ctx->arena->frameBlocks[i]; block != NULL; block = block->next)
+			stats->arenaSize += block->size;
+	}
+	stats->arenaAllocs = ctx->arena->frameAllocs;
+}
+
+// Returns true if the bounds, grown by pad, lie completely outside the viewport or the scissor.
+static int nvg__isCulled(NVGcontext* ctx, const float* bounds, float pad)
+{
+	NVGscissor* scissor = &nvg__getState(ctx)->scissor;
+
+	if (bounds[2] + pad < 0.0f || bounds[3] + pad < 0.0f ||
+		bounds[0] - pad > ctx->viewWidth || bounds[1] - pad > ctx->viewHeight)
+		return 1;
+
+	if (scissor->extent[0] >= 0.0f) {
+		// Axis aligned bounds of the transformed scissor rectangle, plus its antialiasing.
+		float ex = nvg__absf(scissor->xform[0])*scissor->extent[0] + nvg__absf(scissor->xform[2])*scissor->extent[1] + 1.0f;
+		float ey = nvg__absf(scissor->xform[1])*scissor->extent[0] + nvg__absf(scissor->xform[3])*scissor->extent[1] + 1.0f;
+		if (bounds[2] + pad < scissor->xform[4] - ex || bounds[3] + pad < scissor->xform[5] - ey ||
+			bounds[0] - pad > scissor->xform[4] + ex || bounds[1] - pad > scissor->xform[5] + ey)
+			return 1;
+	}
+
+	return 0;
+}
+
+// Returns true if the current path can be skipped. The commands are already transformed,
+// and the control points of the beziers bound the curves, so the bounds are conservative.
+static int nvg__isPathCulled(NVGcontext* ctx, float pad)
+{
+	float bounds[4];
+	int i = 0;
+
+	if (ctx->ncommands == 0)
+		return 0;
+
+	bounds[0] = bounds[1] = 1e6f;
+	bounds[2] = bounds[3] = -1e6f;
+	while (i < ctx->ncommands) {
+		int cmd = (int)ctx->commands[i];
+		int j, npts = cmd == NVG_BEZIERTO ? 3 : (cmd == NVG_MOVETO || cmd == NVG_LINETO) ? 1 : 0;
+		for (j = 0; j < npts; j++) {
+			float x = ctx->commands[i+1+j*2], y = ctx->commands[i+2+j*2];
+			bounds[0] = nvg__minf(bounds[0], x);
+			bounds[1] = nvg__minf(bounds[1], y);
+			bounds[2] = nvg__maxf(bounds[2], x);
+			bounds[3] = nvg__maxf(bounds[3], y);
+		}
+		i += cmd == NVG_WINDING ? 2 : 1 + npts*2;
+	}
+
+	if (!nvg__isCulled(ctx, bounds, pad))
+		return 0;
+	ctx->culledPathCount++;
+	return 1;
+}
+
+// Returns true if a saved tessellation drawn with the transform can be skipped. Its vertices
+// already include the fringe, and the transformed corners of their bounds enclose them.
+static int nvg__isTessellationCulled(NVGcontext* ctx, const NVGtessellation* tess, const float* xform)
+{
+	const float* b = tess->bounds;
+	float c[4*2], bounds[4];
+
+	if (tess->nverts == 0)
+		return 0;
+
+	nvgTransformPoint(&c[0],&c[1], xform, b[0], b[1]);
+	nvgTransformPoint(&c[2],&c[3], xform, b[2], b[1]);
+	nvgTransformPoint(&c[4],&c[5], xform, b[2], b[3]);
+	nvgTransformPoint(&c[6],&c[7], xform, b[0], b[3]);
+	bounds[0] = nvg__minf(nvg__minf(c[0], c[2]), nvg__minf(c[4], c[6]));
+	bounds[1] = nvg__minf(nvg__minf(c[1], c[3]), nvg__minf(c[5], c[7]));
+	bounds[2] = nvg__maxf(nvg__maxf(c[0], c[2]), nvg__maxf(c[4], c[6]));
+	bounds[3] = nvg__maxf(nvg__maxf(c[1], c[3]), nvg__maxf(c[5], c[7]));
+
+	if (!nvg__isCulled(ctx, bounds, 0.0f))
+		return 0;
+	ctx->culledPathCount++;
+	return 1;
+}
+
+// Flattens and expands the current path with the current stroke style. The expanded paths are left
+// in ctx->cache, which can be the dash cache, so the caller must restore the cache afterwards.
+// Returns the stroke width in device pixels and the alpha used to emulate the coverage of thin strokes.
+static float nvg__expandStrokeState(NVGcontext* ctx, float* coverage)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float scale = nvg__getAverageScale(state->xform);
+	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
+	int hairline = ctx->params.edgeAntiAlias && state->shapeAntiAlias && strokeWidth <= ctx->fringeWidth;
+	int i;
+
+	*coverage = 1.0f;
+	if (strokeWidth < ctx->fringeWidth) {
+		// If the stroke width is less than pixel size, use alpha to emulate coverage.
+		// Since coverage is area, scale by alpha*alpha.
+		float alpha = nvg__clampf(strokeWidth / ctx->fringeWidth, 0.0f, 1.0f);
+		*coverage = alpha*alpha;
+		strokeWidth = ctx->fringeWidth;
+	}
+
+	nvg__flattenPaths(ctx);
+
+	if (state->ndashes > 0) {
+		float dashes[NVG_MAX_DASHES];
+		float total = 0.0f;
+		for (i = 0; i < state->ndashes; i++) {
+			dashes[i] = state->dashes[i] * scale;
+			total += dashes[i];
+		}
+		// Patterns shorter than a fraction of a pixel are drawn solid.
+		if (total > ctx->distTol)
+			nvg__dashPaths(ctx, dashes, state->ndashes, state->dashOffset * scale);
+	}
+
+	if (hairline)
+		nvg__expandHairline(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->miterLimit);
+	else if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+		nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
+	else
+		nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+
+	return strokeWidth;
+}
+
+//
+// Deferred tessellation
+//
+// With tessellation threads, fills and strokes which miss the tessellation cache only record their
+// commands and state. In nvgEndFrame() the calling thread and the workers flatten and expand them,
+// each worker with its own context holding a frame arena and path caches. All other draws are
+// recorded too, so that everything reaches the render back-end in the order it was issued.
+
+#ifndef NVG_NO_THREADS
+static int nvg__atomicInc(int* p) { return __atomic_fetch_add(p, 1, __ATOMIC_RELAXED); }
+#else
+static int nvg__atomicInc(int* p) { return (*p)++; }
+#endif
+
+static void nvg__deleteWorkerContext(NVGcontext* wctx)
+{
+	if (wctx == NULL) return;
+	if (wctx->cache != NULL) nvg__deletePathCache(wctx->cache);
+	if (wctx->dashCache != NULL) nvg__deletePathCache(wctx->dashCache);
+	nvg__deleteArena(wctx->arena);
+	free(wctx);
+}
+
+static NVGcontext* nvg__allocWorkerContext(NVGcontext* ctx)
+{
+	NVGcontext* wctx = (NVGcontext*)malloc(sizeof(NVGcontext));
+	if (wctx == NULL) return NULL;
+	memset(wctx, 0, sizeof(NVGcontext));
+
+	wctx->params = ctx->params;
+	wctx->nstates = 1;
+
+	wctx->arena = nvg__allocArena();
+	if (wctx->arena == NULL) goto error;
+
+	wctx->cache = nvg__allocPathCache(wctx->arena);
+	if (wctx->cache == NULL) goto error;
+
+	wctx->dashCache = nvg__allocPathCache(wctx->arena);
+	if (wctx->dashCache == NULL) goto error;
+
+	return wctx;
+error:
+	nvg__deleteWorkerContext(wctx);
+	return NULL;
+}
+
+// Copies paths and their vertices into the arena.
+static NVGpath* nvg__copyPaths(NVGarena* arena, const NVGpath* paths, int npaths)
+{
+	NVGpath* dst;
+	NVGvertex* verts;
+	int i, nverts = 0;
+
+	for (i = 0; i < npaths; i++)
+		nverts += paths[i].nfill + paths[i].nstroke;
+
+	dst = (NVGpath*)nvgArenaAlloc(arena, sizeof(NVGpath)*npaths + sizeof(NVGvertex)*nverts);
+	if (dst == NULL) return NULL;
+
+	verts = (NVGvertex*)(dst + npaths);
+	for (i = 0; i < npaths; i++) {
+		dst[i] = paths[i];
+		if (paths[i].nfill > 0) {
+			memcpy(verts, paths[i].fill, sizeof(NVGvertex)*paths[i].nfill);
+			dst[i].fill = verts;
+			verts += paths[i].nfill;
+		}
+		if (paths[i].nstroke > 0) {
+			memcpy(verts, paths[i].stroke, sizeof(NVGvertex)*paths[i].nstroke);
+			dst[i].stroke = verts;
+			verts += paths[i].nstroke;
+		}
+	}
+
+	return dst;
+}
+
+static NVGdeferredCall* nvg__allocDeferredCall(NVGcontext* ctx, int type, const NVGpaint* paint,
+											   NVGcompositeOperationState compositeOperation, const NVGscissor* scissor, float fringe)
+{
+	NVGdeferredCall* call;
+
+	if (ctx->ncalls+1 > ctx->ccalls) {
+		NVGdeferredCall* calls;
+		int ccalls = nvg__maxi(ctx->ncalls+1, NVG_INIT_CALLS_SIZE) + ctx->ccalls/2;
+		calls = (NVGdeferredCall*)nvgArenaRealloc(ctx->arena, ctx->calls, sizeof(NVGdeferredCall)*ctx->ncalls, sizeof(NVGdeferredCall)*ccalls);
+		if (calls == NULL) return NULL;
+		ctx->calls = calls;
+		ctx->ccalls = ccalls;
+	}
+
+	call = &ctx->calls[ctx->ncalls++];
+	memset(call, 0, sizeof(NVGdeferredCall));
+	call->type = type;
+	call->paint = *paint;
+	call->compositeOperation = compositeOperation;
+	call->scissor = *scissor;
+	call->fringe = fringe;
+	call->coverage = 1.0f;
+	return call;
+}
+
+static void nvg__renderFill(NVGcontext* ctx, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+							float fringe, const float* bounds, const NVGpath* paths, int npaths)
+{
+	NVGdeferredCall* call;
+
+	if (ctx->tessPool == NULL) {
+		ctx->params.renderFill(ctx->params.userPtr, paint, compositeOperation, scissor, fringe, bounds, paths, npaths);
+		return;
+	}
+
+	call = nvg__allocDeferredCall(ctx, NVG_DEFERRED_FILL, paint, compositeOperation, scissor, fringe);
+	if (call == NULL) return;
+	memcpy(call->bounds, bounds, sizeof(call->bounds));
+	call->paths = nvg__copyPaths(ctx->arena, paths, npaths);
+	call->npaths = npaths;
+}
+
+static void nvg__renderStroke(NVGcontext* ctx, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+							  float fringe, float strokeWidth, const NVGpath* paths, int npaths)
+{
+	NVGdeferredCall* call;
+
+	if (ctx->tessPool == NULL) {
+		ctx->params.renderStroke(ctx->params.userPtr, paint, compositeOperation, scissor, fringe, strokeWidth, paths, npaths);
+		return;
+	}
+
+	call = nvg__allocDeferredCall(ctx, NVG_DEFERRED_STROKE, paint, compositeOperation, scissor, fringe);
+	if (call == NULL) return;
+	call->strokeWidth = strokeWidth;
+	call->paths = nvg__copyPaths(ctx->arena, paths, npaths);
+	call->npaths = npaths;
+}
+
+static void nvg__renderTriangles(NVGcontext* ctx, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								 const NVGvertex* verts, int nverts, float fringe)
+{
+	NVGdeferredCall* call;
+
+	if (ctx->tessPool == NULL) {
+		ctx->params.renderTriangles(ctx->params.userPtr, paint, compositeOperation, scissor, verts, nverts, fringe);
+		return;
+	}
+
+	call = nvg__allocDeferredCall(ctx, NVG_DEFERRED_TRIANGLES, paint, compositeOperation, scissor, fringe);
+	if (call == NULL) return;
+	call->verts = (NVGvertex*)nvgArenaAlloc(ctx->arena, sizeof(NVGvertex)*nverts);
+	if (call->verts == NULL) {
+		ctx->ncalls--;
+		return;
+	}
+	memcpy(call->verts, verts, sizeof(NVGvertex)*nverts);
+	call->nverts = nverts;
+}
+
+// Records the current path to be tessellated in nvgEndFrame(), along with the key built by
+// the last nvg__tessCacheFind(), so that the result can be added to the tessellation cache.
+static void nvg__deferTessellation(NVGcontext* ctx, int type, NVGpaint* paint)
+{
+	NVGtessCache* tc = ctx->tessCache;
+	NVGstate* state = nvg__getState(ctx);
+	NVGdeferredCall* call;
+
+	call = nvg__allocDeferredCall(ctx, type, paint, state->compositeOperation, &state->scissor, ctx->fringeWidth);
+	if (call == NULL) return;
+
+	call->state = (NVGstate*)nvgArenaAlloc(ctx->arena, sizeof(NVGstate));
+	call->commands = (float*)nvgArenaAlloc(ctx->arena, sizeof(float)*ctx->ncommands);
+	if (call->state == NULL || call->commands == NULL) {
+		ctx->ncalls--;
+		return;
+	}
+	*call->state = *state;
+	memcpy(call->commands, ctx->commands, sizeof(float)*ctx->ncommands);
+	call->ncommands = ctx->ncommands;
+
+	if (tc->nkey > 0) {
+		call->key = (int*)nvgArenaAlloc(ctx->arena, sizeof(int)*tc->nkey);
+		if (call->key != NULL) {
+			memcpy(call->key, tc->key, sizeof(int)*tc->nkey);
+			call->nkey = tc->nkey;
+			call->hash = tc->hash;
+		}
+		tc->nkey = 0;
+	}
+}
+
+// Flattens and expands a recorded path with the context of a worker, and copies the result
+// to the arena of the worker.
+static void nvg__tessellateCall(NVGcontext* wctx, NVGdeferredCall* call)
+{
+	NVGpathCache* cache = wctx->cache;
+	NVGstate* state = call->state;
+
+	wctx->states[0] = *state;
+	wctx->commands = call->commands;
+	wctx->ncommands = call->ncommands;
+	nvg__clearPathCache(wctx);
+
+	if (call->type == NVG_DEFERRED_FILL) {
+		nvg__flattenPaths(wctx);
+		if (wctx->params.edgeAntiAlias && state->shapeAntiAlias)
+			nvg__expandFill(wctx, wctx->fringeWidth, NVG_MITER, 2.4f);
+		else
+			nvg__expandFill(wctx, 0.0f, NVG_MITER, 2.4f);
+		memcpy(call->bounds, cache->bounds, sizeof(call->bounds));
+	} else {
+		call->strokeWidth = nvg__expandStrokeState(wctx, &call->coverage);
+	}
+
+	call->paths = nvg__copyPaths(wctx->arena, wctx->cache->paths, wctx->cache->npaths);
+	call->npaths = wctx->cache->npaths;
+
+	// Restore the flattened paths.
+	wctx->cache = cache;
+}
+
+// Runs the jobs of the worker, then steals the remaining jobs of the other workers.
+static void nvg__runTessJobs(NVGtessWorker* w)
+{
+	NVGtessPool* pool = w->pool;
+	NVGcontext* wctx = w->ctx;
+	int i, j, first = (int)(w - pool->workers);
+
+	nvg__arenaReset(wctx->arena);
+	nvg__resetPathCache(wctx->arena, wctx->cache);
+	nvg__resetPathCache(wctx->arena, wctx->dashCache);
+
+	for (i = 0; i < pool->nworkers; i++) {
+		NVGtessWorker* victim = &pool->workers[(first + i) % pool->nworkers];
+		while ((j = nvg__atomicInc(&victim->next)) < victim->end)
+			nvg__tessellateCall(wctx, &pool->calls[pool->jobs[j]]);
+	}
+}
+
+#ifndef NVG_NO_THREADS
+static void* nvg__tessThread(void* arg)
+{
+	NVGtessWorker* w = (NVGtessWorker*)arg;
+	NVGtessPool* pool = w->pool;
+	int generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		nvg__runTessJobs(w);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->active == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+#endif
+
+static void nvg__deleteTessPool(NVGtessPool* pool)
+{
+	int i;
+	if (pool == NULL) return;
+
+#ifndef NVG_NO_THREADS
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 1; i < pool->nworkers; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+#endif
+
+	for (i = 0; i < pool->nworkers; i++)
+		nvg__deleteWorkerContext(pool->workers[i].ctx);
+	free(pool->workers);
+	free(pool);
+}
+
+static NVGtessPool* nvg__allocTessPool(NVGcontext* ctx, int threads)
+{
+	NVGtessPool* pool = (NVGtessPool*)malloc(sizeof(NVGtessPool));
+	int i;
+	if (pool == NULL) return NULL;
+	memset(pool, 0, sizeof(NVGtessPool));
+
+	pool->workers = (NVGtessWorker*)malloc(sizeof(NVGtessWorker)*(threads+1));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+	memset(pool->workers, 0, sizeof(NVGtessWorker)*(threads+1));
+
+#ifndef NVG_NO_THREADS
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+#endif
+
+	// Run with as many workers as could be started, the calling thread is always one of them.
+	for (i = 0; i <= threads; i++) {
+		NVGtessWorker* w = &pool->workers[i];
+		w->pool = pool;
+		w->ctx = nvg__allocWorkerContext(ctx);
+		if (w->ctx == NULL) break;
+#ifndef NVG_NO_THREADS
+		if (i > 0 && pthread_create(&w->thread, NULL, nvg__tessThread, w) != 0) {
+			nvg__deleteWorkerContext(w->ctx);
+			w->ctx = NULL;
+			break;
+		}
+#endif
+		pool->nworkers++;
+	}
+
+	if (pool->nworkers == 0) {
+		nvg__deleteTessPool(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+void nvgTessellationThreads(NVGcontext* ctx, int threads)
+{
+	// Submit what has been recorded so far before switching modes.
+	nvg__submitDeferred(ctx);
+	nvg__deleteTessPool(ctx->tessPool);
+	ctx->tessPool = NULL;
+
+#ifdef NVG_NO_THREADS
+	threads = 0;
+#endif
+	if (threads > 0)
+		ctx->tessPool = nvg__allocTessPool(ctx, threads);
+}
+
+// Tessellates the recorded paths on the workers, then submits all recorded draws in order.
+static void nvg__submitDeferred(NVGcontext* ctx)
+{
+	NVGtessPool* pool = ctx->tessPool;
+	NVGdeferredCall* call;
+	int* jobs;
+	int i, njobs = 0;
+
+	if (pool == NULL || ctx->ncalls == 0)
+		return;
+	ctx->peakCalls = nvg__maxi(ctx->peakCalls, ctx->ncalls);
+
+	jobs = (int*)nvgArenaAlloc(ctx->arena, sizeof(int)*ctx->ncalls);
+	if (jobs == NULL) {
+		ctx->ncalls = 0;
+		return;
+	}
+	for (i = 0; i < ctx->ncalls; i++) {
+		if (ctx->calls[i].commands != NULL)
+			jobs[njobs++] = i;
+	}
+
+	if (njobs > 0) {
+		// Each worker starts with a contiguous range of the jobs.
+		for (i = 0; i < pool->nworkers; i++) {
+			NVGtessWorker* w = &pool->workers[i];
+			w->next = njobs * i / pool->nworkers;
+			w->end = njobs * (i+1) / pool->nworkers;
+			w->ctx->tessTol = ctx->tessTol;
+			w->ctx->distTol = ctx->distTol;
+			w->ctx->fringeWidth = ctx->fringeWidth;
+			w->ctx->devicePxRatio = ctx->devicePxRatio;
+		}
+		pool->calls = ctx->calls;
+		pool->jobs = jobs;
+
+#ifndef NVG_NO_THREADS
+		pthread_mutex_lock(&pool->lock);
+		pool->generation++;
+		pool->active = pool->nworkers-1;
+		pthread_cond_broadcast(&pool->start);
+		pthread_mutex_unlock(&pool->lock);
+#endif
+
+		nvg__runTessJobs(&pool->workers[0]);
+
+#ifndef NVG_NO_THREADS
+		pthread_mutex_lock(&pool->lock);
+		while (pool->active > 0)
+			pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+#endif
+	}
+
+	for (i = 0; i < ctx->ncalls; i++) {
+		call = &ctx->calls[i];
+		if (call->type == NVG_DEFERRED_TRIANGLES) {
+			ctx->params.renderTriangles(ctx->params.userPtr, &call->paint, call->compositeOperation, &call->scissor,
+										call->verts, call->nverts, call->fringe);
+			continue;
+		}
+		if (call->paths == NULL)
+			continue;
+
+		if (call->type == NVG_DEFERRED_FILL) {
+			ctx->params.renderFill(ctx->params.userPtr, &call->paint, call->compositeOperation, &call->scissor, call->fringe,
+								   call->bounds, call->paths, call->npaths);
+		} else {
+			// Apply coverage
+			call->paint.innerColor.a *= call->coverage;
+			call->paint.outerColor.a *= call->coverage;
+			ctx->params.renderStroke(ctx->params.userPtr, &call->paint, call->compositeOperation, &call->scissor, call->fringe,
+									 call->strokeWidth, call->paths, call->npaths);
+		}
+
+		if (call->commands != NULL) {
+			const NVGpath* path;
+			int j;
+
+			nvg__tessCacheAdd(ctx->tessCache, call->key, call->nkey, call->hash, call->state->xform[4], call->state->xform[5],
+							  call->paths, call->npaths, call->strokeWidth, call->coverage);
+			ctx->deferredCount++;
+
+			// Count triangles
+			for (j = 0; j < call->npaths; j++) {
+				path = &call->paths[j];
+				if (call->type == NVG_DEFERRED_FILL) {
+					ctx->fillTriCount += path->nfill-2;
+					ctx->fillTriCount += path->nstroke-2;
+					ctx->drawCallCount += 2;
+				} else {
+					ctx->strokeTriCount += path->nstroke-2;
+					ctx->drawCallCount++;
+				}
+			}
+		}
+	}
+
+	ctx->ncalls = 0;
+}
+
+void nvgFill(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGtessCacheEntry* entry;
+	const NVGpath* path;
+	NVGpath* paths;
+	NVGpaint fillPaint = state->fill;
+	float bounds[4];
+	int i, npaths;
+
+	if (nvg__isPathCulled(ctx, ctx->fringeWidth))
+		return;
+
+	// Apply global alpha
+	fillPaint.innerColor.a *= state->alpha;
+	fillPaint.outerColor.a *= state->alpha;
+
+	entry = nvg__tessCacheFind(ctx, 0);
+	if (entry != NULL) {
+		paths = nvg__tessCacheRestore(ctx, entry, bounds);
+		if (paths == NULL) return;
+		npaths = entry->tess.npaths;
+	} else if (ctx->tessPool != NULL) {
+		nvg__deferTessellation(ctx, NVG_DEFERRED_FILL, &fillPaint);
+		return;
+	} else {
+		nvg__flattenPaths(ctx);
+		if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+			nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
+		else
+			nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+		nvg__tessCacheInsert(ctx, ctx->cache, 0.0f, 1.0f);
+		paths = ctx->cache->paths;
+		npaths = ctx->cache->npaths;
+		memcpy(bounds, ctx->cache->bounds, sizeof(bounds));
+	}
+
+	nvg__renderFill(ctx, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth, bounds, paths, npaths);
+
+	// Count triangles
+	for (i = 0; i < npaths; i++) {
+		path = &paths[i];
+		ctx->fillTriCount += path->nfill-2;
+		ctx->fillTriCount += path->nstroke-2;
+		ctx->drawCallCount += 2;
+	}
+}
+
+void nvgStroke(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGtessCacheEntry* entry;
+	NVGpaint strokePaint = state->stroke;
+	NVGpathCache* cache = ctx->cache;
+	const NVGpath* path;
+	NVGpath* paths;
+	float strokeWidth, coverage, bounds[4];
+	int i, npaths;
+
+	// Miter joins reach out at most miterLimit half widths, the same limit is used to check overlap.
+	strokeWidth = nvg__clampf(state->strokeWidth * nvg__getAverageScale(state->xform), 0.0f, 200.0f);
+	if (nvg__isPathCulled(ctx, strokeWidth*0.5f * nvg__maxf(state->miterLimit, 1.5f) + ctx->fringeWidth))
+		return;
+
+	entry = nvg__tessCacheFind(ctx, 1);
+	if (entry != NULL) {
+		paths = nvg__tessCacheRestore(ctx, entry, bounds);
+		if (paths == NULL) return;
+		npaths = entry->tess.npaths;
+		strokeWidth = entry->strokeWidth;
+		coverage = entry->coverage;
+	} else if (ctx->tessPool != NULL) {
+		// The coverage is applied once the stroke has been expanded.
+		strokePaint.innerColor.a *= state->alpha;
+		strokePaint.outerColor.a *= state->alpha;
+		nvg__deferTessellation(ctx, NVG_DEFERRED_STROKE, &strokePaint);
+		return;
+	} else {
+		strokeWidth = nvg__expandStrokeState(ctx, &coverage);
+		nvg__tessCacheInsert(ctx, ctx->cache, strokeWidth, coverage);
+		paths = ctx->cache->paths;
+		npaths = ctx->cache->npaths;
+	}
+
+	// Apply coverage and global alpha
+	strokePaint.innerColor.a *= coverage * state->alpha;
+	strokePaint.outerColor.a *= coverage * state->alpha;
+
+	nvg__renderStroke(ctx, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth, strokeWidth, paths, npaths);
+
+	// Count triangles
+	for (i = 0; i < npaths; i++) {
+		path = &paths[i];
+		ctx->strokeTriCount += path->nstroke-2;
+		ctx->drawCallCount++;
+	}
+
+	// Restore the flattened paths.
+	ctx->cache = cache;
+}
+
+// Compiled paths
+NVGcompiledPath* nvgCompilePath(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpathCache* cache = ctx->cache;
+	NVGcompiledPath* cp = NULL;
+	float inv[6];
+	int n;
+
+	if (!nvgTransformInverse(inv, state->xform))
+		return NULL;
+
+	cp = (NVGcompiledPath*)malloc(sizeof(NVGcompiledPath));
+	if (cp == NULL) goto error;
+	memset(cp, 0, sizeof(NVGcompiledPath));
+	cp->scale = nvg__getAverageScale(state->xform);
+
+	// Flattened points
+	nvg__flattenPaths(ctx);
+
+	// Fill
+	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+		nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
+	else
+		nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+	if (!nvg__saveTessellation(&cp->fill, cache->paths, cache->npaths, inv)) goto error;
+
+	// Stroke
+	cp->strokeWidth = nvg__expandStrokeState(ctx, &cp->strokeCoverage);
+	n = nvg__saveTessellation(&cp->stroke, ctx->cache->paths, ctx->cache->npaths, inv);
+	ctx->cache = cache;
+	if (!n) goto error;
+
+	cp->xpaths = (NVGpath*)malloc(sizeof(NVGpath)*nvg__maxi(nvg__maxi(cp->fill.npaths, cp->stroke.npaths), 1));
+	if (cp->xpaths == NULL) goto error;
+
+	return cp;
+
+error:
+	nvgDeleteCompiledPath(ctx, cp);
+	return NULL;
+}
+
+void nvgFillCompiledPath(NVGcontext* ctx, NVGcompiledPath* cp)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpaint fillPaint = state->fill;
+	float bounds[4], ratio;
+	int i;
+
+	if (cp == NULL || cp->fill.npaths == 0) return;
+	if (nvg__isTessellationCulled(ctx, &cp->fill, state->xform)) return;
+	if (!nvg__restoreTessellation(ctx, &cp->fill, cp->xpaths, state->xform, bounds)) return;
+
+	// The fringe is part of the compiled geometry and scales with the transform, so the edges are
+	// only sharp near the scale the path was compiled at.
+	ratio = cp->scale > 0.0f ? nvg__getAverageScale(state->xform) / cp->scale : 1.0f;
+
+	// Apply global alpha
+	fillPaint.innerColor.a *= state->alpha;
+	fillPaint.outerColor.a *= state->alpha;
+
+	nvg__renderFill(ctx, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth * ratio, bounds, cp->xpaths, cp->fill.npaths);
+
+	// Count triangles
+	for (i = 0; i < cp->fill.npaths; i++) {
+		ctx->fillTriCount += cp->xpaths[i].nfill-2;
+		ctx->fillTriCount += cp->xpaths[i].nstroke-2;
+		ctx->drawCallCount += 2;
+	}
+}
+
+void nvgStrokeCompiledPath(NVGcontext* ctx, NVGcompiledPath* cp)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpaint strokePaint = state->stroke;
+	float bounds[4], ratio;
+	int i;
+
+	if (cp == NULL || cp->stroke.npaths == 0) return;
+	if (nvg__isTessellationCulled(ctx, &cp->stroke, state->xform)) return;
+	if (!nvg__restoreTessellation(ctx, &cp->stroke, cp->xpaths, state->xform, bounds)) return;
+
+	// The stroke and its fringe scale with the transform.
+	ratio = cp->scale > 0.0f ? nvg__getAverageScale(state->xform) / cp->scale : 1.0f;
+
+	// Apply coverage and global alpha
+	strokePaint.innerColor.a *= cp->strokeCoverage * state->alpha;
+	strokePaint.outerColor.a *= cp->strokeCoverage * state->alpha;
+
+	nvg__renderStroke(ctx, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth * ratio,
+					  cp->strokeWidth * ratio, cp->xpaths, cp->stroke.npaths);
+
+	// Count triangles
+	for (i = 0; i < cp->stroke.npaths; i++) {
+		ctx->strokeTriCount += cp->xpaths[i].nstroke-2;
+		ctx->drawCallCount++;
+	}
+}
+
+void nvgDeleteCompiledPath(NVGcontext* ctx, NVGcompiledPath* cp)
+{
+	NVG_NOTUSED(ctx);
+	if (cp == NULL) return;
+	nvg__deleteTessellation(&cp->fill);
+	nvg__deleteTessellation(&cp->stroke);
+	if (cp->xpaths != NULL) free(cp->xpaths);
+	free(cp);
+}
+
+// Add fonts
+int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename)
+{
+	return fonsAddFont(ctx->fs, name, filename, 0);
+}
+
+int nvgCreateFontAtIndex(NVGcontext* ctx, const char* name, const char* filename, const int fontIndex)
+{
+	return fonsAddFont(ctx->fs, name, filename, fontIndex);
+}
+
+int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData)
+{
+	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, 0);
+}
+
+int nvgCreateFontMemAtIndex(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData, const int fontIndex)
+{
+	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, fontIndex);
+}
+
+int nvgFindFont(NVGcontext* ctx, const char* name)
+{
+	if (name == NULL) return -1;
+	return fonsGetFontByName(ctx->fs, name);
+}
+
+
+int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
+{
+	if(baseFont == -1 || fallbackFont == -1) return 0;
+	return fonsAddFallbackFont(ctx->fs, baseFont, fallbackFont);
+}
+
+int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallbackFont)
+{
+	return nvgAddFallbackFontId(ctx, nvgFindFont(ctx, baseFont), nvgFindFont(ctx, fallbackFont));
+}
+
+void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont)
+{
+	fonsResetFallbackFont(ctx->fs, baseFont);
+}
+
+void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont)
+{
+	nvgResetFallbackFontsId(ctx, nvgFindFont(ctx, baseFont));
+}
 
 // State setting
 void nvgFontSize(NVGcontext* ctx, float size)
@@ -2390,47 +4679,240 @@ static float nvg__getFontScale(NVGstate* state)
 
 static void nvg__flushTextTexture(NVGcontext* ctx)
 {
-	int dirty[4];
+	const int* dirty;
+	int i, n = fonsValidateTextureRects(ctx->fs, &dirty);
+	int fontImage = ctx->fontImages[ctx->fontImageIdx];
 
-	if (fonsValidateTexture(ctx->fs, dirty)) {
-		int fontImage = ctx->fontImages[ctx->fontImageIdx];
-		// Update texture
-		if (fontImage != 0) {
-			int iw, ih;
-			const unsigned char* data = fonsGetTextureData(ctx->fs, &iw, &ih);
-			int x = dirty[0];
-			int y = dirty[1];
-			int w = dirty[2] - dirty[0];
-			int h = dirty[3] - dirty[1];
-			ctx->params.renderUpdateTexture(ctx->params.userPtr, fontImage, x,y, w,h, data);
+	// Update texture, one region per group of new glyphs.
+	if (n > 0 && fontImage != 0) {
+		int iw, ih;
+		const unsigned char* data = fonsGetTextureData(ctx->fs, &iw, &ih);
+		for (i = 0; i < n; i++) {
+			const int* r = &dirty[i*4];
+			ctx->params.renderUpdateTexture(ctx->params.userPtr, fontImage, r[0],r[1], r[2]-r[0],r[3]-r[1], data);
 		}
 	}
 }
 
 static int nvg__allocTextAtlas(NVGcontext* ctx)
 {
-	int iw, ih;
+	int iw, ih, ow, oh, dirty[4];
+	int fontImage = ctx->fontImages[ctx->fontImageIdx];
 	nvg__flushTextTexture(ctx);
 	if (ctx->fontImageIdx >= NVG_MAX_FONTIMAGES-1)
 		return 0;
+	nvgImageSize(ctx, fontImage, &ow, &oh);
 	// if next fontImage already have a texture
 	if (ctx->fontImages[ctx->fontImageIdx+1] != 0)
 		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx+1], &iw, &ih);
 	else { // calculate the new font image size and create it.
-		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx], &iw, &ih);
+		iw = ow;
+		ih = oh;
 		if (iw > ih)
 			ih *= 2;
 		else
 			iw *= 2;
 		if (iw > NVG_MAX_FONTIMAGE_SIZE || ih > NVG_MAX_FONTIMAGE_SIZE)
 			iw = ih = NVG_MAX_FONTIMAGE_SIZE;
-		ctx->fontImages[ctx->fontImageIdx+1] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, 0, NULL);
+		ctx->fontImages[ctx->fontImageIdx+1] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, nvg__fontImageFlags(ctx), NULL);
+	}
+	if (iw > ow || ih > oh) {
+		// Grow the atlas, keeping the cached glyphs where they are.
+		if (!fonsExpandAtlas(ctx->fs, iw, ih))
+			return 0;
+		++ctx->fontImageIdx;
+		// Copy the old texture on the GPU, otherwise the glyphs are uploaded again with the next flush.
+		if (ctx->params.renderCopyTexture != NULL &&
+			ctx->params.renderCopyTexture(ctx->params.userPtr, ctx->fontImages[ctx->fontImageIdx], fontImage, ow, oh))
+			fonsValidateTexture(ctx->fs, dirty);
+	} else {
+		// The atlas is at its maximum size, start over.
+		++ctx->fontImageIdx;
+		fonsResetAtlas(ctx->fs, iw, ih);
 	}
-	++ctx->fontImageIdx;
-	fonsResetAtlas(ctx->fs, iw, ih);
 	return 1;
 }
 
+#ifndef NVG_NO_THREADS
+static void* nvg__glyphThread(void* arg)
+{
+	NVGglyphPool* pool = (NVGglyphPool*)arg;
+	FONSglyphBatch* batch;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->quit && pool->ndone == pool->nbatches)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit)
+			break;
+		batch = pool->batches[pool->ndone];
+		pthread_mutex_unlock(&pool->lock);
+
+		fonsRasterizeGlyphBatch(batch);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->ndone++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+#endif
+
+static void nvg__deleteGlyphPool(NVGglyphPool* pool)
+{
+	int i;
+	if (pool == NULL) return;
+
+#ifndef NVG_NO_THREADS
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_signal(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	pthread_join(pool->thread, NULL);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+#endif
+
+	for (i = 0; i < pool->nbatches; i++)
+		fonsDeleteGlyphBatch(pool->batches[i]);
+	free(pool->batches);
+	free(pool);
+}
+
+// Starts the glyph thread, returns NULL when glyphs have to be rasterized right away.
+static NVGglyphPool* nvg__allocGlyphPool(void)
+{
+#ifdef NVG_NO_THREADS
+	return NULL;
+#else
+	NVGglyphPool* pool = (NVGglyphPool*)malloc(sizeof(NVGglyphPool));
+	if (pool == NULL) return NULL;
+	memset(pool, 0, sizeof(NVGglyphPool));
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	if (pthread_create(&pool->thread, NULL, nvg__glyphThread, pool) != 0) {
+		pthread_cond_destroy(&pool->start);
+		pthread_mutex_destroy(&pool->lock);
+		free(pool);
+		return NULL;
+	}
+	return pool;
+#endif
+}
+
+// Hands the glyphs reserved since the last call to the glyph thread, or rasterizes them right away without one.
+static void nvg__submitGlyphs(NVGcontext* ctx)
+{
+	NVGglyphPool* pool = ctx->glyphPool;
+	FONSglyphBatch* batch = fonsTakeGlyphBatch(ctx->fs);
+	if (batch == NULL)
+		return;
+
+#ifndef NVG_NO_THREADS
+	if (pool != NULL) {
+		pthread_mutex_lock(&pool->lock);
+		if (pool->nbatches+1 > pool->cbatches) {
+			int cbatches = pool->cbatches == 0 ? 4 : pool->cbatches * 2;
+			FONSglyphBatch** batches = (FONSglyphBatch**)realloc(pool->batches, sizeof(FONSglyphBatch*) * cbatches);
+			if (batches != NULL) {
+				pool->batches = batches;
+				pool->cbatches = cbatches;
+			}
+		}
+		if (pool->nbatches+1 <= pool->cbatches) {
+			pool->batches[pool->nbatches++] = batch;
+			pthread_cond_signal(&pool->start);
+			batch = NULL;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+#else
+	NVG_NOTUSED(pool);
+#endif
+
+	if (batch != NULL) {
+		fonsRasterizeGlyphBatch(batch);
+		fonsApplyGlyphBatch(ctx->fs, batch);
+	}
+}
+
+// Adds the glyphs rasterized by the glyph thread to the atlas.
+static void nvg__applyGlyphs(NVGcontext* ctx)
+{
+#ifndef NVG_NO_THREADS
+	NVGglyphPool* pool = ctx->glyphPool;
+	int i, ndone;
+	if (pool == NULL)
+		return;
+
+	// Only this thread adds batches, the glyph thread is done with the first ndone ones.
+	pthread_mutex_lock(&pool->lock);
+	ndone = pool->ndone;
+	pthread_mutex_unlock(&pool->lock);
+	if (ndone == 0)
+		return;
+
+	for (i = 0; i < ndone; i++)
+		fonsApplyGlyphBatch(ctx->fs, pool->batches[i]);
+
+	pthread_mutex_lock(&pool->lock);
+	memmove(pool->batches, &pool->batches[ndone], sizeof(FONSglyphBatch*) * (pool->nbatches - ndone));
+	pool->nbatches -= ndone;
+	pool->ndone -= ndone;
+	pthread_mutex_unlock(&pool->lock);
+#else
+	NVG_NOTUSED(ctx);
+#endif
+}
+
+void nvgPrewarmGlyphs(NVGcontext* ctx, const char* string, const char* end, const float* sizes, int nsizes)
+{
+	NVGstate* state = nvg__getState(ctx);
+	FONStextIter iter, prevIter;
+	FONSquad q;
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	int i;
+
+	if (end == NULL)
+		end = string + strlen(string);
+
+	if (state->fontId == FONS_INVALID) return;
+
+	if (ctx->glyphPool == NULL)
+		ctx->glyphPool = nvg__allocGlyphPool();
+
+	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetFont(ctx->fs, state->fontId);
+
+	for (i = 0; i < nsizes; i++) {
+		fonsSetSize(ctx->fs, sizes[i]*scale);
+		fonsTextIterInit(ctx->fs, &iter, 0, 0, string, end, FONS_GLYPH_BITMAP_DEFERRED);
+		prevIter = iter;
+		while (fonsTextIterNext(ctx->fs, &iter, &q)) {
+			if (iter.prevGlyphIndex == -1) { // atlas full?
+				if (!nvg__allocTextAtlas(ctx))
+					break;
+				iter = prevIter;
+				fonsTextIterNext(ctx->fs, &iter, &q); // try again
+				if (iter.prevGlyphIndex == -1)
+					break;
+			}
+			prevIter = iter;
+		}
+	}
+
+	nvg__submitGlyphs(ctx);
+}
+
+void nvgAsyncGlyphs(NVGcontext* ctx, int enabled)
+{
+	if (enabled && ctx->glyphPool == NULL)
+		ctx->glyphPool = nvg__allocGlyphPool();
+	// Without the glyph thread, deferring glyphs would only delay them.
+	ctx->asyncGlyphs = enabled && ctx->glyphPool != NULL;
+}
+
 static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -2438,25 +4920,247 @@ static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
 
 	// Render triangles.
 	paint.image = ctx->fontImages[ctx->fontImageIdx];
+	// Distance field glyphs are not blurred by fontstash, the back-end widens their edge instead.
+	if (ctx->params.sdfText)
+		paint.feather = state->fontBlur * nvg__getFontScale(state) * ctx->devicePxRatio;
 
 	// Apply global alpha
 	paint.innerColor.a *= state->alpha;
 	paint.outerColor.a *= state->alpha;
 
-	ctx->params.renderTriangles(ctx->params.userPtr, &paint, state->compositeOperation, &state->scissor, verts, nverts, ctx->fringeWidth);
+	nvg__renderTriangles(ctx, &paint, state->compositeOperation, &state->scissor, verts, nverts, ctx->fringeWidth);
 
 	ctx->drawCallCount++;
 	ctx->textTriCount += nverts/3;
 }
 
+// Transforms the corners of a glyph quad in font pixels. Returns 0 if the glyph is culled.
+static int nvg__textQuadCorners(NVGcontext* ctx, float* c, const FONSquad* q, float invscale)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float bounds[4];
+
+	// Transform corners.
+	nvgTransformPoint(&c[0],&c[1], state->xform, q->x0*invscale, q->y0*invscale);
+	nvgTransformPoint(&c[2],&c[3], state->xform, q->x1*invscale, q->y0*invscale);
+	nvgTransformPoint(&c[4],&c[5], state->xform, q->x1*invscale, q->y1*invscale);
+	nvgTransformPoint(&c[6],&c[7], state->xform, q->x0*invscale, q->y1*invscale);
+	// Skip glyphs outside the viewport and the scissor.
+	bounds[0] = nvg__minf(nvg__minf(c[0], c[2]), nvg__minf(c[4], c[6]));
+	bounds[1] = nvg__minf(nvg__minf(c[1], c[3]), nvg__minf(c[5], c[7]));
+	bounds[2] = nvg__maxf(nvg__maxf(c[0], c[2]), nvg__maxf(c[4], c[6]));
+	bounds[3] = nvg__maxf(nvg__maxf(c[1], c[3]), nvg__maxf(c[5], c[7]));
+	if (nvg__isCulled(ctx, bounds, ctx->fringeWidth)) {
+		ctx->culledGlyphCount++;
+		return 0;
+	}
+	return 1;
+}
+
+// Appends the two triangles of a glyph quad with the corners from nvg__textQuadCorners(). Returns the new vertex count.
+static int nvg__textQuadVerts(NVGvertex* verts, int nverts, int cverts, const float* c, const FONSquad* q)
+{
+	// Create triangles
+	if (nverts+6 <= cverts) {
+		nvg__vset(&verts[nverts], c[0], c[1], q->s0, q->t0); nverts++;
+		nvg__vset(&verts[nverts], c[4], c[5], q->s1, q->t1); nverts++;
+		nvg__vset(&verts[nverts], c[2], c[3], q->s1, q->t0); nverts++;
+		nvg__vset(&verts[nverts], c[0], c[1], q->s0, q->t0); nverts++;
+		nvg__vset(&verts[nverts], c[6], c[7], q->s0, q->t1); nverts++;
+		nvg__vset(&verts[nverts], c[4], c[5], q->s1, q->t1); nverts++;
+	}
+	return nverts;
+}
+
+static unsigned int nvg__textRunHash(const int* style, const char* string, const char* end)
+{
+	unsigned int hash = 2166136261u;
+	int i;
+	for (i = 0; i < NVG_TEXT_STYLE_SIZE; i++) {
+		hash ^= (unsigned int)style[i];
+		hash *= 16777619u;
+	}
+	for (; string != end; string++) {
+		hash ^= (unsigned char)*string;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Returns 1 if the glyphs of the run have not moved in the atlas since it was laid out. Only the pages the run
+// draws from are checked, glyphs evicted from other pages leave it valid.
+static int nvg__textRunValid(NVGcontext* ctx, const NVGtextRun* run)
+{
+	int i, page = -1;
+	if (run->generation != fonsAtlasGeneration(ctx->fs))
+		return 0;
+	for (i = 0; i < run->nglyphs; i++) {
+		const NVGtextRunGlyph* glyph = &run->glyphs[i];
+		if (glyph->page == page)
+			continue;
+		page = glyph->page;
+		if (glyph->pageGeneration != fonsPageGeneration(ctx->fs, page))
+			return 0;
+	}
+	return 1;
+}
+
+// Returns the cached run of the string in the given style, if its glyphs have not moved in the atlas since.
+static NVGtextRun* nvg__textCacheFind(NVGcontext* ctx, unsigned int hash, const int* style, const char* string, const char* end)
+{
+	NVGtextCache* tc = ctx->textCache;
+	NVGtextRun* run;
+	int n = (int)(end - string);
+
+	if (tc->maxSize <= 0)
+		return NULL;
+
+	for (run = tc->buckets[hash & (NVG_TEXT_CACHE_BUCKETS-1)]; run != NULL; run = run->next) {
+		if (run->hash == hash && run->nstring == n && memcmp(run->style, style, sizeof(run->style)) == 0 &&
+			memcmp(run->string, string, n) == 0)
+			break;
+	}
+	if (run != NULL && !nvg__textRunValid(ctx, run)) {
+		nvg__textCacheRemove(tc, run);
+		run = NULL;
+	}
+	if (run == NULL) {
+		ctx->textCacheMisses++;
+		return NULL;
+	}
+
+	// Move to front of the LRU list.
+	if (run->lruPrev != NULL) {
+		run->lruPrev->lruNext = run->lruNext;
+		if (run->lruNext != NULL) run->lruNext->lruPrev = run->lruPrev;
+		else tc->lruTail = run->lruPrev;
+		run->lruPrev = NULL;
+		run->lruNext = tc->lruHead;
+		tc->lruHead->lruPrev = run;
+		tc->lruHead = run;
+	}
+
+	ctx->textCacheHits++;
+	return run;
+}
+
+// Appends a glyph to the run being laid out, relative to the pixel fx,fy the run starts in.
+static int nvg__textCacheAddGlyph(NVGtextCache* tc, const FONSquad* q, int page, int pageGeneration, float fx, float fy)
+{
+	NVGtextRunGlyph* glyph;
+	if (tc->nglyphs+1 > tc->cglyphs) {
+		int cglyphs = tc->cglyphs == 0 ? 64 : tc->cglyphs * 2;
+		NVGtextRunGlyph* glyphs = (NVGtextRunGlyph*)realloc(tc->glyphs, sizeof(NVGtextRunGlyph) * cglyphs);
+		if (glyphs == NULL) return 0;
+		tc->glyphs = glyphs;
+		tc->cglyphs = cglyphs;
+	}
+	glyph = &tc->glyphs[tc->nglyphs++];
+	glyph->x0 = q->x0 - fx;
+	glyph->y0 = q->y0 - fy;
+	glyph->x1 = q->x1 - fx;
+	glyph->y1 = q->y1 - fy;
+	glyph->s0 = q->s0;
+	glyph->t0 = q->t0;
+	glyph->s1 = q->s1;
+	glyph->t1 = q->t1;
+	glyph->page = page;
+	glyph->pageGeneration = pageGeneration;
+	return 1;
+}
+
+// Adds the glyphs laid out with nvg__textCacheAddGlyph() as the run of the string.
+static void nvg__textCacheAdd(NVGtextCache* tc, unsigned int hash, const int* style, const char* string, const char* end,
+							  float dx, float dy, float advance, int generation)
+{
+	NVGtextRun* run;
+	NVGtextRun** bucket;
+	int n = (int)(end - string);
+	int size = sizeof(NVGtextRun) + sizeof(NVGtextRunGlyph)*tc->nglyphs + n;
+
+	if (size > tc->maxSize) return;
+	nvg__textCacheTrim(tc, tc->maxSize - size);
+
+	run = (NVGtextRun*)malloc(size);
+	if (run == NULL) return;
+	memset(run, 0, sizeof(NVGtextRun));
+	run->hash = hash;
+	memcpy(run->style, style, sizeof(run->style));
+	run->glyphs = (NVGtextRunGlyph*)&run[1];
+	run->nglyphs = tc->nglyphs;
+	memcpy(run->glyphs, tc->glyphs, sizeof(NVGtextRunGlyph)*tc->nglyphs);
+	run->string = (const char*)&run->glyphs[run->nglyphs];
+	run->nstring = n;
+	memcpy((char*)run->string, string, n);
+	run->dx = dx;
+	run->dy = dy;
+	run->advance = advance;
+	run->generation = generation;
+	run->size = size;
+
+	bucket = &tc->buckets[hash & (NVG_TEXT_CACHE_BUCKETS-1)];
+	run->next = *bucket;
+	*bucket = run;
+	run->lruNext = tc->lruHead;
+	if (tc->lruHead != NULL) tc->lruHead->lruPrev = run;
+	else tc->lruTail = run;
+	tc->lruHead = run;
+	tc->size += size;
+}
+
+// Draws a cached run at x,y in font pixels, like nvgText() does after laying out the string.
+static float nvg__drawTextRun(NVGcontext* ctx, NVGtextRun* run, float x, float y, float scale, NVGvertex* verts, int cverts)
+{
+	float ox = x + run->dx, oy = y + run->dy;
+	float fx = floorf(ox), fy = floorf(oy);
+	float invscale = 1.0f / scale;
+	float c[4*2];
+	FONSquad q;
+	int i, nverts = 0;
+
+	// Glyph quads are snapped to pixels relative to the start of the run, moving the run keeps them the same.
+	for (i = 0; i < run->nglyphs; i++) {
+		const NVGtextRunGlyph* glyph = &run->glyphs[i];
+		q.x0 = fx + glyph->x0;
+		q.y0 = fy + glyph->y0;
+		q.x1 = fx + glyph->x1;
+		q.y1 = fy + glyph->y1;
+		q.s0 = glyph->s0;
+		q.t0 = glyph->t0;
+		q.s1 = glyph->s1;
+		q.t1 = glyph->t1;
+		fonsTouchPage(ctx->fs, glyph->page);
+		if (nvg__textQuadCorners(ctx, c, &q, invscale))
+			nverts = nvg__textQuadVerts(verts, nverts, cverts, c, &q);
+	}
+
+	if (nverts > 0)
+		nvg__renderText(ctx, verts, nverts);
+
+	return (ox + run->advance) / scale;
+}
+
+void nvgTextCacheSize(NVGcontext* ctx, int bytes)
+{
+	NVGtextCache* tc = ctx->textCache;
+	tc->maxSize = nvg__maxi(bytes, 0);
+	nvg__textCacheTrim(tc, tc->maxSize);
+}
+
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
 {
 	NVGstate* state = nvg__getState(ctx);
-	FONStextIter iter, prevIter;
+	NVGtextCache* tc = ctx->textCache;
+	NVGtextRun* run;
+	FONStextIter iter;
 	FONSquad q;
 	NVGvertex* verts;
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
 	float invscale = 1.0f / scale;
+	float ox, oy, c[4*2];
+	int style[NVG_TEXT_STYLE_SIZE];
+	unsigned int hash;
+	int generation, record, bitmapOption;
 	int cverts = 0;
 	int nverts = 0;
 
@@ -2475,43 +5179,63 @@ float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char*
 	verts = nvg__allocTempVerts(ctx, cverts);
 	if (verts == NULL) return x;
 
-	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
-	prevIter = iter;
+	style[0] = state->fontId;
+	style[1] = nvg__floatBits(state->fontSize*scale);
+	style[2] = nvg__floatBits(state->letterSpacing*scale);
+	style[3] = nvg__floatBits(state->fontBlur*scale);
+	style[4] = state->textAlign;
+	hash = nvg__textRunHash(style, string, end);
+	run = nvg__textCacheFind(ctx, hash, style, string, end);
+	if (run != NULL)
+		return nvg__drawTextRun(ctx, run, x*scale, y*scale, scale, verts, cverts);
+
+	// Lay out the string, and keep the glyphs in the cache if all of them could be drawn.
+	record = tc->maxSize > 0;
+	tc->nglyphs = 0;
+	generation = fonsAtlasGeneration(ctx->fs);
+	bitmapOption = ctx->asyncGlyphs ? FONS_GLYPH_BITMAP_DEFERRED : FONS_GLYPH_BITMAP_REQUIRED;
+
+	// The quads are laid out without bitmaps, culled glyphs are never rasterized or added to the atlas.
+	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_OPTIONAL);
+	ox = iter.x;
+	oy = iter.y;
 	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
-		float c[4*2];
 		if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
+			record = 0;
+			continue;
+		}
+		// Culled glyphs get no bitmap, so a run with any of them is not cached.
+		if (!nvg__textQuadCorners(ctx, c, &q, invscale)) {
+			record = 0;
+			continue;
+		}
+		if (!fonsTextIterGlyph(ctx->fs, &iter, &q, bitmapOption)) { // atlas full?
+			record = 0;
 			if (nverts != 0) {
 				nvg__renderText(ctx, verts, nverts);
 				nverts = 0;
 			}
 			if (!nvg__allocTextAtlas(ctx))
 				break; // no memory :(
-			iter = prevIter;
-			fonsTextIterNext(ctx->fs, &iter, &q); // try again
-			if (iter.prevGlyphIndex == -1) // still can not find glyph?
+			if (!fonsTextIterGlyph(ctx->fs, &iter, &q, bitmapOption)) // still can not fit the glyph?
 				break;
 		}
-		prevIter = iter;
-		// Transform corners.
-		nvgTransformPoint(&c[0],&c[1], state->xform, q.x0*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[2],&c[3], state->xform, q.x1*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[4],&c[5], state->xform, q.x1*invscale, q.y1*invscale);
-		nvgTransformPoint(&c[6],&c[7], state->xform, q.x0*invscale, q.y1*invscale);
-		// Create triangles
-		if (nverts+6 <= cverts) {
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[2], c[3], q.s1, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[6], c[7], q.s0, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+		// Skip glyphs the glyph thread is still rasterizing.
+		if (iter.pending) {
+			ctx->pendingGlyphCount++;
+			record = 0;
+			continue;
 		}
+		if (record)
+			record = nvg__textCacheAddGlyph(tc, &q, iter.page, fonsPageGeneration(ctx->fs, iter.page), floorf(ox), floorf(oy));
+		nverts = nvg__textQuadVerts(verts, nverts, cverts, c, &q);
 	}
 
-	// TODO: add back-end bit to do this just once per frame.
-	nvg__flushTextTexture(ctx);
+	if (nverts > 0)
+		nvg__renderText(ctx, verts, nverts);
 
-	nvg__renderText(ctx, verts, nverts);
+	if (record && generation == fonsAtlasGeneration(ctx->fs))
+		nvg__textCacheAdd(tc, hash, style, string, end, ox - x*scale, oy - y*scale, iter.nextx - ox, generation);
 
 	return iter.nextx / scale;
 }
@@ -0,0 +1,244 @@
+//
+// Checks that growing the glyph atlas keeps the cached glyphs.
+//
+// The textures of a stub back-end are kept in memory. Each frame draws a charset at one more size,
+// until the atlas no longer fits it and grows, then the same frame is drawn again. No glyph may be
+// added or rasterized again, which would upload it, each glyph keeps its place in the atlas and its
+// texels, and the texture must match the atlas of fontstash. This is checked with renderCopyTexture,
+// which copies the old texture into the grown one, and without it, when the atlas is uploaded again.
+// The texels uploaded by the frame which grows the atlas are reported. Build and run on the host from
+// the repository root, with any TrueType font:
+//
+//   cc -O2 -Iinclude -Iinclude/nanovg tests/atlas_growth.c -o atlas_growth -lm -lpthread
+//   ./atlas_growth /usr/share/fonts/truetype/dejavu/DejaVuSans.ttf
+//
+
+#include "../source/nanovg.c"
+#include <stdio.h>
+
+#define TEST_TEXTURES 8
+#define TEST_SIZES 32
+#define TEST_COLUMNS 16
+
+typedef struct TESTtexture {
+	int w, h;
+	unsigned char* data;
+} TESTtexture;
+
+static TESTtexture test__textures[TEST_TEXTURES];
+static int test__uploaded = 0;
+
+static int test__renderCreate(void* uptr) { NVG_NOTUSED(uptr); return 1; }
+static void test__renderViewport(void* uptr, float width, float height, float devicePixelRatio) { NVG_NOTUSED(uptr); NVG_NOTUSED(width); NVG_NOTUSED(height); NVG_NOTUSED(devicePixelRatio); }
+static void test__renderCancel(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderFlush(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, const NVGvertex* verts, int nverts, float fringe) { NVG_NOTUSED(uptr); NVG_NOTUSED(paint); NVG_NOTUSED(compositeOperation); NVG_NOTUSED(scissor); NVG_NOTUSED(verts); NVG_NOTUSED(nverts); NVG_NOTUSED(fringe); }
+static void test__renderDelete(void* uptr) { NVG_NOTUSED(uptr); }
+
+// Only alpha textures are created, one byte per texel.
+static int test__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	int i;
+	NVG_NOTUSED(uptr); NVG_NOTUSED(type); NVG_NOTUSED(imageFlags);
+	for (i = 0; i < TEST_TEXTURES; i++) {
+		TESTtexture* tex = &test__textures[i];
+		if (tex->data != NULL)
+			continue;
+		tex->data = (unsigned char*)calloc(w * h, 1);
+		if (tex->data == NULL)
+			return 0;
+		tex->w = w;
+		tex->h = h;
+		if (data != NULL)
+			memcpy(tex->data, data, w * h);
+		return i+1;
+	}
+	return 0;
+}
+
+static int test__renderDeleteTexture(void* uptr, int image)
+{
+	NVG_NOTUSED(uptr);
+	free(test__textures[image-1].data);
+	memset(&test__textures[image-1], 0, sizeof(TESTtexture));
+	return 1;
+}
+
+// The data is the whole texture, as in the other back-ends.
+static int test__renderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	TESTtexture* tex = &test__textures[image-1];
+	int i;
+	NVG_NOTUSED(uptr);
+	for (i = y; i < y+h; i++)
+		memcpy(&tex->data[i*tex->w + x], &data[i*tex->w + x], w);
+	test__uploaded += w * h;
+	return 1;
+}
+
+static int test__renderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	NVG_NOTUSED(uptr);
+	*w = test__textures[image-1].w;
+	*h = test__textures[image-1].h;
+	return 1;
+}
+
+static int test__renderCopyTexture(void* uptr, int dst, int src, int w, int h)
+{
+	TESTtexture* d = &test__textures[dst-1];
+	TESTtexture* s = &test__textures[src-1];
+	int i;
+	NVG_NOTUSED(uptr);
+	for (i = 0; i < h; i++)
+		memcpy(&d->data[i*d->w], &s->data[i*s->w], w);
+	return 1;
+}
+
+static float test__size(int i) { return 12.0f + i * 4.0f; }
+
+// Draws the printable ASCII charset at the first nsizes sizes, in rows which fit the viewport so that no
+// glyph is culled. Every glyph is drawn each frame, otherwise its atlas page may be reused before the atlas grows.
+static void test__frame(NVGcontext* vg, int nsizes)
+{
+	char charset[96];
+	float y = 0;
+	int i, j;
+	for (i = 0; i < 94; i++)
+		charset[i] = (char)(33 + i);
+	charset[94] = '\0';
+
+	nvgBeginFrame(vg, 2048, 2048, 1.0f);
+	nvgFontFace(vg, "sans");
+	nvgFillColor(vg, nvgRGBA(255, 255, 255, 255));
+	for (j = 0; j < nsizes; j++) {
+		nvgFontSize(vg, test__size(j));
+		for (i = 0; i < 94; i += TEST_COLUMNS) {
+			y += test__size(j);
+			nvgText(vg, 10, y, &charset[i], &charset[nvg__mini(i + TEST_COLUMNS, 94)]);
+		}
+	}
+	nvgEndFrame(vg);
+}
+
+// Returns the number of texels of the cached glyphs which differ from the saved texture.
+static int test__compareGlyphs(const FONSfont* font, int nglyphs, const FONSglyph* glyphs, const unsigned char* data, int w, const TESTtexture* tex)
+{
+	int i, x, y, wrong = 0;
+	for (i = 0; i < nglyphs; i++) {
+		const FONSglyph* g = &glyphs[i];
+		const FONSglyph* n = &font->glyphs[i];
+		if (n->codepoint != g->codepoint || n->size != g->size || n->x0 != g->x0 || n->y0 != g->y0 || n->x1 != g->x1 || n->y1 != g->y1) {
+			wrong += (g->x1 - g->x0) * (g->y1 - g->y0);
+			continue;
+		}
+		for (y = g->y0; y < g->y1; y++)
+			for (x = g->x0; x < g->x1; x++)
+				wrong += data[y*w + x] != tex->data[y*tex->w + x];
+	}
+	return wrong;
+}
+
+// Grows the atlas, then draws the sizes which fit before again. Returns 1 if no glyph changed.
+static int test__check(const char* path, int copy)
+{
+	NVGparams params;
+	NVGcontext* vg;
+	FONScontext* fs;
+	FONSfont* font;
+	FONSglyph* glyphs = NULL;
+	TESTtexture* tex;
+	unsigned char* data = NULL;
+	const unsigned char* texData;
+	int id, i, n, ow, oh, w, h, nglyphs = 0, uploaded, wrong = 0, ok = 1;
+
+	memset(test__textures, 0, sizeof(test__textures));
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = test__renderCreate;
+	params.renderViewport = test__renderViewport;
+	params.renderCreateTexture = test__renderCreateTexture;
+	params.renderDeleteTexture = test__renderDeleteTexture;
+	params.renderUpdateTexture = test__renderUpdateTexture;
+	params.renderGetTextureSize = test__renderGetTextureSize;
+	params.renderCopyTexture = copy ? test__renderCopyTexture : NULL;
+	params.renderCancel = test__renderCancel;
+	params.renderFlush = test__renderFlush;
+	params.renderTriangles = test__renderTriangles;
+	params.renderDelete = test__renderDelete;
+
+	vg = nvgCreateInternal(&params);
+	if (vg == NULL) return 0;
+	fs = vg->fs;
+	id = nvgCreateFont(vg, "sans", path);
+	if (id == FONS_INVALID) {
+		printf("could not load %s\n", path);
+		nvgDeleteInternal(vg);
+		return 0;
+	}
+	font = fs->fonts[id];
+	fonsGetAtlasSize(fs, &ow, &oh);
+
+	// Add a size each frame until the atlas grows, saving the glyphs and the texture before each frame.
+	for (n = 1; n <= TEST_SIZES; n++) {
+		tex = &test__textures[vg->fontImages[vg->fontImageIdx]-1];
+		free(glyphs);
+		free(data);
+		nglyphs = font->nglyphs;
+		glyphs = (FONSglyph*)malloc(sizeof(FONSglyph) * (nglyphs + 1));
+		data = (unsigned char*)malloc(tex->w * tex->h);
+		if (glyphs == NULL || data == NULL) {
+			ok = 0;
+			break;
+		}
+		memcpy(glyphs, font->glyphs, sizeof(FONSglyph) * nglyphs);
+		memcpy(data, tex->data, tex->w * tex->h);
+		test__uploaded = 0;
+		test__frame(vg, n);
+		fonsGetAtlasSize(fs, &w, &h);
+		if (w != ow || h != oh)
+			break;
+	}
+	if (!ok || n > TEST_SIZES) {
+		printf("%-8s the atlas did not grow\n", copy ? "copy" : "upload");
+		ok = 0;
+	} else {
+		// Drawing the same glyphs again must not add or rasterize any.
+		int added = font->nglyphs, drawn;
+		uploaded = test__uploaded;
+		test__uploaded = 0;
+		test__frame(vg, n);
+		drawn = test__uploaded;
+		added = font->nglyphs - added;
+
+		// nvgEndFrame() keeps only the grown texture, which must hold the whole atlas.
+		tex = &test__textures[vg->fontImages[vg->fontImageIdx]-1];
+		texData = fonsGetTextureData(fs, &w, &h);
+		wrong = test__compareGlyphs(font, nglyphs, glyphs, data, ow, tex);
+		if (tex->w != w || tex->h != h)
+			wrong += w * h;
+		else
+			for (i = 0; i < w*h; i++)
+				wrong += texData[i] != tex->data[i];
+
+		ok = added == 0 && drawn == 0 && wrong == 0;
+		printf("%-8s %dx%d -> %dx%d after %d sizes, %d glyphs kept, %d added, %d texels uploaded while growing, %d after, %d wrong\n",
+			   copy ? "copy" : "upload", ow, oh, w, h, n, nglyphs, added, uploaded, drawn, wrong);
+	}
+
+	free(glyphs);
+	free(data);
+	nvgDeleteInternal(vg);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = argc > 1 ? argv[1] : "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+	int ok = 1;
+
+	ok &= test__check(path, 1);
+	ok &= test__check(path, 0);
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+//
+// Compares nvg__tesselateBezier against the recursive subdivision flattener it replaced.
+//
+// Each curve is flattened by both methods at device pixel ratios 1 and 2. The point count, the
+// maximum deviation from exact samples of the curve and the host CPU time are reported.
+// Build and run on the host from the repository root:
+//
+//   cc -O2 -Iinclude -Iinclude/nanovg tests/bezier_flatten.c -o bezier_flatten -lm -lpthread
+//   ./bezier_flatten
+//
+
+#include "../source/nanovg.c"
+#include <stdio.h>
+#include <time.h>
+
+#define TEST_SAMPLES 20000
+#define TEST_ITERATIONS 20000
+#define TEST_RUNS 5
+
+static int test__renderCreate(void* uptr) { NVG_NOTUSED(uptr); return 1; }
+static void test__renderViewport(void* uptr, float width, float height, float devicePixelRatio) { NVG_NOTUSED(uptr); NVG_NOTUSED(width); NVG_NOTUSED(height); NVG_NOTUSED(devicePixelRatio); }
+static int test__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data) { NVG_NOTUSED(uptr); NVG_NOTUSED(type); NVG_NOTUSED(w); NVG_NOTUSED(h); NVG_NOTUSED(imageFlags); NVG_NOTUSED(data); return 1; }
+static int test__renderDeleteTexture(void* uptr, int image) { NVG_NOTUSED(uptr); NVG_NOTUSED(image); return 1; }
+static void test__renderCancel(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderFlush(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderDelete(void* uptr) { NVG_NOTUSED(uptr); }
+
+// The flattener used before the parabola approximation.
+static void test__tesselateBezierRecursive(NVGcontext* ctx,
+										   float x1, float y1, float x2, float y2,
+										   float x3, float y3, float x4, float y4,
+										   int level, int type)
+{
+	float x12,y12,x23,y23,x34,y34,x123,y123,x234,y234,x1234,y1234;
+	float dx,dy,d2,d3;
+
+	if (level > 10) return;
+
+	x12 = (x1+x2)*0.5f;
+	y12 = (y1+y2)*0.5f;
+	x23 = (x2+x3)*0.5f;
+	y23 = (y2+y3)*0.5f;
+	x34 = (x3+x4)*0.5f;
+	y34 = (y3+y4)*0.5f;
+	x123 = (x12+x23)*0.5f;
+	y123 = (y12+y23)*0.5f;
+
+	dx = x4 - x1;
+	dy = y4 - y1;
+	d2 = nvg__absf(((x2 - x4) * dy - (y2 - y4) * dx));
+	d3 = nvg__absf(((x3 - x4) * dy - (y3 - y4) * dx));
+
+	if ((d2 + d3)*(d2 + d3) < ctx->tessTol * (dx*dx + dy*dy)) {
+		nvg__addPoint(ctx, x4, y4, type);
+		return;
+	}
+
+	x234 = (x23+x34)*0.5f;
+	y234 = (y23+y34)*0.5f;
+	x1234 = (x123+x234)*0.5f;
+	y1234 = (y123+y234)*0.5f;
+
+	test__tesselateBezierRecursive(ctx, x1,y1, x12,y12, x123,y123, x1234,y1234, level+1, 0);
+	test__tesselateBezierRecursive(ctx, x1234,y1234, x234,y234, x34,y34, x4,y4, level+1, type);
+}
+
+static void test__flatten(NVGcontext* ctx, const float* c, int recursive)
+{
+	nvg__clearPathCache(ctx);
+	nvg__addPath(ctx);
+	nvg__addPoint(ctx, c[0], c[1], NVG_PT_CORNER);
+	if (recursive)
+		test__tesselateBezierRecursive(ctx, c[0],c[1], c[2],c[3], c[4],c[5], c[6],c[7], 0, NVG_PT_CORNER);
+	else
+		nvg__tesselateBezier(ctx, c[0],c[1], c[2],c[3], c[4],c[5], c[6],c[7], NVG_PT_CORNER);
+}
+
+static double test__segmentDistance(double px, double py, double ax, double ay, double bx, double by)
+{
+	double dx = bx - ax, dy = by - ay, l = dx*dx + dy*dy;
+	double t = l > 0.0 ? ((px - ax)*dx + (py - ay)*dy) / l : 0.0;
+	t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+	dx = ax + t*dx - px;
+	dy = ay + t*dy - py;
+	return sqrt(dx*dx + dy*dy);
+}
+
+// Returns the maximum distance of the exact curve from the flattened polyline.
+static double test__deviation(NVGcontext* ctx, const float* c, int* npoints)
+{
+	NVGpoints pts = nvg__pathPoints(ctx->cache, 0);
+	int n = ctx->cache->npoints, i, k;
+	double maxDist = 0.0;
+
+	*npoints = n - 1;
+	for (k = 0; k <= TEST_SAMPLES; k++) {
+		double t = (double)k / TEST_SAMPLES, u = 1.0 - t, best = 1e30;
+		double x = u*u*u*c[0] + 3.0*u*u*t*c[2] + 3.0*u*t*t*c[4] + t*t*t*c[6];
+		double y = u*u*u*c[1] + 3.0*u*u*t*c[3] + 3.0*u*t*t*c[5] + t*t*t*c[7];
+		for (i = 0; i+1 < n; i++) {
+			double dist = test__segmentDistance(x, y, pts.x[i], pts.y[i], pts.x[i+1], pts.y[i+1]);
+			if (dist < best) best = dist;
+		}
+		if (best > maxDist) maxDist = best;
+	}
+	return maxDist;
+}
+
+// Returns the fastest of a few runs in nanoseconds per curve, the host is not otherwise idle.
+static double test__time(NVGcontext* ctx, const float (*curves)[8], int ncurves, int recursive)
+{
+	double best = 1e30;
+	int run, i, j;
+	for (run = 0; run < TEST_RUNS; run++) {
+		clock_t t0 = clock();
+		double t;
+		for (i = 0; i < TEST_ITERATIONS; i++)
+			for (j = 0; j < ncurves; j++)
+				test__flatten(ctx, curves[j], recursive);
+		t = (double)(clock() - t0) / CLOCKS_PER_SEC * 1e9 / ((double)TEST_ITERATIONS * ncurves);
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+int main(void)
+{
+	static const float curves[][8] = {
+		{ 0,0, 100,0, 200,0, 300,0 },
+		{ 0,0, 0,5.52f, 4.48f,10, 10,10 },
+		{ 0,0, 0,27.6f, 22.4f,50, 50,50 },
+		{ 0,0, 1000,0, 1000,1000, 0,1000 },
+		{ 0,0, 2000,500, -1000,500, 1000,0 },
+		{ 0,0, 5,10, 15,10, 20,0 },
+		{ 0,0, 4000,50, 8000,-50, 12000,0 },
+		{ 0,0, 300,300, 0,300, 300,0 },
+		{ 0,0, 500,0, 500,0, 500,500 },
+		{ 10,10, 12,30, 40,12, 50,50 },
+	};
+	static const char* names[] = {
+		"line", "corner r10", "corner r50", "large loop", "cusp", "tiny", "gentle long", "s-curve", "corner", "random",
+	};
+	static const float ratios[] = { 1.0f, 2.0f };
+	const int ncurves = (int)(sizeof(curves) / sizeof(curves[0]));
+	NVGparams params;
+	NVGcontext* ctx;
+	int i, r, ok = 1;
+
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = test__renderCreate;
+	params.renderViewport = test__renderViewport;
+	params.renderCreateTexture = test__renderCreateTexture;
+	params.renderDeleteTexture = test__renderDeleteTexture;
+	params.renderCancel = test__renderCancel;
+	params.renderFlush = test__renderFlush;
+	params.renderDelete = test__renderDelete;
+
+	ctx = nvgCreateInternal(&params);
+	if (ctx == NULL) return 1;
+
+	for (r = 0; r < 2; r++) {
+		int total[2] = { 0, 0 };
+		double worst[2] = { 0.0, 0.0 };
+		nvgBeginFrame(ctx, 1280, 720, ratios[r]);
+		for (i = 0; i < ncurves; i++) {
+			int n0, n1;
+			double d0, d1;
+			test__flatten(ctx, curves[i], 1);
+			d0 = test__deviation(ctx, curves[i], &n0);
+			test__flatten(ctx, curves[i], 0);
+			d1 = test__deviation(ctx, curves[i], &n1);
+			printf("ratio %.0f %-12s recursive %4d points, deviation %.3f | parabola %4d points, deviation %.3f\n",
+				   ratios[r], names[i], n0, d0, n1, d1);
+			total[0] += n0;
+			total[1] += n1;
+			if (d0 > worst[0]) worst[0] = d0;
+			if (d1 > worst[1]) worst[1] = d1;
+		}
+		printf("ratio %.0f total     recursive %4d points, deviation %.3f | parabola %4d points, deviation %.3f\n",
+			   ratios[r], total[0], worst[0], total[1], worst[1]);
+		printf("ratio %.0f time      recursive %.1f ns/curve | parabola %.1f ns/curve\n",
+			   ratios[r], test__time(ctx, curves, ncurves, 1), test__time(ctx, curves, ncurves, 0));
+		// The parabola approximation must not use more points or exceed the old error.
+		ok &= total[1] <= total[0] && (worst[1] <= worst[0] || worst[1] <= sqrtf(ctx->tessTol));
+		nvgCancelFrame(ctx);
+	}
+
+	nvgDeleteInternal(ctx);
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+//
+// Compares the vector glyph blur of fontstash against the scalar one used with FONS_NO_SIMD.
+//
+// Random bitmaps are blurred by both versions at radii 1 to 20, including widths and heights which
+// are below or not a multiple of the 8 lanes, inside a wider atlas so that the texels next to the
+// bitmap must stay untouched. Every pass and the whole blur must give the same texels. The host CPU
+// time of both versions is reported for a few glyph sizes. Without SSE2 or NEON there is nothing to
+// compare and the test is skipped. Build and run on the host from the repository root:
+//
+//   cc -O2 -Iinclude -Iinclude/nanovg tests/glyph_blur.c -o glyph_blur -lm -lpthread
+//   ./glyph_blur
+//
+
+#include "../source/nanovg.c"
+#include <stdio.h>
+#include <time.h>
+
+#define TEST_MAX_BLUR 20
+#define TEST_BORDER 5
+#define TEST_ITERATIONS 2000
+#define TEST_RUNS 5
+
+#if defined(FONS_SIMD_NEON) || defined(FONS_SIMD_SSE2)
+
+static unsigned int test__seed = 1;
+
+static unsigned char test__random(void)
+{
+	test__seed = test__seed * 1103515245u + 12345u;
+	return (unsigned char)(test__seed >> 16);
+}
+
+static double test__now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Same as fons__blur().
+static int test__alpha(int blur)
+{
+	float sigma = (float)blur * 0.57735f;
+	return (int)((1<<APREC) * (1.0f - expf(-2.3f / (sigma+1.0f))));
+}
+
+// The blur of fons__blur() built with FONS_NO_SIMD.
+static void test__blurScalar(unsigned char* dst, int w, int h, int dstStride, int blur)
+{
+	int alpha = test__alpha(blur);
+	fons__blurRows(dst, w, h, dstStride, alpha);
+	fons__blurCols(dst, w, h, dstStride, alpha);
+	fons__blurRows(dst, w, h, dstStride, alpha);
+	fons__blurCols(dst, w, h, dstStride, alpha);
+}
+
+// Blurs a random w x h bitmap in an atlas with both versions. Returns the number of texels which differ.
+static int test__compare(int w, int h, int blur)
+{
+	int stride = w + TEST_BORDER*2, size = stride * (h + TEST_BORDER*2);
+	int alpha = test__alpha(blur), i, pass, wrong = 0;
+	unsigned char* a = (unsigned char*)malloc(size);
+	unsigned char* b = (unsigned char*)malloc(size);
+	unsigned char* pa = &a[TEST_BORDER*stride + TEST_BORDER];
+	unsigned char* pb = &b[TEST_BORDER*stride + TEST_BORDER];
+	if (a == NULL || b == NULL) {
+		free(a);
+		free(b);
+		return size;
+	}
+
+	// Each pass on its own.
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < size; i++)
+			a[i] = b[i] = test__random();
+		if (pass == 0) {
+			fons__blurRowsSimd(pa, w, h, stride, alpha);
+			fons__blurRows(pb, w, h, stride, alpha);
+		} else {
+			fons__blurColsSimd(pa, w, h, stride, alpha);
+			fons__blurCols(pb, w, h, stride, alpha);
+		}
+		for (i = 0; i < size; i++)
+			wrong += a[i] != b[i];
+	}
+
+	// The whole blur.
+	for (i = 0; i < size; i++)
+		a[i] = b[i] = test__random();
+	fons__blur(NULL, pa, w, h, stride, blur);
+	test__blurScalar(pb, w, h, stride, blur);
+	for (i = 0; i < size; i++)
+		wrong += a[i] != b[i];
+
+	free(a);
+	free(b);
+	return wrong;
+}
+
+// Returns the fastest time of one blur in microseconds.
+static double test__time(int w, int h, int blur, int simd)
+{
+	unsigned char* data = (unsigned char*)malloc(w * h);
+	double best = 1e30;
+	int i, run;
+	if (data == NULL) return 0.0;
+	for (run = 0; run < TEST_RUNS; run++) {
+		double t0, t;
+		for (i = 0; i < w*h; i++)
+			data[i] = test__random();
+		t0 = test__now();
+		for (i = 0; i < TEST_ITERATIONS; i++) {
+			if (simd)
+				fons__blur(NULL, data, w, h, w, blur);
+			else
+				test__blurScalar(data, w, h, w, blur);
+		}
+		t = (test__now() - t0) * 1e6 / TEST_ITERATIONS;
+		if (t < best) best = t;
+	}
+	free(data);
+	return best;
+}
+
+int main(void)
+{
+	static const int sizes[] = { 1, 2, 3, 5, 7, 8, 9, 13, 15, 16, 17, 24, 31, 33, 64, 70 };
+	static const int glyphs[][3] = { { 20, 24, 2 }, { 40, 48, 5 }, { 72, 80, 10 }, { 140, 150, 20 } };
+	int nsizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
+	int i, j, blur, wrong = 0, cases = 0;
+
+	for (blur = 1; blur <= TEST_MAX_BLUR; blur++) {
+		for (i = 0; i < nsizes; i++) {
+			for (j = 0; j < nsizes; j++) {
+				int n = test__compare(sizes[i], sizes[j], blur);
+				if (n != 0 && wrong == 0)
+					printf("first difference at %dx%d blur %d, %d texels\n", sizes[i], sizes[j], blur, n);
+				wrong += n;
+				cases++;
+			}
+		}
+	}
+	printf("%d bitmaps, radius 1 to %d, %d texels differ\n", cases, TEST_MAX_BLUR, wrong);
+
+	for (i = 0; i < (int)(sizeof(glyphs) / sizeof(glyphs[0])); i++) {
+		int w = glyphs[i][0], h = glyphs[i][1];
+		double scalar = test__time(w, h, glyphs[i][2], 0);
+		double simd = test__time(w, h, glyphs[i][2], 1);
+		printf("%3dx%-3d blur %2d: scalar %7.2f us, simd %7.2f us, %.2fx\n", w, h, glyphs[i][2], scalar, simd, scalar / simd);
+	}
+
+	printf("%s\n", wrong == 0 ? "PASS" : "FAIL");
+	return wrong == 0 ? 0 : 1;
+}
+
+#else
+
+int main(void)
+{
+	printf("built without the vector blur, nothing to compare\n");
+	printf("SKIP\n");
+	return 0;
+}
+
+#endif
@@ -0,0 +1,127 @@
+//
+// Checks and times the glyph lookup of fontstash with 20000 cached glyphs.
+//
+// 2000 codepoints are cached at 10 sizes, which doubles the hash lookup of the font several times.
+// Every lookup must return the glyph of its codepoint and size, and looking a glyph up again must
+// not add another one, also after fonsResetFallbackFont() and fonsResetAtlas() reset the lookup.
+// The time to cache the glyphs and the time per lookup of a cached glyph are reported.
+// Build and run on the host from the repository root, with any TrueType font:
+//
+//   cc -O2 -Iinclude -Iinclude/nanovg tests/glyph_lookup.c -o glyph_lookup -lm -lpthread
+//   ./glyph_lookup /usr/share/fonts/truetype/dejavu/DejaVuSans.ttf
+//
+
+#include "../source/nanovg.c"
+#include <stdio.h>
+#include <time.h>
+
+#define TEST_CODEPOINTS 2000
+#define TEST_SIZES 10
+#define TEST_GLYPHS (TEST_CODEPOINTS*TEST_SIZES)
+#define TEST_RUNS 5
+
+static int test__renderCreate(void* uptr) { NVG_NOTUSED(uptr); return 1; }
+static void test__renderViewport(void* uptr, float width, float height, float devicePixelRatio) { NVG_NOTUSED(uptr); NVG_NOTUSED(width); NVG_NOTUSED(height); NVG_NOTUSED(devicePixelRatio); }
+static int test__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data) { NVG_NOTUSED(uptr); NVG_NOTUSED(type); NVG_NOTUSED(w); NVG_NOTUSED(h); NVG_NOTUSED(imageFlags); NVG_NOTUSED(data); return 1; }
+static int test__renderDeleteTexture(void* uptr, int image) { NVG_NOTUSED(uptr); NVG_NOTUSED(image); return 1; }
+static int test__renderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data) { NVG_NOTUSED(uptr); NVG_NOTUSED(image); NVG_NOTUSED(x); NVG_NOTUSED(y); NVG_NOTUSED(w); NVG_NOTUSED(h); NVG_NOTUSED(data); return 1; }
+static void test__renderCancel(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderFlush(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderDelete(void* uptr) { NVG_NOTUSED(uptr); }
+
+// CJK ideographs, so that the codepoints do not follow the order of the glyphs in the font.
+static unsigned int test__codepoint(int i) { return 0x4e00 + (unsigned int)i * 7; }
+static short test__size(int i) { return (short)(100 + i * 20); }
+
+static double test__now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Looks every glyph up, caching the ones which are missing. Returns the number of wrong glyphs.
+static int test__lookupAll(FONScontext* fs, FONSfont* font)
+{
+	int i, j, wrong = 0;
+	for (i = 0; i < TEST_CODEPOINTS; i++) {
+		for (j = 0; j < TEST_SIZES; j++) {
+			FONSglyph* glyph = fons__getGlyph(fs, font, test__codepoint(i), test__size(j), 0, FONS_GLYPH_BITMAP_OPTIONAL);
+			if (glyph == NULL || glyph->codepoint != test__codepoint(i) || glyph->size != test__size(j) || glyph->blur != 0)
+				wrong++;
+		}
+	}
+	return wrong;
+}
+
+// Caches all glyphs into an empty lookup, then checks them again. Returns 1 if every lookup was right.
+static int test__check(FONScontext* fs, FONSfont* font, const char* name)
+{
+	int clut = font->clut, ok, wrong;
+	double t0 = test__now(), t1;
+
+	wrong = test__lookupAll(fs, font);
+	t1 = test__now();
+	wrong += test__lookupAll(fs, font);
+	ok = wrong == 0 && font->nglyphs == TEST_GLYPHS && font->clut >= TEST_GLYPHS*2;
+	printf("%-14s %d glyphs, lookup %d -> %d slots, %d wrong, %.2f ms to cache\n",
+		   name, font->nglyphs, clut, font->clut, wrong, (t1 - t0) * 1e3);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = argc > 1 ? argv[1] : "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+	NVGparams params;
+	NVGcontext* ctx;
+	FONScontext* fs;
+	FONSfont* font;
+	double best = 1e30;
+	int id, run, w, h, ok = 1;
+
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = test__renderCreate;
+	params.renderViewport = test__renderViewport;
+	params.renderCreateTexture = test__renderCreateTexture;
+	params.renderDeleteTexture = test__renderDeleteTexture;
+	params.renderUpdateTexture = test__renderUpdateTexture;
+	params.renderCancel = test__renderCancel;
+	params.renderFlush = test__renderFlush;
+	params.renderDelete = test__renderDelete;
+
+	ctx = nvgCreateInternal(&params);
+	if (ctx == NULL) return 1;
+	fs = ctx->fs;
+	id = nvgCreateFont(ctx, "sans", path);
+	if (id == FONS_INVALID) {
+		printf("could not load %s\n", path);
+		nvgDeleteInternal(ctx);
+		return 1;
+	}
+	font = fs->fonts[id];
+
+	ok &= test__check(fs, font, "first");
+
+	// Every glyph is cached, time the lookups.
+	for (run = 0; run < TEST_RUNS; run++) {
+		double t0 = test__now(), t;
+		test__lookupAll(fs, font);
+		t = (test__now() - t0) * 1e9 / TEST_GLYPHS;
+		if (t < best) best = t;
+	}
+	printf("lookup         %.1f ns per cached glyph\n", best);
+
+	// The resets empty the lookup but keep its size.
+	fonsResetFallbackFont(fs, id);
+	ok &= font->nglyphs == 0;
+	ok &= test__check(fs, font, "fallback reset");
+
+	fonsGetAtlasSize(fs, &w, &h);
+	fonsResetAtlas(fs, w, h);
+	ok &= font->nglyphs == 0;
+	ok &= test__check(fs, font, "atlas reset");
+
+	nvgDeleteInternal(ctx);
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+//
+// Compares the coverage of hairline strokes against the full stroke expansion.
+//
+// Both expansions of a few strokes one pixel wide are rasterized at pixel centers with the
+// stroke mask of the anti-aliased fill shader, blending each triangle over the previous ones.
+// Build and run on the host from the repository root:
+//
+//   cc -O2 -Iinclude -Iinclude/nanovg tests/hairline_coverage.c -o hairline_coverage -lm -lpthread
+//   ./hairline_coverage
+//
+
+#include "../source/nanovg.c"
+#include <stdio.h>
+
+#define TEST_SIZE 128
+#define TEST_TOLERANCE 0.02f
+
+static int test__renderCreate(void* uptr) { NVG_NOTUSED(uptr); return 1; }
+static void test__renderViewport(void* uptr, float width, float height, float devicePixelRatio) { NVG_NOTUSED(uptr); NVG_NOTUSED(width); NVG_NOTUSED(height); NVG_NOTUSED(devicePixelRatio); }
+static int test__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data) { NVG_NOTUSED(uptr); NVG_NOTUSED(type); NVG_NOTUSED(w); NVG_NOTUSED(h); NVG_NOTUSED(imageFlags); NVG_NOTUSED(data); return 1; }
+static int test__renderDeleteTexture(void* uptr, int image) { NVG_NOTUSED(uptr); NVG_NOTUSED(image); return 1; }
+static void test__renderCancel(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderFlush(void* uptr) { NVG_NOTUSED(uptr); }
+static void test__renderDelete(void* uptr) { NVG_NOTUSED(uptr); }
+
+static float test__edge(const NVGvertex* a, const NVGvertex* b, float x, float y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+// Rasterizes a triangle with the stroke mask of fill_aa_fsh.glsl and blends it into the image.
+static void test__rasterTriangle(float* img, const NVGvertex* v0, const NVGvertex* v1, const NVGvertex* v2, float strokeMult)
+{
+	float area = test__edge(v0, v1, v2->x, v2->y);
+	int x, y, x0, y0, x1, y1;
+	if (nvg__absf(area) < 1e-8f) return;
+	if (area < 0.0f) {
+		const NVGvertex* t = v1;
+		v1 = v2;
+		v2 = t;
+		area = -area;
+	}
+	x0 = nvg__maxi(0, (int)floorf(nvg__minf(v0->x, nvg__minf(v1->x, v2->x))));
+	y0 = nvg__maxi(0, (int)floorf(nvg__minf(v0->y, nvg__minf(v1->y, v2->y))));
+	x1 = nvg__mini(TEST_SIZE-1, (int)ceilf(nvg__maxf(v0->x, nvg__maxf(v1->x, v2->x))));
+	y1 = nvg__mini(TEST_SIZE-1, (int)ceilf(nvg__maxf(v0->y, nvg__maxf(v1->y, v2->y))));
+	for (y = y0; y <= y1; y++) {
+		for (x = x0; x <= x1; x++) {
+			float px = x + 0.5f, py = y + 0.5f;
+			float w0 = test__edge(v1, v2, px, py);
+			float w1 = test__edge(v2, v0, px, py);
+			float w2 = test__edge(v0, v1, px, py);
+			float u, v, a;
+			// Pixel centers on a shared edge belong to one triangle only.
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+			if ((w0 == 0.0f && v1->y <= v2->y) || (w1 == 0.0f && v2->y <= v0->y) || (w2 == 0.0f && v0->y <= v1->y)) continue;
+			u = (w0 * v0->u + w1 * v1->u + w2 * v2->u) / area;
+			v = (w0 * v0->v + w1 * v1->v + w2 * v2->v) / area;
+			a = nvg__minf(1.0f, (1.0f - nvg__absf(u*2.0f - 1.0f)) * strokeMult) * nvg__minf(1.0f, v);
+			img[y*TEST_SIZE + x] = a + img[y*TEST_SIZE + x] * (1.0f - a);
+		}
+	}
+}
+
+static void test__rasterStroke(NVGcontext* ctx, float* img, float strokeWidth)
+{
+	float strokeMult = (strokeWidth*0.5f + ctx->fringeWidth*0.5f) / ctx->fringeWidth;
+	int i, j;
+	memset(img, 0, sizeof(float) * TEST_SIZE * TEST_SIZE);
+	for (i = 0; i < ctx->cache->npaths; i++) {
+		const NVGpath* path = &ctx->cache->paths[i];
+		for (j = 0; j+2 < path->nstroke; j++)
+			test__rasterTriangle(img, &path->stroke[j], &path->stroke[j+1], &path->stroke[j+2], strokeMult);
+	}
+}
+
+static void test__gridLines(NVGcontext* ctx)
+{
+	int i;
+	for (i = 0; i < 6; i++) {
+		nvgMoveTo(ctx, 8.5f + i*20.0f, 4.0f);
+		nvgLineTo(ctx, 8.5f + i*20.0f, 124.0f);
+		nvgMoveTo(ctx, 4.0f, 10.0f + i*20.3f);
+		nvgLineTo(ctx, 124.0f, 10.0f + i*20.3f);
+	}
+}
+
+static void test__polyline(NVGcontext* ctx)
+{
+	int i;
+	nvgMoveTo(ctx, 6.0f, 64.0f);
+	for (i = 1; i < 12; i++)
+		nvgLineTo(ctx, 6.0f + i*10.3f, 64.0f + ((i & 1) ? -30.0f : 30.0f) + i*1.7f);
+}
+
+static void test__rect(NVGcontext* ctx)
+{
+	nvgRect(ctx, 20.5f, 30.5f, 80.0f, 60.0f);
+	nvgRect(ctx, 11.25f, 9.75f, 33.0f, 14.5f);
+}
+
+static void test__circle(NVGcontext* ctx)
+{
+	nvgCircle(ctx, 64.0f, 64.0f, 50.0f);
+	nvgEllipse(ctx, 60.0f, 70.0f, 20.0f, 9.0f);
+}
+
+static int test__compare(NVGcontext* ctx, const char* name, void (*shape)(NVGcontext*), int lineCap)
+{
+	static float ref[TEST_SIZE*TEST_SIZE], hair[TEST_SIZE*TEST_SIZE];
+	NVGstate* state = nvg__getState(ctx);
+	float strokeWidth = ctx->fringeWidth, total = 0.0f, hairTotal = 0.0f, maxDiff = 0.0f;
+	int i, nref, nhair = 0, ndiff = 0;
+
+	nvgBeginPath(ctx);
+	shape(ctx);
+	nvg__flattenPaths(ctx);
+
+	nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, lineCap, state->lineJoin, state->miterLimit);
+	for (i = 0, nref = 0; i < ctx->cache->npaths; i++)
+		nref += ctx->cache->paths[i].nstroke;
+	test__rasterStroke(ctx, ref, strokeWidth);
+
+	nvg__expandHairline(ctx, strokeWidth*0.5f, ctx->fringeWidth, lineCap, state->miterLimit);
+	for (i = 0; i < ctx->cache->npaths; i++)
+		nhair += ctx->cache->paths[i].nstroke;
+	test__rasterStroke(ctx, hair, strokeWidth);
+
+	for (i = 0; i < TEST_SIZE*TEST_SIZE; i++) {
+		float diff = nvg__absf(ref[i] - hair[i]);
+		total += ref[i];
+		hairTotal += hair[i];
+		maxDiff = nvg__maxf(maxDiff, diff);
+		if (diff > TEST_TOLERANCE) ndiff++;
+	}
+
+	printf("%-12s coverage %8.2f / %8.2f, max difference %.4f, %d pixels over %.2f, vertices %d / %d\n",
+		   name, total, hairTotal, maxDiff, ndiff, TEST_TOLERANCE, nref, nhair);
+	return ndiff == 0 && nhair <= nref;
+}
+
+int main(void)
+{
+	NVGparams params;
+	NVGcontext* ctx;
+	int ok = 1;
+
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = test__renderCreate;
+	params.renderViewport = test__renderViewport;
+	params.renderCreateTexture = test__renderCreateTexture;
+	params.renderDeleteTexture = test__renderDeleteTexture;
+	params.renderCancel = test__renderCancel;
+	params.renderFlush = test__renderFlush;
+	params.renderDelete = test__renderDelete;
+	params.edgeAntiAlias = 1;
+
+	ctx = nvgCreateInternal(&params);
+	if (ctx == NULL) return 1;
+
+	nvgBeginFrame(ctx, TEST_SIZE, TEST_SIZE, 1.0f);
+	ok &= test__compare(ctx, "grid lines", test__gridLines, NVG_BUTT);
+	ok &= test__compare(ctx, "square caps", test__gridLines, NVG_SQUARE);
+	ok &= test__compare(ctx, "polyline", test__polyline, NVG_BUTT);
+	ok &= test__compare(ctx, "rects", test__rect, NVG_BUTT);
+	ok &= test__compare(ctx, "circles", test__circle, NVG_BUTT);
+	nvgCancelFrame(ctx);
+
+	nvgDeleteInternal(ctx);
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+//
+// Measures how recording the calls of a frame scales with DkRenderer::SetRecordingThreads().
+//
+// The renderer runs against a stand-in for deko3d in tests/standin, whose command buffers encode
+// each command into memory like the real ones do, so the CPU time of the flush follows the cost of
+// recording. Frames of growing size are flushed with 0 to MaxRecordingThreads recording threads, and
+// the submitted command streams must be the same in every case. MinCallsPerRecordingThread and
+// MaxRecordingThreads have not been tuned on hardware, run this on a multi-core host or port the
+// frame to a device build to tune them. Build and run on the host from the repository root:
+//
+//   cc -O2 -Iinclude -Iinclude/nanovg -c source/nanovg.c -o nanovg.o
+//   c++ -std=c++17 -O2 -Itests/standin -Iinclude -Iinclude/nanovg -Iinclude/nanovg/framework tests/recording_scaling.cpp source/dk_renderer.cpp source/framework/CMemPool.cpp source/framework/CIntrusiveTree.cpp nanovg.o -o recording_scaling -lpthread
+//   ./recording_scaling
+//
+
+#include "nanovg_dk.h"
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+#define TEST_RUNS 10
+#define TEST_THREADS 3
+
+// Shaders are not loaded on the host.
+bool CShader::load(CMemPool &, const char *) { return true; }
+
+// Fills, convex fills and strokes, one call each.
+static void test__frame(NVGcontext *vg, int ncalls)
+{
+    nvgBeginFrame(vg, 1280, 720, 1.0f);
+    for (int i = 0; i < ncalls; i++) {
+        float x = (float)((i * 37) % 1200), y = (float)((i * 91) % 680);
+        nvgBeginPath(vg);
+        if (i % 3 == 0) {
+            nvgRect(vg, x, y, 30, 20);
+        } else if (i % 3 == 1) {
+            nvgCircle(vg, x, y, 12);
+        } else {
+            nvgMoveTo(vg, x, y);
+            nvgLineTo(vg, x + 40, y + 10);
+            nvgLineTo(vg, x + 10, y + 30);
+        }
+        if (i % 3 == 2) {
+            nvgStrokeWidth(vg, 3);
+            nvgStrokeColor(vg, nvgRGBA(0, 0, 0, 255));
+            nvgStroke(vg);
+        } else {
+            nvgFillColor(vg, nvgRGBA(i & 255, 128, 64, 200));
+            nvgFill(vg);
+        }
+    }
+}
+
+// Hashes the submitted commands. Fences are skipped, every list recorded by a thread signals one. Uniforms
+// are pushed padded to whole words, the padding is never written.
+static unsigned int test__hashStream(const std::vector<uint32_t> &stream)
+{
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < stream.size(); i += stream[i] + 1) {
+        size_t end = i + stream[i];
+        if (stream[i+1] == 0) {
+            continue;
+        }
+        if (stream[i+1] == 3) {
+            end = std::min(end, i + 3 + sizeof(DKNVGfragUniforms) / 4);
+        }
+        for (size_t j = i; j <= end; j++) {
+            hash ^= stream[j];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Returns the fastest flush of a few frames in milliseconds, and the hash of the commands of the last one.
+static double test__flush(int threads, int ncalls, unsigned int *hash)
+{
+    dk::Device device;
+    dk::QueueImpl queue_impl;
+    dk::Queue queue;
+    queue.impl = &queue_impl;
+    CMemPool image_pool(device), code_pool(device), data_pool(device);
+    nvg::DkRenderer renderer(1280, 720, device, queue, image_pool, code_pool, data_pool);
+    renderer.SetRecordingThreads(threads);
+
+    NVGcontext *vg = nvgCreateDk(&renderer, NVG_ANTIALIAS | NVG_STENCIL_STROKES);
+    if (vg == NULL) {
+        return 0.0;
+    }
+
+    double best = 1e30;
+    for (int run = 0; run < TEST_RUNS; run++) {
+        test__frame(vg, ncalls);
+        queue_impl.stream.clear();
+        const auto start = std::chrono::steady_clock::now();
+        nvgEndFrame(vg);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, ms);
+    }
+    *hash = test__hashStream(queue_impl.stream);
+
+    nvgDeleteDk(vg);
+    return best;
+}
+
+int main()
+{
+    static const int calls[] = { 128, 256, 512, 1024, 2048, 4096, 16384 };
+    int ok = 1;
+
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    for (int ncalls : calls) {
+        unsigned int hash0 = 0;
+        double ms0 = test__flush(0, ncalls, &hash0);
+        printf("%5d calls: 0 threads %.3f ms", ncalls, ms0);
+        for (int threads = 1; threads <= TEST_THREADS; threads++) {
+            unsigned int hash = 0;
+            double ms = test__flush(threads, ncalls, &hash);
+            printf(" | %d threads %.3f ms %.2fx", threads, ms, ms0 / ms);
+            // Parallel recording must submit the same commands in the same order.
+            ok &= hash == hash0;
+        }
+        printf("\n");
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+//
+// Host stand-in for the parts of deko3d used by the renderer, see tests/recording_scaling.cpp.
+//
+// Command buffers encode each command and its arguments into words, which costs about as much as
+// recording into GPU command memory does. Queues append the words of every submitted list to a
+// stream, so that the output of different recording setups can be compared. Nothing is drawn.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <array>
+#include <initializer_list>
+#include <vector>
+
+#define DK_HPP_SUPPORT_VECTOR
+
+#define DK_GPU_ADDR_INVALID (~(DkGpuAddr)0)
+#define DK_CMDMEM_ALIGNMENT 4
+#define DK_MEMBLOCK_ALIGNMENT 0x1000
+#define DK_UNIFORM_BUF_ALIGNMENT 0x100
+#define DK_IMAGE_DESCRIPTOR_ALIGNMENT 32
+#define DK_SAMPLER_DESCRIPTOR_ALIGNMENT 32
+#define DK_IMAGE_LINEAR_STRIDE_ALIGNMENT 32
+#define DK_SHADER_CODE_ALIGNMENT 0x100
+#define DK_SHADER_CODE_UNUSABLE_SIZE 0x80
+
+typedef uint64_t DkGpuAddr;
+typedef uint32_t DkResHandle;
+typedef uintptr_t DkCmdList;
+
+struct DkImageRect { uint32_t x, y, z, width, height, depth; };
+struct DkCopyBuf { DkGpuAddr addr; uint32_t rowLength; uint32_t imageHeight; };
+struct DkImageDescriptor { uint32_t data[8]; };
+struct DkSamplerDescriptor { uint32_t data[8]; };
+struct DkVtxBufferState { uint32_t stride, divisor; };
+struct DkVtxAttribState { uint32_t bufferId:5, isFixed:1, offset:14, size:6, type:3, pad:1, isBgra:1; };
+struct DkshHeader { uint32_t magic, header_sz, control_sz, code_sz, programs_off, num_programs; };
+
+enum DkVtxAttribSize { DkVtxAttribSize_2x32 = 1 };
+enum DkVtxAttribType { DkVtxAttribType_Float = 7 };
+enum DkStencilOp { DkStencilOp_Keep, DkStencilOp_Zero, DkStencilOp_Incr, DkStencilOp_IncrWrap, DkStencilOp_DecrWrap };
+enum DkCompareOp { DkCompareOp_Always, DkCompareOp_Equal, DkCompareOp_NotEqual };
+enum DkPrimitive { DkPrimitive_Triangles, DkPrimitive_TriangleStrip, DkPrimitive_TriangleFan };
+enum DkFace { DkFace_None, DkFace_Front, DkFace_FrontAndBack };
+enum DkStage { DkStage_Vertex, DkStage_Fragment };
+enum { DkStageFlag_GraphicsMask = 0x1f };
+enum DkBarrier { DkBarrier_None, DkBarrier_Full };
+enum { DkInvalidateFlags_Descriptors = 1, DkInvalidateFlags_Image = 2 };
+enum DkMsMode { DkMsMode_1x, DkMsMode_4x };
+enum DkBlendFactor {
+    DkBlendFactor_Zero, DkBlendFactor_One, DkBlendFactor_SrcColor, DkBlendFactor_InvSrcColor, DkBlendFactor_DstColor,
+    DkBlendFactor_InvDstColor, DkBlendFactor_SrcAlpha, DkBlendFactor_InvSrcAlpha, DkBlendFactor_DstAlpha,
+    DkBlendFactor_InvDstAlpha, DkBlendFactor_SrcAlphaSaturate,
+};
+enum DkImageFormat { DkImageFormat_RGBA8_Unorm, DkImageFormat_R8_Unorm, DkImageFormat_Z24S8 };
+enum { DkImageFlags_UsageRender = 1, DkImageFlags_HwCompression = 2 };
+enum DkFilter { DkFilter_Nearest, DkFilter_Linear };
+enum DkMipFilter { DkMipFilter_None, DkMipFilter_Nearest, DkMipFilter_Linear };
+enum DkWrapMode { DkWrapMode_Repeat, DkWrapMode_ClampToEdge };
+enum { DkColorMask_RGBA = 0xf };
+enum { DkMemBlockFlags_CpuUncached = 1, DkMemBlockFlags_GpuCached = 2, DkMemBlockFlags_Code = 4 };
+
+static inline DkResHandle dkMakeTextureHandle(uint32_t image, uint32_t sampler) { return image | (sampler << 20); }
+
+namespace dk {
+
+    struct Device {};
+
+    class MemBlock {
+        public:
+            std::vector<uint8_t> *mem = nullptr;
+
+            void *getCpuAddr() const { return mem->data(); }
+            DkGpuAddr getGpuAddr() const { return (DkGpuAddr)(uintptr_t)mem->data(); }
+            uint32_t getSize() const { return mem->size(); }
+            void destroy() { delete mem; mem = nullptr; }
+            operator bool() const { return mem != nullptr; }
+    };
+
+    struct MemBlockMaker {
+        uint32_t size;
+
+        MemBlockMaker(Device, uint32_t size) : size(size) {}
+        MemBlockMaker &setFlags(uint32_t) { return *this; }
+        MemBlock create() { MemBlock block; block.mem = new std::vector<uint8_t>(size); return block; }
+    };
+
+    struct Fence {
+        void wait() {}
+    };
+
+    struct ImageLayout {
+        uint32_t width = 0, height = 0;
+
+        uint32_t getSize() const { return 64; }
+        uint32_t getAlignment() const { return 32; }
+    };
+
+    struct ImageLayoutMaker {
+        uint32_t width = 0, height = 0;
+
+        ImageLayoutMaker(Device) {}
+        ImageLayoutMaker &setFlags(uint32_t) { return *this; }
+        ImageLayoutMaker &setFormat(DkImageFormat) { return *this; }
+        ImageLayoutMaker &setMsMode(DkMsMode) { return *this; }
+        ImageLayoutMaker &setDimensions(uint32_t w, uint32_t h, uint32_t = 1) { width = w; height = h; return *this; }
+        void initialize(ImageLayout &layout) { layout.width = width; layout.height = height; }
+    };
+
+    struct Image {
+        void initialize(ImageLayout const &, MemBlock, uint32_t) {}
+    };
+
+    struct ImageView {
+        ImageView(Image &) {}
+    };
+
+    struct ImageDescriptor : DkImageDescriptor {
+        void initialize(Image const &) {}
+    };
+
+    struct Sampler {
+        Sampler &setFilter(DkFilter, DkFilter, DkMipFilter) { return *this; }
+        Sampler &setWrapMode(DkWrapMode, DkWrapMode) { return *this; }
+    };
+
+    struct SamplerDescriptor : DkSamplerDescriptor {
+        void initialize(Sampler const &) {}
+    };
+
+    struct Shader {};
+
+    struct ShaderMaker {
+        ShaderMaker(MemBlock, uint32_t) {}
+        ShaderMaker &setControl(const void *) { return *this; }
+        ShaderMaker &setProgramId(uint32_t) { return *this; }
+        void initialize(Shader &) {}
+    };
+
+    /* Render states are folded into a single word. */
+    struct DepthStencilState {
+        uint32_t value = 0;
+
+        DepthStencilState &setStencilTestEnable(bool enable) { value ^= enable; return *this; }
+        DepthStencilState &setStencilFrontCompareOp(int op) { value = value * 31 + op; return *this; }
+        DepthStencilState &setStencilFrontFailOp(int op) { value = value * 31 + op; return *this; }
+        DepthStencilState &setStencilFrontDepthFailOp(int op) { value = value * 31 + op; return *this; }
+        DepthStencilState &setStencilFrontPassOp(int op) { value = value * 31 + op; return *this; }
+        DepthStencilState &setStencilBackCompareOp(int op) { value = value * 31 + op; return *this; }
+        DepthStencilState &setStencilBackFailOp(int op) { value = value * 31 + op; return *this; }
+        DepthStencilState &setStencilBackDepthFailOp(int op) { value = value * 31 + op; return *this; }
+        DepthStencilState &setStencilBackPassOp(int op) { value = value * 31 + op; return *this; }
+    };
+
+    struct ColorWriteState {
+        uint32_t value = 0xff;
+
+        ColorWriteState &setMask(int, int mask) { value = mask; return *this; }
+    };
+
+    struct ColorState {
+        uint32_t value = 0;
+
+        ColorState &setBlendEnable(int, bool enable) { value = enable; return *this; }
+    };
+
+    struct RasterizerState {
+        uint32_t value = 0;
+
+        RasterizerState &setCullMode(DkFace face) { value = face; return *this; }
+    };
+
+    struct MultisampleState {
+        uint32_t value = 0;
+
+        MultisampleState &setMode(DkMsMode mode) { value = mode; return *this; }
+        MultisampleState &setLocations() { return *this; }
+    };
+
+    struct BlendState {
+        uint32_t value = 0;
+
+        BlendState &setFactors(DkBlendFactor a, DkBlendFactor b, DkBlendFactor c, DkBlendFactor d) { value = a | b << 8 | c << 16 | d << 24; return *this; }
+    };
+
+    struct Viewport { float x, y, width, height, near, far; };
+    struct Scissor { uint32_t x, y, width, height; };
+
+    /* Words recorded into a command buffer since the last finished list. */
+    struct CmdList {
+        const std::vector<uint32_t> *words;
+        size_t begin, end;
+    };
+
+    struct CmdBufImpl {
+        std::vector<uint32_t> words;
+        size_t list_start = 0;
+        std::vector<CmdList *> lists;
+    };
+
+    class CmdBuf {
+        public:
+            CmdBufImpl *impl = nullptr;
+
+            /* Each command is its word count, its opcode and arguments, and any inline data. */
+            void emit(std::initializer_list<uint32_t> words, const void *data = nullptr, size_t size = 0) {
+                impl->words.push_back(words.size() + size / 4);
+                for (uint32_t word : words) impl->words.push_back(word);
+                for (size_t i = 0; i < size / 4; i++) impl->words.push_back(((const uint32_t *)data)[i]);
+            }
+
+            void clear() { impl->words.clear(); impl->list_start = 0; for (auto list : impl->lists) delete list; impl->lists.clear(); }
+            void addMemory(MemBlock, uint32_t, uint32_t) {}
+            DkCmdList finishList() {
+                auto list = new CmdList{&impl->words, impl->list_start, impl->words.size()};
+                impl->lists.push_back(list);
+                impl->list_start = impl->words.size();
+                return (DkCmdList)list;
+            }
+
+            void signalFence(Fence &) { emit({0}); }
+            void barrier(DkBarrier, uint32_t flags) { emit({1, flags}); }
+            void pushData(DkGpuAddr, const void *data, uint32_t size) { emit({2, size}, data, size); }
+            void pushConstants(DkGpuAddr, uint32_t, uint32_t offset, uint32_t size, const void *data) { emit({3, offset, size}, data, size); }
+            void bindUniformBuffer(DkStage stage, uint32_t id, DkGpuAddr, uint32_t size) { emit({4, (uint32_t)stage, id, size}); }
+            void bindTextures(DkStage stage, uint32_t id, DkResHandle handle) { emit({5, (uint32_t)stage, id, handle}); }
+            void bindDepthStencilState(DepthStencilState const &state) { emit({6, state.value}); }
+            void bindColorWriteState(ColorWriteState const &state) { emit({7, state.value}); }
+            void bindColorState(ColorState const &state) { emit({8, state.value}); }
+            void bindRasterizerState(RasterizerState const &state) { emit({9, state.value}); }
+            void bindMultisampleState(MultisampleState const &state) { emit({10, state.value}); }
+            void bindBlendStates(uint32_t id, std::initializer_list<BlendState const> states) { for (auto &state : states) emit({11, id, state.value}); }
+            void setStencil(DkFace face, uint32_t mask, uint32_t ref, uint32_t compare_mask) { emit({12, (uint32_t)face, mask, ref, compare_mask}); }
+            void draw(DkPrimitive prim, uint32_t count, uint32_t instances, uint32_t first, uint32_t first_instance) { emit({13, (uint32_t)prim, count, instances, first, first_instance}); }
+            void bindShaders(uint32_t, std::initializer_list<Shader const *>) { emit({14}); }
+            template <typename T> void bindVtxAttribState(T const &) { emit({15}); }
+            template <typename T> void bindVtxBufferState(T const &) { emit({16}); }
+            void bindVtxBuffer(uint32_t, DkGpuAddr, uint32_t size) { emit({17, size}); }
+            void bindRenderTargets(ImageView const *, ImageView const * = nullptr) { emit({18}); }
+            void setViewports(uint32_t, std::initializer_list<Viewport const>) { emit({19}); }
+            void setScissors(uint32_t, std::initializer_list<Scissor const>) { emit({20}); }
+            void clearColor(uint32_t, uint32_t, float, float, float, float) { emit({21}); }
+            void clearDepthStencil(bool, float, uint32_t, uint32_t) { emit({22}); }
+            void discardDepthStencil() { emit({23}); }
+            void resolveImage(ImageView const &, ImageView const &) { emit({24}); }
+            void bindImageDescriptorSet(DkGpuAddr, uint32_t) { emit({25}); }
+            void bindSamplerDescriptorSet(DkGpuAddr, uint32_t) { emit({26}); }
+            void copyBufferToImage(DkCopyBuf const &, ImageView const &, DkImageRect const &rect, uint32_t = 0) { emit({27, rect.x, rect.y, rect.width, rect.height}); }
+            void copyImage(ImageView const &, DkImageRect const &rect, ImageView const &, DkImageRect const &, uint32_t = 0) { emit({28, rect.width, rect.height}); }
+            void destroy() { if (impl) { clear(); delete impl; impl = nullptr; } }
+    };
+
+    class UniqueCmdBuf : public CmdBuf {
+        public:
+            UniqueCmdBuf() = default;
+            UniqueCmdBuf(CmdBuf cmd_buf) { impl = cmd_buf.impl; }
+            UniqueCmdBuf(UniqueCmdBuf &&other) { impl = other.impl; other.impl = nullptr; }
+            UniqueCmdBuf &operator=(UniqueCmdBuf &&other) { destroy(); impl = other.impl; other.impl = nullptr; return *this; }
+            ~UniqueCmdBuf() { destroy(); }
+    };
+
+    struct CmdBufMaker {
+        CmdBufMaker(Device) {}
+        UniqueCmdBuf create() { CmdBuf cmd_buf; cmd_buf.impl = new CmdBufImpl; return UniqueCmdBuf(cmd_buf); }
+    };
+
+    struct QueueImpl {
+        std::vector<uint32_t> stream;
+    };
+
+    class Queue {
+        public:
+            QueueImpl *impl = nullptr;
+
+            void submitCommands(DkCmdList cmd_list) {
+                auto list = (const CmdList *)cmd_list;
+                impl->stream.insert(impl->stream.end(), list->words->begin() + list->begin, list->words->begin() + list->end);
+            }
+            void waitIdle() {}
+    };
+
+}
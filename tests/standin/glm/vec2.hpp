@@ -0,0 +1,16 @@
+//
+// Host stand-in for glm::vec2, see tests/recording_scaling.cpp.
+//
+
+#pragma once
+
+namespace glm {
+
+    struct vec2 {
+        float x, y;
+
+        template <typename A, typename B>
+        vec2(A a, B b) : x(a), y(b) {}
+    };
+
+}
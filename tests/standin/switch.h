@@ -0,0 +1,29 @@
+//
+// Host stand-in for the parts of libnx used by the deko3d renderer, see tests/recording_scaling.cpp.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#define NX_CONSTEXPR constexpr
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+
+// Ticks are nanoseconds on the host.
+static inline u64 armGetSystemTick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+static inline u64 armTicksToNs(u64 ticks)
+{
+    return ticks;
+}